@@ -0,0 +1,224 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --list               print the benchmark names and exit\n"
+              << "  --filter a,b         run benchmarks whose name contains a or b\n"
+              << "  --threads 1,2,4      thread counts for benchmarks that scale with threads\n"
+              << "  --warmup N           untimed runs before each measurement\n"
+              << "  --reps N             timed runs per measurement\n"
+              << "  --seed N             seed for the generated data\n"
+              << "  --rows N             rows in the default data set\n"
+              << "  --csv PATH           CSV output (empty to skip)\n"
+              << "  --json PATH          JSON output (empty to skip)\n";
+}
+
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::optional<BenchmarkOptions> BenchmarkOptions::parse(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--list") {
+            options.list = true;
+            continue;
+        }
+        if (flag == "--help" || i + 1 >= argc) {
+            printUsage(argv[0]);
+            return std::nullopt;
+        }
+        std::string value = argv[++i];
+        try {
+            if (flag == "--filter") {
+                options.filters = splitList(value);
+            } else if (flag == "--threads") {
+                options.threads.clear();
+                for (const std::string& count : splitList(value)) {
+                    options.threads.push_back(std::max(1, std::stoi(count)));
+                }
+            } else if (flag == "--warmup") {
+                options.warmup = std::max(0, std::stoi(value));
+            } else if (flag == "--reps") {
+                options.repetitions = std::max(1, std::stoi(value));
+            } else if (flag == "--seed") {
+                options.seed = std::stoull(value);
+            } else if (flag == "--rows") {
+                options.rows = std::max<size_t>(1, std::stoull(value));
+            } else if (flag == "--csv") {
+                options.csvPath = value;
+            } else if (flag == "--json") {
+                options.jsonPath = value;
+            } else {
+                std::cerr << "Unknown option: " << flag << "\n";
+                printUsage(argv[0]);
+                return std::nullopt;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << flag << ": " << value << "\n";
+            return std::nullopt;
+        }
+    }
+    if (options.threads.empty()) {
+        std::cerr << "--threads needs at least one count\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(p * sorted.size() + 0.999999);
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+const BenchmarkResult& BenchmarkContext::add(const std::string& label, int threads, std::vector<double> samples, size_t items, size_t bytes) {
+    std::sort(samples.begin(), samples.end());
+    BenchmarkResult result;
+    result.benchmark = name;
+    result.label = label;
+    result.threads = threads;
+    result.repetitions = samples.size();
+    result.p50 = percentile(samples, 0.5);
+    result.p99 = percentile(samples, 0.99);
+    result.max = samples.back();
+    result.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    if (result.p50 > 0) {
+        result.itemsPerSecond = items / result.p50;
+        result.bytesPerSecond = bytes / result.p50;
+    }
+    std::cout << "  " << label << " [" << threads << " threads]: p50 " << result.p50 << " s, p99 " << result.p99
+              << " s, max " << result.max << " s";
+    if (items > 0) {
+        std::cout << ", " << result.itemsPerSecond << " items/s";
+    }
+    if (bytes > 0) {
+        std::cout << ", " << result.bytesPerSecond / 1e9 << " GB/s";
+    }
+    std::cout << "\n";
+    results.push_back(std::move(result));
+    return results.back();
+}
+
+void BenchmarkRegistry::add(std::string name, std::function<void(BenchmarkContext&)> fn) {
+    cases.emplace_back(std::move(name), std::move(fn));
+}
+
+bool BenchmarkRegistry::selected(const std::string& name, const BenchmarkOptions& options) const {
+    if (options.filters.empty()) {
+        return true;
+    }
+    return std::any_of(options.filters.begin(), options.filters.end(), [&](const std::string& filter) {
+        return name.find(filter) != std::string::npos;
+    });
+}
+
+int BenchmarkRegistry::run(const BenchmarkOptions& options) {
+    if (options.list) {
+        for (const auto& [name, fn] : cases) {
+            std::cout << name << "\n";
+        }
+        return 0;
+    }
+    size_t ran = 0;
+    for (const auto& [name, fn] : cases) {
+        if (!selected(name, options)) {
+            continue;
+        }
+        std::cout << "== " << name << "\n";
+        BenchmarkContext context(options, name, results);
+        fn(context);
+        ++ran;
+    }
+    if (ran == 0) {
+        std::cerr << "No benchmark matches the filters (see --list)\n";
+        return 1;
+    }
+    if (!options.csvPath.empty()) {
+        writeCsv(options.csvPath);
+    }
+    if (!options.jsonPath.empty()) {
+        writeJson(options.jsonPath, options);
+    }
+    return 0;
+}
+
+// Quote a CSV field when it holds a separator or quote
+static std::string csvQuote(const std::string& field) {
+    if (field.find_first_of(",\"\n") == std::string::npos) {
+        return field;
+    }
+    std::string quoted = "\"";
+    for (char c : field) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + "\"";
+}
+
+static std::string jsonQuote(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+void BenchmarkRegistry::writeCsv(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << "\n";
+        return;
+    }
+    file.precision(9);
+    file << "Benchmark,Label,Threads,Repetitions,P50(s),P99(s),Max(s),Mean(s),Items/s,Bytes/s\n";
+    for (const BenchmarkResult& r : results) {
+        file << csvQuote(r.benchmark) << "," << csvQuote(r.label) << "," << r.threads << "," << r.repetitions << ","
+             << r.p50 << "," << r.p99 << "," << r.max << "," << r.mean << "," << r.itemsPerSecond << "," << r.bytesPerSecond << "\n";
+    }
+}
+
+// Settings are written next to the results, so two files show whether they are comparable
+void BenchmarkRegistry::writeJson(const std::string& path, const BenchmarkOptions& options) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << "\n";
+        return;
+    }
+    file.precision(9);
+    file << "{\n  \"settings\": {\"seed\": " << options.seed << ", \"rows\": " << options.rows << ", \"warmup\": "
+         << options.warmup << ", \"repetitions\": " << options.repetitions << "},\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        file << (i == 0 ? "\n" : ",\n") << "    {\"benchmark\": " << jsonQuote(r.benchmark) << ", \"label\": " << jsonQuote(r.label)
+             << ", \"threads\": " << r.threads << ", \"repetitions\": " << r.repetitions << ", \"p50\": " << r.p50
+             << ", \"p99\": " << r.p99 << ", \"max\": " << r.max << ", \"mean\": " << r.mean
+             << ", \"itemsPerSecond\": " << r.itemsPerSecond << ", \"bytesPerSecond\": " << r.bytesPerSecond << "}";
+    }
+    file << "\n  ]\n}\n";
+}
@@ -0,0 +1,95 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <optional>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Run settings, from the command line (see parse() for the flags)
+struct BenchmarkOptions {
+    std::vector<std::string> filters;       // Run cases whose name contains one of these; all when empty
+    std::vector<int> threads = {1, 2, 4, 8}; // Thread counts for cases that scale with threads
+    int warmup = 1;                         // Untimed runs before each measurement
+    int repetitions = 5;                    // Timed runs per measurement
+    uint64_t seed = 42;                     // Seed for every generated data set
+    size_t rows = 100000;                   // Rows in the default data set
+    std::string csvPath = "performance_results.csv";
+    std::string jsonPath = "performance_results.json";
+    bool list = false;                      // Print the case names and exit
+
+    static std::optional<BenchmarkOptions> parse(int argc, char** argv); // Null (and usage on stderr) on bad flags
+};
+
+// Summary of one measurement: latency over its repetitions and the throughput at the median
+struct BenchmarkResult {
+    std::string benchmark; // Registered case
+    std::string label;     // Measurement within the case
+    int threads = 1;
+    size_t repetitions = 0;
+    double p50 = 0, p99 = 0, max = 0, mean = 0; // Seconds per repetition
+    double itemsPerSecond = 0;                  // Zero when no item count was given
+    double bytesPerSecond = 0;                  // Zero when no byte count was given
+};
+
+// Handle passed to a running case: its options and the recorder for its measurements
+class BenchmarkContext {
+private:
+    const BenchmarkOptions& settings;
+    std::string name;
+    std::vector<BenchmarkResult>& results;
+
+    const BenchmarkResult& add(const std::string& label, int threads, std::vector<double> samples, size_t items, size_t bytes);
+
+public:
+    BenchmarkContext(const BenchmarkOptions& options, std::string name, std::vector<BenchmarkResult>& results)
+        : settings(options), name(std::move(name)), results(results) {}
+
+    const BenchmarkOptions& options() const { return settings; }
+
+    // Run fn warmup times untimed, then repetitions times timed; items and bytes are per run
+    template <typename Fn>
+    const BenchmarkResult& measure(const std::string& label, int threads, Fn&& fn, size_t items = 0, size_t bytes = 0) {
+        return measureWithSetup(label, threads, [] {}, fn, items, bytes);
+    }
+
+    // Same, with setup run untimed before every run of fn: for operations that change what
+    // they run on, such as appends that widen the column, setup puts the state back
+    template <typename Setup, typename Fn>
+    const BenchmarkResult& measureWithSetup(const std::string& label, int threads, Setup&& setup, Fn&& fn, size_t items = 0, size_t bytes = 0) {
+        for (int i = 0; i < settings.warmup; ++i) {
+            setup();
+            fn();
+        }
+        std::vector<double> samples(std::max(1, settings.repetitions));
+        for (double& sample : samples) {
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            sample = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return add(label, threads, std::move(samples), items, bytes);
+    }
+};
+
+// Named benchmark cases, run in registration order and written out as CSV and JSON
+class BenchmarkRegistry {
+private:
+    std::vector<std::pair<std::string, std::function<void(BenchmarkContext&)>>> cases;
+    std::vector<BenchmarkResult> results;
+
+    bool selected(const std::string& name, const BenchmarkOptions& options) const;
+    void writeCsv(const std::string& path) const;
+    void writeJson(const std::string& path, const BenchmarkOptions& options) const;
+
+public:
+    void add(std::string name, std::function<void(BenchmarkContext&)> fn);
+    int run(const BenchmarkOptions& options); // Exit status: nonzero when the filters match no case
+    const std::vector<BenchmarkResult>& measurements() const { return results; }
+};
+
+#endif
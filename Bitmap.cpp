@@ -0,0 +1,274 @@
+#include "Bitmap.h"
+#include <algorithm>
+#include <iterator>
+
+Bitmap::Bitmap(size_t size) : words((size + 63) / 64, 0), bits(size) {}
+
+Bitmap::Bitmap(std::vector<uint64_t> rawWords, size_t size) : words(std::move(rawWords)), bits(size) {
+    words.resize((size + 63) / 64, 0);
+    clearTail();
+}
+
+void Bitmap::clearTail() {
+    if (bits % 64 != 0) {
+        words.back() &= (uint64_t(1) << (bits % 64)) - 1;
+    }
+}
+
+void Bitmap::setRange(size_t begin, size_t end) {
+    for (; begin < end && begin % 64 != 0; ++begin) {
+        set(begin);
+    }
+    for (; begin + 64 <= end; begin += 64) {
+        words[begin / 64] = ~uint64_t(0);
+    }
+    for (; begin < end; ++begin) {
+        set(begin);
+    }
+}
+
+size_t Bitmap::count() const {
+    size_t total = 0;
+    for (uint64_t word : words) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+bool Bitmap::any() const {
+    for (uint64_t word : words) {
+        if (word != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+long Bitmap::first() const {
+    for (size_t w = 0; w < words.size(); ++w) {
+        if (words[w] != 0) {
+            return static_cast<long>(w * 64 + __builtin_ctzll(words[w]));
+        }
+    }
+    return -1;
+}
+
+Bitmap& Bitmap::operator&=(const Bitmap& other) {
+    for (size_t w = 0; w < words.size(); ++w) {
+        words[w] &= other.words[w];
+    }
+    return *this;
+}
+
+Bitmap& Bitmap::operator|=(const Bitmap& other) {
+    for (size_t w = 0; w < words.size(); ++w) {
+        words[w] |= other.words[w];
+    }
+    return *this;
+}
+
+Bitmap& Bitmap::andNot(const Bitmap& other) {
+    for (size_t w = 0; w < words.size(); ++w) {
+        words[w] &= ~other.words[w];
+    }
+    return *this;
+}
+
+Bitmap Bitmap::operator~() const {
+    Bitmap result(*this);
+    for (auto& word : result.words) {
+        word = ~word;
+    }
+    result.clearTail();
+    return result;
+}
+
+std::vector<int> Bitmap::toIndices() const {
+    std::vector<int> indices;
+    indices.reserve(count());
+    for (size_t row : *this) {
+        indices.push_back(static_cast<int>(row));
+    }
+    return indices;
+}
+
+CompressedBitmap Bitmap::compress() const {
+    return CompressedBitmap(*this);
+}
+
+Bitmap::Iterator::Iterator(const uint64_t* words, size_t wordIndex, size_t wordCount)
+    : words(words), wordIndex(wordIndex), wordCount(wordCount),
+      current(wordIndex < wordCount ? words[wordIndex] : 0) {
+    advance();
+}
+
+// Move to the next word with a set bit, or to end()
+void Bitmap::Iterator::advance() {
+    while (current == 0 && wordIndex < wordCount) {
+        ++wordIndex;
+        current = wordIndex < wordCount ? words[wordIndex] : 0;
+    }
+}
+
+Bitmap::Iterator& Bitmap::Iterator::operator++() {
+    current &= current - 1; // Clear the lowest set bit
+    advance();
+    return *this;
+}
+
+size_t CompressedBitmap::Container::count() const {
+    if (dense.empty()) {
+        return array.size();
+    }
+    size_t total = 0;
+    for (uint64_t word : dense) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+void CompressedBitmap::Container::toWords(uint64_t* out) const {
+    if (!dense.empty()) {
+        for (size_t w = 0; w < kChunkWords; ++w) {
+            out[w] |= dense[w];
+        }
+        return;
+    }
+    for (uint16_t low : array) {
+        out[low / 64] |= uint64_t(1) << (low % 64);
+    }
+}
+
+// Store one chunk in whichever form is smaller; empty chunks are dropped
+void CompressedBitmap::addChunk(uint32_t chunk, const uint64_t* chunkWords, size_t wordCount) {
+    size_t cardinality = 0;
+    for (size_t w = 0; w < wordCount; ++w) {
+        cardinality += __builtin_popcountll(chunkWords[w]);
+    }
+    if (cardinality == 0) {
+        return;
+    }
+
+    Container container;
+    container.chunk = chunk;
+    if (cardinality > kArrayLimit) {
+        container.dense.assign(kChunkWords, 0);
+        std::copy(chunkWords, chunkWords + wordCount, container.dense.begin());
+    } else {
+        container.array.reserve(cardinality);
+        for (size_t w = 0; w < wordCount; ++w) {
+            uint64_t word = chunkWords[w];
+            while (word != 0) {
+                container.array.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+    containers.push_back(std::move(container));
+}
+
+CompressedBitmap::CompressedBitmap(const Bitmap& bitmap) : bits(bitmap.size()) {
+    size_t totalWords = bitmap.wordCount();
+    for (size_t start = 0; start < totalWords; start += kChunkWords) {
+        addChunk(static_cast<uint32_t>(start / kChunkWords), bitmap.data() + start,
+                 std::min(kChunkWords, totalWords - start));
+    }
+}
+
+size_t CompressedBitmap::count() const {
+    size_t total = 0;
+    for (const auto& container : containers) {
+        total += container.count();
+    }
+    return total;
+}
+
+bool CompressedBitmap::test(size_t row) const {
+    uint32_t chunk = static_cast<uint32_t>(row / kChunkRows);
+    auto it = std::lower_bound(containers.begin(), containers.end(), chunk,
+                               [](const Container& c, uint32_t key) { return c.chunk < key; });
+    if (it == containers.end() || it->chunk != chunk) {
+        return false;
+    }
+    uint16_t low = static_cast<uint16_t>(row % kChunkRows);
+    if (!it->dense.empty()) {
+        return (it->dense[low / 64] >> (low % 64)) & 1;
+    }
+    return std::binary_search(it->array.begin(), it->array.end(), low);
+}
+
+size_t CompressedBitmap::memoryBytes() const {
+    size_t total = containers.size() * sizeof(Container);
+    for (const auto& container : containers) {
+        total += container.array.size() * sizeof(uint16_t) + container.dense.size() * sizeof(uint64_t);
+    }
+    return total;
+}
+
+Bitmap CompressedBitmap::toBitmap() const {
+    Bitmap result(bits);
+    std::vector<uint64_t> chunkWords(kChunkWords);
+    for (const auto& container : containers) {
+        std::fill(chunkWords.begin(), chunkWords.end(), 0);
+        container.toWords(chunkWords.data());
+        size_t start = container.chunk * kChunkWords;
+        size_t count = std::min(kChunkWords, result.wordCount() - start);
+        std::copy(chunkWords.begin(), chunkWords.begin() + count, result.data() + start);
+    }
+    return result;
+}
+
+// Merge two container lists chunk by chunk, applying op to the expanded words.
+// keepUnmatched controls whether chunks present on only one side survive (OR) or not (AND).
+template <typename WordOp>
+CompressedBitmap CompressedBitmap::combine(const CompressedBitmap& a, const CompressedBitmap& b, WordOp op, bool keepUnmatched) {
+    CompressedBitmap result;
+    result.bits = a.bits;
+    std::vector<uint64_t> left(kChunkWords), right(kChunkWords);
+
+    size_t i = 0, j = 0;
+    while (i < a.containers.size() || j < b.containers.size()) {
+        bool takeLeft = j == b.containers.size() || (i < a.containers.size() && a.containers[i].chunk < b.containers[j].chunk);
+        bool takeRight = i == a.containers.size() || (j < b.containers.size() && b.containers[j].chunk < a.containers[i].chunk);
+
+        if (takeLeft || takeRight) {
+            const Container& only = takeLeft ? a.containers[i++] : b.containers[j++];
+            if (keepUnmatched) {
+                result.containers.push_back(only);
+            }
+            continue;
+        }
+
+        // Both sides hold this chunk
+        const Container& x = a.containers[i++];
+        const Container& y = b.containers[j++];
+        if (!keepUnmatched && x.dense.empty() && y.dense.empty()) {
+            // Sparse AND sparse: sorted-array intersection
+            Container merged;
+            merged.chunk = x.chunk;
+            std::set_intersection(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(),
+                                  std::back_inserter(merged.array));
+            if (!merged.array.empty()) {
+                result.containers.push_back(std::move(merged));
+            }
+            continue;
+        }
+        std::fill(left.begin(), left.end(), 0);
+        std::fill(right.begin(), right.end(), 0);
+        x.toWords(left.data());
+        y.toWords(right.data());
+        for (size_t w = 0; w < kChunkWords; ++w) {
+            left[w] = op(left[w], right[w]);
+        }
+        result.addChunk(x.chunk, left.data(), kChunkWords);
+    }
+    return result;
+}
+
+CompressedBitmap operator&(const CompressedBitmap& a, const CompressedBitmap& b) {
+    return CompressedBitmap::combine(a, b, [](uint64_t x, uint64_t y) { return x & y; }, false);
+}
+
+CompressedBitmap operator|(const CompressedBitmap& a, const CompressedBitmap& b) {
+    return CompressedBitmap::combine(a, b, [](uint64_t x, uint64_t y) { return x | y; }, true);
+}
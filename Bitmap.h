@@ -0,0 +1,108 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class CompressedBitmap;
+
+// Dense row bitmap used as the result of column scans.
+// Bit (row % 64) of words[row / 64] is set when row matches; bits past size() are always clear.
+class Bitmap {
+private:
+    std::vector<uint64_t> words;
+    size_t bits = 0;
+
+    void clearTail(); // Zero the unused bits of the last word
+
+public:
+    Bitmap() = default;
+    explicit Bitmap(size_t size);                      // All rows clear
+    Bitmap(std::vector<uint64_t> words, size_t size);  // Adopt raw words
+
+    size_t size() const { return bits; }
+    uint64_t* data() { return words.data(); }
+    const uint64_t* data() const { return words.data(); }
+    size_t wordCount() const { return words.size(); }
+
+    void set(size_t row) { words[row / 64] |= uint64_t(1) << (row % 64); }
+    bool test(size_t row) const { return (words[row / 64] >> (row % 64)) & 1; }
+    // OR an up-to-64-bit scan mask into rows [row, row + 64); row must be a multiple of the mask width
+    void orMask(size_t row, uint64_t mask) { words[row / 64] |= mask << (row % 64); }
+    void setRange(size_t begin, size_t end); // Set rows [begin, end)
+
+    size_t count() const; // Number of set rows (popcount)
+    bool any() const;
+    long first() const;   // Lowest set row, or -1
+
+    // Combinators; operands must have the same size
+    Bitmap& operator&=(const Bitmap& other);
+    Bitmap& operator|=(const Bitmap& other);
+    Bitmap& andNot(const Bitmap& other);
+    Bitmap operator~() const;
+    friend Bitmap operator&(Bitmap a, const Bitmap& b) { return a &= b; }
+    friend Bitmap operator|(Bitmap a, const Bitmap& b) { return a |= b; }
+    bool operator==(const Bitmap& other) const { return bits == other.bits && words == other.words; }
+
+    // Forward iterator over set rows in ascending order
+    class Iterator {
+    private:
+        const uint64_t* words;
+        size_t wordIndex, wordCount;
+        uint64_t current; // Remaining bits of words[wordIndex]
+
+        void advance();
+
+    public:
+        Iterator(const uint64_t* words, size_t wordIndex, size_t wordCount);
+        size_t operator*() const { return wordIndex * 64 + __builtin_ctzll(current); }
+        Iterator& operator++();
+        bool operator!=(const Iterator& other) const { return wordIndex != other.wordIndex || current != other.current; }
+    };
+    Iterator begin() const { return Iterator(words.data(), 0, words.size()); }
+    Iterator end() const { return Iterator(words.data(), words.size(), words.size()); }
+
+    std::vector<int> toIndices() const;
+    CompressedBitmap compress() const;
+};
+
+// Roaring-style compressed bitmap: rows are split into 2^16-row chunks, each stored
+// as a sorted uint16 array when sparse or as a 1024-word bitmap when dense.
+class CompressedBitmap {
+private:
+    static constexpr size_t kChunkRows = 65536;
+    static constexpr size_t kChunkWords = kChunkRows / 64;
+    static constexpr size_t kArrayLimit = 4096; // Above this many rows a chunk is stored dense
+
+    struct Container {
+        uint32_t chunk;                 // Row / kChunkRows
+        std::vector<uint16_t> array;    // Sorted low bits (sparse form)
+        std::vector<uint64_t> dense;    // kChunkWords words (dense form), empty when sparse
+
+        size_t count() const;
+        void toWords(uint64_t* out) const; // OR into kChunkWords words
+    };
+
+    std::vector<Container> containers; // Sorted by chunk, never empty
+    size_t bits = 0;
+
+    void addChunk(uint32_t chunk, const uint64_t* chunkWords, size_t wordCount);
+    template <typename WordOp>
+    static CompressedBitmap combine(const CompressedBitmap& a, const CompressedBitmap& b, WordOp op, bool keepUnmatched);
+
+public:
+    CompressedBitmap() = default;
+    explicit CompressedBitmap(const Bitmap& bitmap);
+
+    size_t size() const { return bits; }
+    size_t count() const;
+    bool test(size_t row) const;
+    size_t memoryBytes() const;
+    Bitmap toBitmap() const;
+
+    friend CompressedBitmap operator&(const CompressedBitmap& a, const CompressedBitmap& b);
+    friend CompressedBitmap operator|(const CompressedBitmap& a, const CompressedBitmap& b);
+};
+
+#endif
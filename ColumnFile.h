@@ -0,0 +1,57 @@
+#ifndef COLUMN_FILE_H
+#define COLUMN_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// On-disk layout written by DictionaryEncoder::writeBinary() and mapped by open().
+// Every section starts on a 64-byte boundary so the mapped arrays are used in place:
+//
+//   header | entries[numEntries] | owners[keyCount] | slots[slotCount] | heap[heapBytes] | codes[rows]
+//
+// entries hold every key with its code and its bytes in heap; owners maps a code to the
+// entry whose key it decodes to (-1 if none); slots is an open-addressing index over
+// entries (entry + 1, 0 = empty) probed with VersionedDictionary::hashKey.
+static constexpr char kColumnFileMagic[8] = {'D', 'I', 'C', 'T', 'C', 'O', 'L', '\0'};
+static constexpr uint32_t kColumnFileVersion = 1;
+static constexpr uint32_t kColumnFileByteOrder = 0x01020304; // Reads back differently on a foreign-endian host
+static constexpr uint32_t kColumnFileCodesOrdered = 1;       // Flag: code order matches key order
+static constexpr size_t kColumnFileAlignment = 64;
+
+struct ColumnFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t rows;            // Encoded rows
+    uint64_t keyCount;        // One past the largest code
+    uint64_t numEntries;      // Keys in the index
+    uint64_t slotCount;       // Index capacity, a power of two
+    uint64_t heapBytes;
+    uint64_t entriesOffset;   // Byte offsets of the sections from the start of the file
+    uint64_t ownersOffset;
+    uint64_t slotsOffset;
+    uint64_t heapOffset;
+    uint64_t codesOffset;
+    uint64_t fileBytes;
+};
+
+struct ColumnFileEntry {
+    uint64_t hash;
+    uint64_t offset; // Key bytes in heap
+    uint32_t length;
+    int32_t code;
+};
+
+static constexpr uint64_t alignColumnFileOffset(uint64_t offset) {
+    return (offset + kColumnFileAlignment - 1) & ~uint64_t(kColumnFileAlignment - 1);
+}
+
+// Whether count items of size bytes starting at offset end by limit, and offset sits on a
+// section boundary; written so that no corrupt header value can overflow it
+static constexpr bool columnFileSectionFits(uint64_t offset, uint64_t count, uint64_t size, uint64_t limit) {
+    return offset % kColumnFileAlignment == 0 && offset <= limit && count <= (limit - offset) / size;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "ConcurrentDictionary.h"
+#include "KeyHash.h"
+#include "ScanKernels.h"
+#include <algorithm>
+#include <thread>
+#include <climits>
+#include <cmath>
+#include <unordered_map>
+
+ConcurrentDictionary::ConcurrentDictionary(size_t maxKeys)
+    : hashKeys(scanKernels().hashKeys), maxKeys(static_cast<int>(std::min<size_t>(std::max(maxKeys, kMinKeys), INT_MAX))) {
+    // Keep the load factor at or below 50% so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < 2 * static_cast<size_t>(this->maxKeys)) {
+        capacity <<= 1;
+    }
+    slots = std::make_unique<Slot[]>(capacity);
+    mask = capacity - 1;
+}
+
+size_t ConcurrentDictionary::estimateKeys(size_t n, std::span<const std::string_view> sample) {
+    if (n <= sample.size()) {
+        return std::max(n, kMinKeys);
+    }
+    std::unordered_map<std::string_view, uint32_t> seen(2 * sample.size());
+    for (std::string_view key : sample) {
+        ++seen[key];
+    }
+    size_t singletons = std::count_if(seen.begin(), seen.end(), [](const auto& entry) { return entry.second == 1; });
+    if (singletons * 10 > sample.size() * 9) {
+        return n;
+    }
+    double estimate = (seen.size() - singletons) + std::sqrt(static_cast<double>(n) / sample.size()) * singletons;
+    return std::clamp(static_cast<size_t>(2 * estimate), kMinKeys, n); // 2x margin: the estimate can be off either way
+}
+
+int ConcurrentDictionary::getOrInsert(std::string_view key, std::atomic<int>& nextId, size_t& probes) {
+    uint64_t hash;
+    hashKeys(&key, 1, &hash);
+    return insertHashed(key, hash, nextId, probes);
+}
+
+void ConcurrentDictionary::getOrInsertMany(const std::string_view* keys, size_t n, int* ids, std::atomic<int>& nextId, size_t& probes) {
+    constexpr size_t kBlock = 16;
+    uint64_t hashes[kBlock];
+    for (size_t first = 0; first < n; first += kBlock) {
+        size_t count = std::min(kBlock, n - first);
+        hashKeys(keys + first, count, hashes);
+        for (size_t i = 0; i < count; ++i) {
+            __builtin_prefetch(&slots[hashes[i] & mask]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            ids[first + i] = insertHashed(keys[first + i], hashes[i], nextId, probes);
+        }
+    }
+}
+
+int ConcurrentDictionary::insertHashed(std::string_view key, uint64_t hash, std::atomic<int>& nextId, size_t& probes) {
+    uint64_t tag = hash & kTagMask;
+    size_t pos = hash & mask;
+
+    // Linear probing; every slot transitions empty -> busy -> ready exactly once
+    while (true) {
+        ++probes;
+        Slot& slot = slots[pos];
+        uint64_t state = slot.state.load(std::memory_order_acquire);
+
+        if (state == 0) {
+            // A new key: refuse it once maxKeys are in. Threads that pass this check together
+            // can overshoot by one key each, which the 50% load factor absorbs.
+            if (nextId.load(std::memory_order_relaxed) >= maxKeys) {
+                overflowed.store(true, std::memory_order_relaxed);
+                return -1;
+            }
+            // Try to claim the empty slot for this key
+            if (slot.state.compare_exchange_strong(state, tag | kBusy, std::memory_order_acq_rel)) {
+                slot.data = key.data();
+                slot.length = static_cast<uint32_t>(key.size());
+                slot.id = nextId.fetch_add(1, std::memory_order_relaxed);
+                slot.state.store(tag | kReady, std::memory_order_release);
+                return slot.id;
+            }
+            // Lost the race; state now holds the winner's tag, fall through and inspect it
+        }
+
+        if ((state & kTagMask) == tag) {
+            // Same hash tag: wait for the owner to publish, then compare keys
+            while (!(state & kReady)) {
+                std::this_thread::yield();
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            if (sameKey(std::string_view(slot.data, slot.length), key)) {
+                return slot.id;
+            }
+        }
+
+        pos = (pos + 1) & mask;
+    }
+}
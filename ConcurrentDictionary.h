@@ -0,0 +1,79 @@
+#ifndef CONCURRENT_DICTIONARY_H
+#define CONCURRENT_DICTIONARY_H
+
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Lock-free open-addressing hash table used by parallel encode().
+// Keys are referenced, not copied: the strings must outlive the table.
+// Capacity is fixed at construction for maxKeys keys. Once they are all in, inserting
+// another key fails and marks the table full(); the caller then starts over with a larger
+// table, so a low estimateKeys() costs a repeated pass rather than a wrong result.
+class ConcurrentDictionary {
+private:
+    static constexpr uint64_t kBusy = 1;  // Slot claimed, key/id not yet visible
+    static constexpr uint64_t kReady = 2; // Slot published
+    static constexpr uint64_t kTagMask = ~uint64_t(3);
+
+    struct Slot {
+        std::atomic<uint64_t> state{0}; // 0 = empty, otherwise (hash & kTagMask) | kBusy/kReady
+        const char* data = nullptr;
+        uint32_t length = 0;
+        int id = -1;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask; // Capacity - 1 (capacity is a power of two)
+    void (*hashKeys)(const std::string_view* keys, size_t n, uint64_t* hashes); // Best kernel for this CPU
+    int maxKeys;
+    std::atomic<bool> overflowed{false};
+
+    int insertHashed(std::string_view key, uint64_t hash, std::atomic<int>& nextId, size_t& probes);
+
+public:
+    static constexpr size_t kMinKeys = 1024; // Room for the keys threads racing past maxKeys can still claim
+
+    explicit ConcurrentDictionary(size_t maxKeys);
+
+    // Distinct keys to size a table for, out of n keys of which sample is an even sample:
+    // keys seen more than once are counted once, and singletons scale up to the whole input
+    // (Guaranteed-Error Estimator). A sample of mostly singletons sizes for n, since that
+    // input is near unique and an underestimate would cost a repeated pass.
+    static constexpr size_t kSampleKeys = 16384;
+    static size_t estimateKeys(size_t n, std::span<const std::string_view> sample);
+    template <typename KeyAt>
+    static size_t estimateKeys(size_t n, KeyAt&& keyAt) { // Samples keyAt(0) .. keyAt(n - 1)
+        std::vector<std::string_view> sample(std::min(n, kSampleKeys));
+        for (size_t i = 0; i < sample.size(); ++i) {
+            sample[i] = keyAt(i * n / sample.size());
+        }
+        return estimateKeys(n, std::span<const std::string_view>(sample));
+    }
+
+    bool full() const { return overflowed.load(std::memory_order_relaxed); } // An insert failed: the results are incomplete
+
+    // Return the id of key, assigning nextId++ if this call inserted it, or -1 if the table
+    // is full; the slots inspected are added to probes
+    int getOrInsert(std::string_view key, std::atomic<int>& nextId, size_t& probes);
+    // getOrInsert() for keys[0, n) into ids: each block of keys is hashed in one kernel call
+    // and the home slots prefetched before any key is probed, so the cache misses overlap
+    void getOrInsertMany(const std::string_view* keys, size_t n, int* ids, std::atomic<int>& nextId, size_t& probes);
+
+    // Visit every published (key, id) pair; not safe concurrently with inserts
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i <= mask; ++i) {
+            if (slots[i].state.load(std::memory_order_acquire) & kReady) {
+                fn(std::string_view(slots[i].data, slots[i].length), slots[i].id);
+            }
+        }
+    }
+};
+
+#endif
@@ -1,67 +1,609 @@
 #include "DictionaryEncoder.h"
+#include "ConcurrentDictionary.h"
+#include "ScanKernels.h"
+#include <deque>
+#include <charconv>
+#include <climits>
+#include <numeric>
 
-// Encode data into dictionary format using multi-threading
+DictionaryEncoder::DictionaryEncoder() : DictionaryEncoder(nullptr) {}
+
+DictionaryEncoder::DictionaryEncoder(std::shared_ptr<ThreadPool> pool)
+    : current(new Version{std::make_shared<VersionedDictionary>(), 0, std::make_shared<SegmentedColumn>(1)}),
+      scanPool(pool ? pool.get() : new ThreadPool(std::max(1u, std::thread::hardware_concurrency()))), sharedPool(std::move(pool)) {}
+
+// No reader can outlive the encoder, so the live version and own pool are freed directly once
+// the shared scanner has answered its last queries
+DictionaryEncoder::~DictionaryEncoder() {
+    {
+        std::lock_guard lock(sharedMutex);
+        sharedStopping = true;
+    }
+    sharedReady.notify_one();
+    if (sharedScanner.joinable()) {
+        sharedScanner.join();
+    }
+    delete current.load(std::memory_order_relaxed);
+    if (scanPool.load(std::memory_order_relaxed) != sharedPool.get()) {
+        delete scanPool.load(std::memory_order_relaxed);
+    }
+}
+
+// Swap in the next version (caller holds writerMutex). Readers that already loaded the
+// old version keep using it; it is freed once their epoch guards have ended.
+void DictionaryEncoder::publish(Version* next) {
+    Version* old = current.exchange(next, std::memory_order_seq_cst);
+    EpochManager::instance().retire(old);
+}
+
+// Uncontended acquisitions only pay for the try_lock; waits are timed as WriterWait
+std::unique_lock<std::mutex> DictionaryEncoder::lockWriter() const {
+    std::unique_lock lock(writerMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        EncoderStats::Timer wait(statistics, EncoderStats::Operation::WriterWait);
+        lock.lock();
+    }
+    return lock;
+}
+
+Bitmap DictionaryEncoder::recordScan(const Version& v, Bitmap matches, size_t skipped) const {
+    statistics.scanned(v.rows - skipped, (v.rows - skipped) * v.column->codeBytes());
+    statistics.add(EncoderStats::Counter::RowsSkipped, skipped);
+    statistics.matched(matches);
+    return matches;
+}
+
+EncoderStats::Snapshot DictionaryEncoder::stats() const {
+    return statistics.snapshot();
+}
+
+void DictionaryEncoder::resetStats() {
+    statistics.reset();
+}
+
+// What a scan does with a zone, judged from its summary alone
+enum class ZoneAction {
+    Skip, // No row can match
+    Scan, // Some rows may match
+    Take  // Every row matches
+};
+
+// Visit the rows of [begin, end) zone by zone: classify(zone) picks an action, and runs of
+// adjacent zones with the same Scan or Take action go to visit(action, runBegin, runEnd) as
+// one call, so unskippable columns keep their long kernel calls. visit returns false to stop.
+// Returns the number of rows skipped.
+template <typename Classify, typename Visit>
+static size_t forEachZoneRun(const SegmentedColumn& column, size_t begin, size_t end, Classify classify, Visit visit) {
+    size_t skipped = 0;
+    size_t runBegin = begin;
+    ZoneAction run = ZoneAction::Skip;
+    bool going = true;
+    column.forEachZone(begin, end, [&](const SegmentedColumn::Zone& zone, size_t zoneBegin, size_t zoneEnd) {
+        if (!going) {
+            return;
+        }
+        ZoneAction action = classify(zone);
+        if (action != run) {
+            if (run != ZoneAction::Skip) {
+                going = visit(run, runBegin, zoneBegin);
+            }
+            run = action;
+            runBegin = zoneBegin;
+        }
+        if (going && action == ZoneAction::Skip) {
+            skipped += zoneEnd - zoneBegin;
+        }
+    });
+    if (going && run != ZoneAction::Skip) {
+        visit(run, runBegin, end);
+    }
+    return skipped;
+}
+
+// Zones that may hold code
+static auto zonesHolding(int code) {
+    return [code](const SegmentedColumn::Zone& zone) { return zone.mayContain(code) ? ZoneAction::Scan : ZoneAction::Skip; };
+}
+
+// Zones by how their codes fall in [lo, hi)
+static auto zonesInRange(int lo, int hi) {
+    return [lo, hi](const SegmentedColumn::Zone& zone) {
+        return !zone.mayOverlap(lo, hi) ? ZoneAction::Skip : zone.within(lo, hi) ? ZoneAction::Take : ZoneAction::Scan;
+    };
+}
+
+// Code of key if it is visible in version v, or -1 (append() may be adding keys past keyCount)
+int DictionaryEncoder::findCode(const Version& v, std::string_view key) {
+    int code = v.dictionary->find(key);
+    return code < v.keyCount ? code : -1;
+}
+
+// Encode data into dictionary format using multi-threading.
+// The new version is built off to the side, so readers keep scanning the old one meanwhile.
 void DictionaryEncoder::encode(const std::vector<std::string>& column, int numThreads) {
+    auto writer = lockWriter();
     size_t chunkSize = column.size() / numThreads;
-    std::vector<std::thread> threads;
 
-    // Thread-local dictionaries for parallel encoding
-    std::vector<std::unordered_map<std::string, int>> localDictionaries(numThreads);
-    std::vector<std::vector<int>> localEncodedColumns(numThreads);
+    // Shared lock-free dictionary; ids are handed out by nextId as keys are first seen. It is
+    // sized from a sampled key count, and a pass that overflows it runs again on a larger one.
+    std::unique_ptr<ConcurrentDictionary> globalDictionary;
+    std::atomic<int> nextId = 0;
+    auto encodedColumn = std::make_shared<SegmentedColumn>();
+    encodedColumn->resize(column.size());
+    size_t maxKeys = ConcurrentDictionary::estimateKeys(column.size(), [&](size_t row) -> std::string_view { return column[row]; });
 
-    // Parallel encoding
-    for (int i = 0; i < numThreads; ++i) {
-        size_t startIdx = i * chunkSize;
-        size_t endIdx = (i == numThreads - 1) ? column.size() : (i + 1) * chunkSize;
+    // Parallel encoding: each thread writes final codes straight into its slice of the column
+    EncoderStats::Timer hashing(statistics, EncoderStats::Operation::EncodeHash);
+    for (; !globalDictionary || globalDictionary->full(); maxKeys = std::min(column.size(), 4 * maxKeys)) {
+        globalDictionary = std::make_unique<ConcurrentDictionary>(maxKeys);
+        nextId = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; ++i) {
+            size_t startIdx = i * chunkSize;
+            size_t endIdx = (i == numThreads - 1) ? column.size() : (i + 1) * chunkSize;
 
-        threads.emplace_back([&, i, startIdx, endIdx]() {
-            for (size_t j = startIdx; j < endIdx; ++j) {
-                const std::string& value = column[j];
-                auto& localDict = localDictionaries[i];
+            threads.emplace_back([&, startIdx, endIdx]() {
+                size_t probes = 0;
+                encodedColumn->forEachSegmentMutable(startIdx, endIdx, [&](int* codes, size_t count, size_t firstRow) {
+                    // Views of one block of rows at a time for the batched probe
+                    constexpr size_t kBlock = 64;
+                    std::string_view keys[kBlock];
+                    for (size_t j = 0; j < count && !globalDictionary->full(); j += kBlock) {
+                        size_t block = std::min(kBlock, count - j);
+                        for (size_t k = 0; k < block; ++k) {
+                            keys[k] = column[firstRow + j + k];
+                        }
+                        globalDictionary->getOrInsertMany(keys, block, codes + j, nextId, probes);
+                    }
+                });
+                statistics.add(EncoderStats::Counter::DictionaryLookups, endIdx - startIdx);
+                statistics.add(EncoderStats::Counter::DictionaryProbes, probes);
+            });
+        }
 
-                if (localDict.find(value) == localDict.end()) {
-                    localDict[value] = localDict.size();
-                }
-                localEncodedColumns[i].push_back(localDict[value]);
-            }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    hashing.stop();
+    publishEncoded(*globalDictionary, nextId, std::move(encodedColumn), numThreads, column.data());
+}
+
+// Turn the ids a parallel encode assigned into the published dictionary and column: codes
+// are reordered by key when requested, and the column is narrowed to fit the keys.
+// The caller holds writerMutex; ids references keys that must stay alive until this returns.
+void DictionaryEncoder::publishEncoded(const ConcurrentDictionary& ids, int numIds, std::shared_ptr<SegmentedColumn> encodedColumn, int numThreads,
+                                       const std::string* encodedFrom) {
+    size_t numRows = encodedColumn->size();
+    size_t chunkSize = numRows / numThreads;
+
+    // Ids are dense, so collect the distinct keys indexed by id
+    std::vector<std::string_view> keys(numIds);
+    ids.forEach([&](std::string_view key, int id) {
+        keys[id] = key;
+    });
+
+    // Order-preserving mode: reassign codes by key rank so that prefix and
+    // range predicates map to one contiguous code interval. Front coding needs
+    // the keys sorted too, so a compressed dictionary is always order-preserving.
+    bool ordered = orderPreserving || compressedDictionary;
+    if (ordered) {
+        EncoderStats::Timer ordering(statistics, EncoderStats::Operation::EncodeOrder);
+        std::vector<int> order(keys.size());
+        for (size_t id = 0; id < order.size(); ++id) {
+            order[id] = static_cast<int>(id);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return keys[a] < keys[b];
         });
+
+        std::vector<int> rank(keys.size());
+        std::vector<std::string_view> sortedKeys(keys.size());
+        for (size_t r = 0; r < order.size(); ++r) {
+            rank[order[r]] = static_cast<int>(r);
+            sortedKeys[r] = keys[order[r]];
+        }
+        keys = std::move(sortedKeys);
+
+        // Remap the column in parallel, one slice per thread
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; ++i) {
+            size_t startIdx = i * chunkSize;
+            size_t endIdx = (i == numThreads - 1) ? numRows : (i + 1) * chunkSize;
+            threads.emplace_back([&, startIdx, endIdx]() {
+                encodedColumn->forEachSegmentMutable(startIdx, endIdx, [&](int* codes, size_t count, size_t) {
+                    for (size_t j = 0; j < count; ++j) {
+                        codes[j] = rank[codes[j]];
+                    }
+                });
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Store the codes at the narrowest width that holds them: fewer bytes per row to scan
+    unsigned codeBytes = SegmentedColumn::codeBytesFor(static_cast<int>(keys.size()) - 1);
+    // The copy summarizes its zones as it is filled; a column filled in place is summarized now
+    EncoderStats::Timer narrowing(statistics, EncoderStats::Operation::EncodeNarrow);
+    if (codeBytes < encodedColumn->codeBytes()) {
+        encodedColumn = encodedColumn->withCodeBytes(codeBytes, numRows);
+    } else {
+        encodedColumn->summarize();
+    }
+    encodedColumn->compactRuns(); // Clustered segments shrink to their runs
+    narrowing.stop();
+
+    // Intern the keys in code order, so each key's code is its position in keys
+    EncoderStats::Timer building(statistics, EncoderStats::Operation::EncodeBuild);
+    std::shared_ptr<VersionedDictionary> dictionary;
+    if (compressedDictionary) {
+        dictionary = std::make_shared<VersionedDictionary>(std::make_shared<FrontCodedDictionary>(keys));
+    } else {
+        dictionary = std::make_shared<VersionedDictionary>();
+        dictionary->reserve(keys.size());
+        for (std::string_view key : keys) {
+            dictionary->insert(key);
+        }
+    }
+
+    std::shared_ptr<const PackedColumn> packed;
+    if (packedStorage) {
+        packed = packColumn(*encodedColumn, numRows);
+    }
+    auto* next = new Version{std::move(dictionary), static_cast<int>(keys.size()), std::move(encodedColumn),
+                             numRows, std::move(packed), ordered};
+    next->encodedFrom = encodedFrom;
+    if (prefixIndexed) {
+        std::vector<std::pair<std::string_view, int>> entries(keys.size());
+        for (size_t code = 0; code < keys.size(); ++code) {
+            entries[code] = {keys[code], static_cast<int>(code)};
+        }
+        next->prefixIndex = std::make_shared<PrefixIndex>(std::move(entries), static_cast<int>(keys.size()));
+    }
+    building.stop();
+    publish(next);
+}
+
+// Value of one comma-separated field of line, or empty when the line has fewer fields.
+// A quoted field may hold commas and doubled quotes; unescaped copies go to scratch.
+static std::string_view csvField(std::string_view line, int field, std::deque<std::string>& scratch) {
+    size_t pos = 0;
+    for (int f = 0;; ++f) {
+        std::string_view value;
+        size_t next;
+        bool escaped = false;
+        if (pos < line.size() && line[pos] == '"') {
+            size_t close = pos + 1;
+            while ((close = line.find('"', close)) != std::string_view::npos && close + 1 < line.size() && line[close + 1] == '"') {
+                escaped = true;
+                close += 2;
+            }
+            close = std::min(close, line.size());
+            value = line.substr(pos + 1, close - pos - 1);
+            next = line.find(',', close);
+        } else {
+            next = line.find(',', pos);
+            value = line.substr(pos, next - pos);
+        }
+        if (f == field) {
+            if (!escaped) {
+                return value;
+            }
+            std::string& unescaped = scratch.emplace_back();
+            for (size_t i = 0; i < value.size(); ++i) {
+                unescaped += value[i];
+                i += value[i] == '"'; // Skip the second quote of a pair
+            }
+            return unescaped;
+        }
+        if (next == std::string_view::npos) {
+            return {};
+        }
+        pos = next + 1;
+    }
+}
+
+// Value of the line at line (the whole line, or one CSV field of it), stepping line past it
+static std::string_view nextValue(const char*& line, const char* end, int field, std::deque<std::string>& scratch) {
+    const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+    std::string_view value(line, (lineEnd != nullptr ? lineEnd : end) - line);
+    line = lineEnd != nullptr ? lineEnd + 1 : end;
+    if (!value.empty() && value.back() == '\r') {
+        value.remove_suffix(1);
+    }
+    return field < 0 ? value : csvField(value, field, scratch);
+}
+
+// Lines in [begin, end), the last one counted even without its newline
+static size_t countLines(const char* begin, const char* end) {
+    size_t lines = 0;
+    for (const char* p = begin; p < end; ++lines) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = newline != nullptr ? newline + 1 : end;
+    }
+    return lines;
+}
+
+// Load a column file through the mapping in two streaming passes over its bytes. The file is
+// cut into chunks on line boundaries and their lines counted, which places each chunk in the
+// column; each chunk then tokenizes a block of lines at a time into views of the mapped bytes
+// and encodes them straight into its slice. No per-row string or view array is built. Chunks
+// run on the scan pool, at most numThreads at a time.
+bool DictionaryEncoder::load(const std::string& path, int numThreads, int field, bool skipHeader) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file) {
+        return false;
+    }
+    const char* begin = file->data();
+    const char* end = begin + file->size();
+    if (skipHeader && begin != end) {
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        begin = newline != nullptr ? newline + 1 : end;
     }
 
-    for (auto& thread : threads) {
-        thread.join();
+    // Chunks of about 1 MB, and several per thread, so a few long lines do not leave threads idle
+    numThreads = std::max(1, numThreads);
+    size_t numChunks = std::max(static_cast<size_t>(numThreads) * 4, static_cast<size_t>(end - begin) >> 20);
+    std::vector<const char*> bounds = {begin};
+    for (size_t c = 1; c < numChunks; ++c) {
+        const char* split = std::max(bounds.back(), begin + (end - begin) * c / numChunks);
+        const char* newline = split < end ? static_cast<const char*>(std::memchr(split, '\n', end - split)) : nullptr;
+        bounds.push_back(newline != nullptr ? newline + 1 : end);
     }
+    bounds.push_back(end);
 
-    // Merge thread-local dictionaries into the global dictionary
-    std::unordered_map<std::string, int> mergedDictionary;
-    for (const auto& localDict : localDictionaries) {
-        for (const auto& [key, value] : localDict) {
-            if (mergedDictionary.find(key) == mergedDictionary.end()) {
-                mergedDictionary[key] = nextId++;
+    EpochGuard guard;
+    ThreadPool& pool = *scanPool.load(std::memory_order_seq_cst);
+    auto forEachChunk = [&](auto&& fn) {
+        std::atomic<size_t> nextChunk = 0;
+        pool.parallelFor(std::min<size_t>(numThreads, pool.size()), [&](size_t) {
+            for (size_t c; (c = nextChunk.fetch_add(1, std::memory_order_relaxed)) < numChunks;) {
+                fn(c);
             }
+        });
+    };
+
+    EncoderStats::Timer tokenizing(statistics, EncoderStats::Operation::LoadTokenize);
+    std::vector<size_t> firstRows(numChunks + 1, 0);
+    forEachChunk([&](size_t c) { firstRows[c + 1] = countLines(bounds[c], bounds[c + 1]); });
+    std::partial_sum(firstRows.begin(), firstRows.end(), firstRows.begin());
+    size_t numRows = firstRows.back();
+
+    // Key count estimated on the lines at evenly spaced byte offsets
+    std::deque<std::string> sampleScratch;
+    std::vector<std::string_view> sample(std::min(numRows, ConcurrentDictionary::kSampleKeys));
+    for (size_t i = 0; i < sample.size(); ++i) {
+        const char* line = begin + (end - begin) * i / sample.size();
+        while (line > begin && line[-1] != '\n') {
+            --line;
         }
+        sample[i] = nextValue(line, end, field, sampleScratch);
     }
+    tokenizing.stop();
 
-    // Final encoding pass
-    encodedColumn.clear();
-    for (size_t i = 0; i < numThreads; ++i) {
-        for (size_t j = 0; j < localEncodedColumns[i].size(); ++j) {
-            const std::string& value = column[j + i * chunkSize];
-            encodedColumn.push_back(mergedDictionary[value]);
+    auto writer = lockWriter();
+    std::unique_ptr<ConcurrentDictionary> ids;
+    std::atomic<int> nextId = 0;
+    std::vector<std::deque<std::string>> scratch(numChunks); // Unescaped CSV values; the table references them
+    auto encodedColumn = std::make_shared<SegmentedColumn>();
+    encodedColumn->resize(numRows);
+    size_t maxKeys = ConcurrentDictionary::estimateKeys(numRows, std::span<const std::string_view>(sample));
+    EncoderStats::Timer hashing(statistics, EncoderStats::Operation::EncodeHash);
+    for (; !ids || ids->full(); maxKeys = std::min(numRows, 4 * maxKeys)) {
+        ids = std::make_unique<ConcurrentDictionary>(maxKeys);
+        nextId = 0;
+        forEachChunk([&](size_t c) {
+            const char* line = bounds[c];
+            size_t probes = 0;
+            encodedColumn->forEachSegmentMutable(firstRows[c], firstRows[c + 1], [&](int* codes, size_t count, size_t) {
+                constexpr size_t kBlock = 64;
+                std::string_view keys[kBlock];
+                for (size_t j = 0; j < count && !ids->full(); j += kBlock) {
+                    size_t block = std::min(kBlock, count - j);
+                    for (size_t k = 0; k < block; ++k) {
+                        keys[k] = nextValue(line, bounds[c + 1], field, scratch[c]);
+                    }
+                    ids->getOrInsertMany(keys, block, codes + j, nextId, probes);
+                }
+            });
+            statistics.add(EncoderStats::Counter::DictionaryLookups, firstRows[c + 1] - firstRows[c]);
+            statistics.add(EncoderStats::Counter::DictionaryProbes, probes);
+        });
+        if (ids->full()) {
+            scratch.assign(numChunks, {});
         }
     }
+    hashing.stop();
+    publishEncoded(*ids, nextId, std::move(encodedColumn), numThreads);
+    return true;
+}
+
+// Encode a batch of new rows against the existing dictionary and append them.
+// Existing codes never change, and new keys and rows land past the bounds of the
+// published version, so readers are never blocked while the batch is encoded.
+void DictionaryEncoder::append(const std::vector<std::string>& batch) {
+    auto writer = lockWriter();
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::Append);
+    statistics.add(EncoderStats::Counter::DictionaryLookups, batch.size());
+    const Version& v = *current.load(std::memory_order_relaxed); // Stable while writerMutex is held
+
+    std::vector<int> codes(batch.size());
+    int maxCode = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        codes[i] = v.dictionary->insert(batch[i]); // New keys get codes at or past v.keyCount
+        maxCode = std::max(maxCode, codes[i]);
+    }
 
-    dictionary = std::move(mergedDictionary);
+    // Codes too wide for the column move it to a wider copy; older versions keep the narrow one
+    auto* next = new Version(v);
+    if (!v.column->fits(maxCode)) {
+        next->column = v.column->withCodeBytes(SegmentedColumn::codeBytesFor(maxCode), v.rows);
+    }
+    next->column->append(codes.data(), codes.size());
+    next->keyCount = v.dictionary->codeBound();
+    next->rows = v.rows + batch.size();
+    next->codesOrdered = v.codesOrdered && next->keyCount == v.keyCount; // New codes follow arrival order, not key order
+    next->encodedFrom = nullptr; // The rows now span two vectors
+
+    // Extend a private copy of the packed column, repacking if the dictionary outgrew its width
+    if (v.packed) {
+        bool fits = std::all_of(codes.begin(), codes.end(), [&](int code) { return v.packed->fits(code); });
+        if (fits) {
+            auto packed = std::make_shared<PackedColumn>(*v.packed);
+            packed->append(codes.data(), codes.size());
+            next->packed = std::move(packed);
+        } else {
+            next->packed = packColumn(*next->column, next->rows);
+        }
+    }
+
+    // New keys are checked one by one past the index's bound; reindex once they are a sizable share
+    if (v.prefixIndex) {
+        size_t unindexed = next->keyCount - v.prefixIndex->codeBound() + (v.unindexedWrites ? v.unindexedWrites->count : 0);
+        if (unindexed > std::max<size_t>(1024, v.prefixIndex->size() / 8)) {
+            next->prefixIndex = buildPrefixIndex(*next->dictionary, next->keyCount);
+            next->unindexedWrites = nullptr;
+        }
+    }
+    publish(next);
 }
 
-// Write the encoded column to a file
+// Pack rows [0, rows) at the width of their largest code
+std::shared_ptr<const PackedColumn> DictionaryEncoder::packColumn(const SegmentedColumn& column, size_t rows) {
+    int maxCode = 0;
+    column.forEachSegment(0, rows, [&](const int* codes, size_t count, size_t) {
+        maxCode = std::max(maxCode, *std::max_element(codes, codes + count));
+    });
+    auto packed = std::make_shared<PackedColumn>();
+    packed->reset(maxCode);
+    column.forEachSegment(0, rows, [&](const int* codes, size_t count, size_t) {
+        packed->append(codes, count);
+    });
+    return packed;
+}
+
+// Enable or disable lexicographic code assignment for subsequent encode() calls
+void DictionaryEncoder::setOrderPreserving(bool enabled) {
+    auto writer = lockWriter();
+    orderPreserving = enabled;
+}
+
+// Index every key with a code below keyCount, aliases from Put() included
+std::shared_ptr<const PrefixIndex> DictionaryEncoder::buildPrefixIndex(const VersionedDictionary& dictionary, int keyCount) {
+    std::vector<std::pair<std::string_view, int>> entries;
+    std::deque<std::string> decoded; // Front-coded keys are only materialized during the forEach callback
+    bool transient = dictionary.frontCoded() != nullptr;
+    dictionary.forEach([&](std::string_view key, int code) {
+        if (code < keyCount) {
+            entries.emplace_back(transient ? std::string_view(decoded.emplace_back(key)) : key, code);
+        }
+    });
+    return std::make_shared<PrefixIndex>(std::move(entries), keyCount);
+}
+
+// Enable or disable the prefix index; the current keys are indexed right away
+void DictionaryEncoder::setPrefixIndex(bool enabled) {
+    auto writer = lockWriter();
+    const Version& v = *current.load(std::memory_order_relaxed);
+    prefixIndexed = enabled;
+    auto* next = new Version(v);
+    next->prefixIndex = enabled ? buildPrefixIndex(*v.dictionary, v.keyCount) : nullptr;
+    next->unindexedWrites = nullptr;
+    publish(next);
+}
+
+// Enable or disable front coding of the dictionary for subsequent encode() calls
+void DictionaryEncoder::setCompressedDictionary(bool enabled) {
+    auto writer = lockWriter();
+    compressedDictionary = enabled;
+}
+
+// Enable or disable the bit-packed copy of the encoded column
+void DictionaryEncoder::setPackedStorage(bool enabled) {
+    auto writer = lockWriter();
+    const Version& v = *current.load(std::memory_order_relaxed);
+    packedStorage = enabled;
+    auto* next = new Version(v);
+    next->packed = enabled ? packColumn(*v.column, v.rows) : nullptr;
+    publish(next);
+}
+
+size_t DictionaryEncoder::packedBytes() const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    return v.packed ? v.packed->memoryBytes() : 0;
+}
+
+size_t DictionaryEncoder::columnBytes() const {
+    EpochGuard guard;
+    return snapshot().column->memoryBytes();
+}
+
+unsigned DictionaryEncoder::codeBytes() const {
+    EpochGuard guard;
+    return snapshot().column->codeBytes();
+}
+
+size_t DictionaryEncoder::runEncodedSegments() const {
+    EpochGuard guard;
+    return snapshot().column->runEncodedSegments();
+}
+
+// Dictionary statistics are read under writerMutex, since append() updates them in place
+size_t DictionaryEncoder::dictionaryBytes() const {
+    auto writer = lockWriter();
+    return current.load(std::memory_order_relaxed)->dictionary->memoryBytes();
+}
+
+size_t DictionaryEncoder::distinctKeys() const {
+    auto writer = lockWriter();
+    return current.load(std::memory_order_relaxed)->dictionary->size();
+}
+
+// Rows formatted per task by writeEncodedColumn(), and the most characters one row takes
+static constexpr size_t kWriteRows = size_t(1) << 18;
+static constexpr size_t kMaxCodeChars = 12; // "-2147483648\n"
+
+// Write the encoded column to a file, one code per line. Blocks of rows are formatted in
+// parallel into buffers allocated once, then written in row order, one write per block.
 void DictionaryEncoder::writeEncodedColumn(const std::string& filename) {
-    std::ofstream file(filename);
+    std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Error opening file: " << filename << "\n";
         return;
     }
-    for (const auto& id : encodedColumn) {
-        file << id << "\n";
+    EpochGuard guard;
+    const Version& v = snapshot();
+    ThreadPool& pool = *scanPool.load(std::memory_order_seq_cst);
+    size_t numBlocks = (v.rows + kWriteRows - 1) / kWriteRows;
+    size_t batchBlocks = std::min(pool.size(), numBlocks);
+    std::vector<std::unique_ptr<char[]>> buffers(batchBlocks);
+    std::vector<size_t> lengths(batchBlocks);
+    for (auto& buffer : buffers) {
+        buffer = std::make_unique_for_overwrite<char[]>(kWriteRows * kMaxCodeChars);
+    }
+
+    for (size_t first = 0; first < numBlocks; first += batchBlocks) {
+        size_t count = std::min(batchBlocks, numBlocks - first);
+        pool.parallelFor(count, [&](size_t b) {
+            size_t begin = (first + b) * kWriteRows;
+            char* out = buffers[b].get();
+            v.column->forEachSegment(begin, std::min(v.rows, begin + kWriteRows), [&](const int* codes, size_t n, size_t) {
+                for (size_t i = 0; i < n; ++i) {
+                    out = std::to_chars(out, out + kMaxCodeChars, codes[i]).ptr;
+                    *out++ = '\n';
+                }
+            });
+            lengths[b] = out - buffers[b].get();
+        });
+        for (size_t b = 0; b < count; ++b) {
+            file.write(buffers[b].get(), lengths[b]);
+        }
+    }
+    if (!file) {
+        std::cerr << "Error writing file: " << filename << "\n";
     }
     file.close();
 }
@@ -73,29 +615,232 @@ void DictionaryEncoder::writeDictionary(const std::string& filename) {
         std::cerr << "Error opening file: " << filename << "\n";
         return;
     }
-    for (const auto& [key, value] : dictionary) {
-        file << key << "," << value << "\n";
+    EpochGuard guard;
+    const Version& v = snapshot();
+    v.dictionary->forEach([&](std::string_view key, int value) {
+        if (value < v.keyCount) {
+            file << key << "," << value << "\n";
+        }
+    });
+    file.close();
+}
+
+// Write the dictionary and encoded column as one binary image, one large write per section
+void DictionaryEncoder::writeBinary(const std::string& filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return;
+    }
+    EpochGuard guard;
+    const Version& v = snapshot();
+    const VersionedDictionary& dictionary = *v.dictionary;
+
+    // Entries: the key owning each code first, then keys whose code decodes to another key
+    std::vector<ColumnFileEntry> entries;
+    std::vector<int32_t> owners(v.keyCount, -1);
+    std::string heap;
+    std::string scratch;
+    auto addEntry = [&](std::string_view key, int code) {
+        entries.push_back({VersionedDictionary::hashKey(key), heap.size(), static_cast<uint32_t>(key.size()), code});
+        heap.append(key);
+    };
+    for (int code = 0; code < v.keyCount; ++code) {
+        if (std::optional<std::string_view> key = dictionary.ownerKey(code, scratch)) {
+            owners[code] = static_cast<int32_t>(entries.size());
+            addEntry(*key, code);
+        }
+    }
+    dictionary.forEach([&](std::string_view key, int code) {
+        if (code < v.keyCount && dictionary.ownerKey(code, scratch) != key) {
+            addEntry(key, code);
+        }
+    });
+
+    // Open-addressing index over the entries at 50% load
+    size_t slotCount = 16;
+    while (slotCount < 2 * entries.size()) {
+        slotCount <<= 1;
+    }
+    std::vector<uint32_t> slots(slotCount, 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        size_t pos = entries[i].hash & (slotCount - 1);
+        while (slots[pos] != 0) {
+            pos = (pos + 1) & (slotCount - 1);
+        }
+        slots[pos] = static_cast<uint32_t>(i + 1);
+    }
+
+    ColumnFileHeader header = {};
+    std::memcpy(header.magic, kColumnFileMagic, sizeof(header.magic));
+    header.version = kColumnFileVersion;
+    header.byteOrder = kColumnFileByteOrder;
+    header.flags = v.codesOrdered ? kColumnFileCodesOrdered : 0;
+    header.rows = v.rows;
+    header.keyCount = v.keyCount;
+    header.numEntries = entries.size();
+    header.slotCount = slotCount;
+    header.heapBytes = heap.size();
+    header.entriesOffset = alignColumnFileOffset(sizeof(header));
+    header.ownersOffset = alignColumnFileOffset(header.entriesOffset + entries.size() * sizeof(ColumnFileEntry));
+    header.slotsOffset = alignColumnFileOffset(header.ownersOffset + owners.size() * sizeof(int32_t));
+    header.heapOffset = alignColumnFileOffset(header.slotsOffset + slots.size() * sizeof(uint32_t));
+    header.codesOffset = alignColumnFileOffset(header.heapOffset + heap.size());
+    header.fileBytes = header.codesOffset + v.rows * sizeof(int);
+
+    // Sections are written in file order; padding brings each one to its aligned offset
+    static constexpr char padding[kColumnFileAlignment] = {};
+    auto writeSection = [&](uint64_t offset, const void* data, size_t bytes) {
+        file.write(padding, offset - static_cast<uint64_t>(file.tellp()));
+        file.write(static_cast<const char*>(data), bytes);
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(header.entriesOffset, entries.data(), entries.size() * sizeof(ColumnFileEntry));
+    writeSection(header.ownersOffset, owners.data(), owners.size() * sizeof(int32_t));
+    writeSection(header.slotsOffset, slots.data(), slots.size() * sizeof(uint32_t));
+    writeSection(header.heapOffset, heap.data(), heap.size());
+    writeSection(header.codesOffset, nullptr, 0);
+    v.column->forEachSegment(0, v.rows, [&](const int* codes, size_t count, size_t) {
+        file.write(reinterpret_cast<const char*>(codes), count * sizeof(int));
+    });
+    if (!file) {
+        std::cerr << "Error writing file: " << filename << "\n";
     }
     file.close();
 }
 
+// Map a file written by writeBinary() and publish it as the current version. The key
+// index, heap and codes are used where they lie in the mapping: nothing is parsed or
+// copied, and pages are read from disk only when a query touches them.
+bool DictionaryEncoder::open(const std::string& path) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file) {
+        return false;
+    }
+    ColumnFileHeader header;
+    bool valid = file->size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file->data(), sizeof(header));
+        valid = std::memcmp(header.magic, kColumnFileMagic, sizeof(header.magic)) == 0 &&
+                header.version == kColumnFileVersion && header.byteOrder == kColumnFileByteOrder &&
+                header.fileBytes == file->size() && header.keyCount <= INT32_MAX && header.rows <= INT32_MAX &&
+                header.slotCount > header.numEntries && (header.slotCount & (header.slotCount - 1)) == 0 &&
+                header.entriesOffset >= sizeof(header) &&
+                columnFileSectionFits(header.entriesOffset, header.numEntries, sizeof(ColumnFileEntry), header.ownersOffset) &&
+                columnFileSectionFits(header.ownersOffset, header.keyCount, sizeof(int32_t), header.slotsOffset) &&
+                columnFileSectionFits(header.slotsOffset, header.slotCount, sizeof(uint32_t), header.heapOffset) &&
+                columnFileSectionFits(header.heapOffset, header.heapBytes, 1, header.codesOffset) &&
+                columnFileSectionFits(header.codesOffset, header.rows, sizeof(int), header.fileBytes) &&
+                header.codesOffset + header.rows * sizeof(int) == header.fileBytes;
+    }
+    // The dictionary sections are checked whole, so lookups can trust them; the codes are not
+    // checked, and a code without a key decodes like a deleted one
+    const char* base = file->data();
+    if (valid) {
+        auto* entries = reinterpret_cast<const ColumnFileEntry*>(base + header.entriesOffset);
+        for (size_t i = 0; valid && i < header.numEntries; ++i) {
+            valid = entries[i].offset <= header.heapBytes && entries[i].length <= header.heapBytes - entries[i].offset &&
+                    entries[i].code >= 0 && static_cast<uint64_t>(entries[i].code) < header.keyCount;
+        }
+        auto* owners = reinterpret_cast<const int32_t*>(base + header.ownersOffset);
+        for (size_t code = 0; valid && code < header.keyCount; ++code) {
+            valid = owners[code] >= -1 && (owners[code] < 0 || static_cast<uint64_t>(owners[code]) < header.numEntries);
+        }
+        auto* slots = reinterpret_cast<const uint32_t*>(base + header.slotsOffset);
+        size_t used = 0;
+        for (size_t pos = 0; valid && pos < header.slotCount; ++pos) {
+            valid = slots[pos] <= header.numEntries;
+            used += slots[pos] != 0;
+        }
+        valid = valid && used < header.slotCount; // An empty slot ends every probe
+    }
+    if (!valid) {
+        std::cerr << "Invalid column file: " << path << "\n";
+        return false;
+    }
+
+    VersionedDictionary::Image image;
+    image.backing = file;
+    image.entries = reinterpret_cast<const ColumnFileEntry*>(base + header.entriesOffset);
+    image.numEntries = header.numEntries;
+    image.owners = reinterpret_cast<const int32_t*>(base + header.ownersOffset);
+    image.codeCount = static_cast<int>(header.keyCount);
+    image.slots = reinterpret_cast<const uint32_t*>(base + header.slotsOffset);
+    image.slotMask = header.slotCount - 1;
+    image.heap = base + header.heapOffset;
+
+    auto column = std::make_shared<SegmentedColumn>();
+    column->attach(reinterpret_cast<const int*>(base + header.codesOffset), header.rows, file);
+
+    auto writer = lockWriter();
+    std::shared_ptr<const PackedColumn> packed;
+    if (packedStorage) {
+        packed = packColumn(*column, header.rows); // Derived copy; the file stores the raw codes
+    }
+    auto* next = new Version{std::make_shared<VersionedDictionary>(std::move(image)), static_cast<int>(header.keyCount),
+                             std::move(column), header.rows, std::move(packed),
+                             (header.flags & kColumnFileCodesOrdered) != 0};
+    if (prefixIndexed) {
+        next->prefixIndex = buildPrefixIndex(*next->dictionary, next->keyCount);
+    }
+    publish(next);
+    return true;
+}
+
 // Decode the encoded column back into strings
 std::vector<std::string> DictionaryEncoder::decode() const {
+    return decode(0, SIZE_MAX);
+}
+
+// Decode rows [begin, end) through the reverse lookup table
+std::vector<std::string> DictionaryEncoder::decode(size_t begin, size_t end) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    end = std::min(end, v.rows);
     std::vector<std::string> decoded;
-    decoded.reserve(encodedColumn.size());
-    for (const auto& id : encodedColumn) {
-        for (const auto& [key, value] : dictionary) {
-            if (value == id) {
-                decoded.push_back(key);
-                break;
-            }
+    if (begin >= end) {
+        return decoded;
+    }
+    decoded.reserve(end - begin);
+    std::string scratch;
+    v.column->forEachSegment(begin, end, [&](const int* codes, size_t count, size_t) {
+        for (size_t i = 0; i < count; ++i) {
+            decoded.emplace_back(v.dictionary->key(codes[i], scratch)); // Empty string for deleted codes
+        }
+    });
+    return decoded;
+}
+
+// Decode rows [begin, begin + out.size()) into caller-provided storage
+void DictionaryEncoder::decodeInto(size_t begin, std::span<std::string> out) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    size_t count = begin < v.rows ? std::min(out.size(), v.rows - begin) : 0;
+    std::string scratch;
+    v.column->forEachSegment(begin, begin + count, [&](const int* codes, size_t n, size_t firstRow) {
+        for (size_t i = 0; i < n; ++i) {
+            out[firstRow - begin + i].assign(v.dictionary->key(codes[i], scratch));
+        }
+    });
+}
+
+// Late materialization: only rows that survived a filter are translated to strings
+std::vector<std::string> DictionaryEncoder::decodeRows(const Bitmap& selection) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    std::vector<std::string> decoded;
+    decoded.reserve(selection.count());
+    std::string scratch;
+    for (size_t row : selection) {
+        if (row >= v.rows) {
+            break;
         }
+        decoded.emplace_back(v.dictionary->key((*v.column)[row], scratch));
     }
     return decoded;
 }
 
 int DictionaryEncoder::vanillaQueryValue(const std::vector<std::string>& column, const std::string& value) {
-    std::shared_lock lock(dictMutex);
     size_t index = 0;
     // Perform a linear search in the raw data column
     for (const auto& data : column) {
@@ -109,76 +854,303 @@ int DictionaryEncoder::vanillaQueryValue(const std::vector<std::string>& column,
 
 // Non SIMD Single Value Search
 int DictionaryEncoder::queryValueNonSIMD(const std::string& value) const {
-    std::shared_lock lock(dictMutex);
-    auto it = dictionary.find(value);
-    if (it == dictionary.end()) {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryValue);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    int code = findCode(v, value);
+    if (code < 0) {
         return -1;
     }
 
-    size_t i = 0;
-    for(; i < encodedColumn.size(); i++) {
-        if (encodedColumn[i] == it->second) {
-            return i;
+    // Row by row, over the zones that may hold the code
+    long found = -1;
+    size_t skipped = forEachZoneRun(*v.column, 0, v.rows, zonesHolding(code), [&](ZoneAction, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if ((*v.column)[i] == code) {
+                found = static_cast<long>(i);
+                return false;
+            }
         }
-    }
-    
-    return -1;
+        return true;
+    });
+
+    size_t scannedRows = (found < 0 ? v.rows : static_cast<size_t>(found) + 1) - skipped;
+    statistics.scanned(scannedRows, scannedRows * v.column->codeBytes());
+    statistics.add(EncoderStats::Counter::RowsSkipped, skipped);
+    statistics.matched(found < 0 ? 0 : 1);
+    return static_cast<int>(found);
 }
 
 int DictionaryEncoder::queryValueSIMD(const std::string& value) const {
-    std::shared_lock lock(dictMutex);
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryValue);
+    EpochGuard guard;
+    const Version& v = snapshot();
 
     // Perform a dictionary lookup for the value
-    auto it = dictionary.find(value);
-    if (it == dictionary.end()) {
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    int code = findCode(v, value);
+    if (code < 0) {
         return -1; // Value not found in dictionary
     }
 
-    int dictValue = it->second; // Get the encoded value
-    size_t n = encodedColumn.size();
+    // Dispatched SIMD scan for the first occurrence of the code at the stored width, over the
+    // zones whose summaries admit it
+    const ScanKernels& kernels = scanKernels();
+    long found = -1;
+    size_t skipped = forEachZoneRun(*v.column, 0, v.rows, zonesHolding(code), [&](ZoneAction, size_t begin, size_t end) {
+        v.column->forEachStoredSegment(begin, end, [&](const auto* codes, size_t count, size_t firstRow) {
+            if (found < 0) {
+                long row = kernels.forCodes(codes).findEqual(codes, count, code);
+                if (row >= 0) {
+                    found = static_cast<long>(firstRow) + row;
+                }
+            }
+        }, [&](int runCode, size_t first, size_t) {
+            if (found < 0 && runCode == code) {
+                found = static_cast<long>(first);
+            }
+        });
+        return found < 0;
+    });
+    size_t scannedRows = (found < 0 ? v.rows : static_cast<size_t>(found) + 1) - skipped;
+    statistics.scanned(scannedRows, scannedRows * v.column->codeBytes());
+    statistics.add(EncoderStats::Counter::RowsSkipped, skipped);
+    statistics.matched(found < 0 ? 0 : 1);
+    return static_cast<int>(found);
+}
+
+// SIMD search for every row holding value
+std::vector<int> DictionaryEncoder::queryValueAll(const std::string& value) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryValue);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    std::vector<int> results;
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    int code = findCode(v, value);
+    if (code < 0) {
+        return results;
+    }
+    results.resize(v.rows);
+    size_t found = 0;
+    size_t skipped = forEachZoneRun(*v.column, 0, v.rows, zonesHolding(code), [&](ZoneAction, size_t begin, size_t end) {
+        v.column->forEachSegment(begin, end, [&](const int* codes, size_t count, size_t firstRow) {
+            int* out = results.data() + found;
+            size_t matched = scanKernels().selectEqual(codes, count, code, out);
+            for (size_t i = 0; i < matched; ++i) {
+                out[i] += static_cast<int>(firstRow); // Segment-relative -> column row
+            }
+            found += matched;
+        }, [&](int runCode, size_t first, size_t last) {
+            if (runCode == code) {
+                std::iota(results.begin() + found, results.begin() + found + (last - first), static_cast<int>(first));
+                found += last - first;
+            }
+        });
+        return true;
+    });
+    results.resize(found);
+    statistics.scanned(v.rows - skipped, (v.rows - skipped) * v.column->codeBytes());
+    statistics.add(EncoderStats::Counter::RowsSkipped, skipped);
+    statistics.matched(found);
+    return results;
+}
 
-    // Prepare SIMD register for the dictionary value
-    __m256i targetVec = _mm256_set1_epi32(dictValue); // Set all 32-bit lanes to the target value
+// Distinct codes of a batch of lookups as a bitset over the version's codes. A code's
+// index among the distinct codes is its rank in the set: rank[code / 32] plus the set
+// bits below it in its word.
+struct LookupBatch {
+    std::vector<int> targets;   // Per value: index of its code, or -1 when the value is absent
+    std::vector<uint32_t> set;  // Bit per batch code
+    std::vector<uint32_t> rank; // Set bits in the words before each word
+    size_t numCodes = 0;
+    int minCode = INT_MAX, maxCode = INT_MIN; // Bounds and zone mask of the batch codes, for skipping zones
+    uint64_t zoneMask = 0;
 
-    // Process the encoded column in chunks of 8 (for 32-bit integers)
-    size_t i = 0;
-    for (; i + 7 < n; i += 8) {
-        // Load 8 elements from the encoded column
-        __m256i columnVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&encodedColumn[i]));
+    bool contains(int code) const {
+        return code >= 0 && static_cast<size_t>(code >> 5) < set.size() && (set[code >> 5] >> (code & 31) & 1) != 0;
+    }
+    size_t indexOf(int code) const {
+        uint32_t below = set[code >> 5] & ((1u << (code & 31)) - 1);
+        return rank[code >> 5] + __builtin_popcount(below);
+    }
+};
 
-        // Compare with the target value
-        __m256i cmpResult = _mm256_cmpeq_epi32(columnVec, targetVec);
+static LookupBatch lookupBatch(const VersionedDictionary& dictionary, int keyCount, std::span<const std::string> values) {
+    LookupBatch batch;
+    std::vector<int> codes(values.size());
+    dictionary.findMany(values, codes.data());
+    batch.set.assign((static_cast<size_t>(keyCount) + 31) / 32, 0);
+    for (int code : codes) {
+        if (code >= 0 && code < keyCount) {
+            batch.set[code >> 5] |= 1u << (code & 31);
+            batch.minCode = std::min(batch.minCode, code);
+            batch.maxCode = std::max(batch.maxCode, code);
+            batch.zoneMask |= SegmentedColumn::zoneBit(code);
+        }
+    }
+    batch.rank.resize(batch.set.size());
+    for (size_t w = 0; w < batch.set.size(); ++w) {
+        batch.rank[w] = static_cast<uint32_t>(batch.numCodes);
+        batch.numCodes += __builtin_popcount(batch.set[w]);
+    }
+    batch.targets.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        bool visible = codes[i] >= 0 && codes[i] < keyCount;
+        batch.targets[i] = visible ? static_cast<int>(batch.indexOf(codes[i])) : -1;
+    }
+    return batch;
+}
 
-        // Extract matching indices
-        int mask = _mm256_movemask_epi8(cmpResult); // Create a mask of matching elements
-        if (mask != 0) {
-            // Return the index of the first match
-            for (int j = 0; j < 8; ++j) {
-                if (mask & (1 << (j * 4))) {
-                    return static_cast<int>(i + j);
+// One pass over rows [0, rows) with the bitset membership kernel: onMatch(row, code index)
+// for each row holding a batch code, in row order, until onMatch returns false. Zones that
+// hold none of the batch codes are skipped.
+template <typename OnMatch>
+static void scanBatch(const SegmentedColumn& column, size_t rows, int keyCount, const LookupBatch& batch, OnMatch onMatch) {
+    if (batch.numCodes == 0) {
+        return;
+    }
+    const ScanKernels& kernels = scanKernels();
+    std::vector<uint64_t> words;
+    bool done = false;
+    auto classify = [&](const SegmentedColumn::Zone& zone) {
+        return zone.mayContainAny(batch.minCode, batch.maxCode, batch.zoneMask) ? ZoneAction::Scan : ZoneAction::Skip;
+    };
+    forEachZoneRun(column, 0, rows, classify, [&](ZoneAction, size_t begin, size_t end) {
+        column.forEachSegment(begin, end, [&](const int* codes, size_t count, size_t firstRow) {
+            if (done) {
+                return;
+            }
+            words.assign((count + 63) / 64, 0);
+            kernels.scanMember(codes, count, batch.set.data(), keyCount, words.data());
+            for (size_t w = 0; w < words.size() && !done; ++w) {
+                for (uint64_t bits = words[w]; bits != 0 && !done; bits &= bits - 1) {
+                    size_t i = w * 64 + __builtin_ctzll(bits);
+                    done = !onMatch(firstRow + i, batch.indexOf(codes[i]));
                 }
             }
+        }, [&](int code, size_t first, size_t last) {
+            if (done || !batch.contains(code)) {
+                return;
+            }
+            size_t index = batch.indexOf(code);
+            for (size_t row = first; row < last && !done; ++row) {
+                done = !onMatch(row, index);
+            }
+        });
+        return !done;
+    });
+}
+
+std::vector<int> DictionaryEncoder::queryValuesFirst(std::span<const std::string> values) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    LookupBatch batch = lookupBatch(*v.dictionary, v.keyCount, values);
+    std::vector<int> first(batch.numCodes, -1);
+    size_t remaining = batch.numCodes;
+    scanBatch(*v.column, v.rows, v.keyCount, batch, [&](size_t row, size_t index) {
+        if (first[index] < 0) {
+            first[index] = static_cast<int>(row);
+            --remaining;
+        }
+        return remaining > 0; // Stop once every code has been seen
+    });
+
+    std::vector<int> results(values.size(), -1);
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (batch.targets[i] >= 0) {
+            results[i] = first[batch.targets[i]];
         }
     }
+    return results;
+}
 
-    // Scalar loop for remaining elements
-    for (; i < n; ++i) {
-        if (encodedColumn[i] == dictValue) {
-            return static_cast<int>(i); // Return the index of the first match
+std::vector<std::vector<int>> DictionaryEncoder::queryValuesAll(std::span<const std::string> values) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    LookupBatch batch = lookupBatch(*v.dictionary, v.keyCount, values);
+    std::vector<std::vector<int>> rows(batch.numCodes);
+    scanBatch(*v.column, v.rows, v.keyCount, batch, [&](size_t row, size_t index) {
+        rows[index].push_back(static_cast<int>(row));
+        return true;
+    });
+
+    // Repeated values share one row list; the last of them takes it over
+    std::vector<std::vector<int>> results(values.size());
+    std::vector<size_t> lastUse(batch.numCodes);
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (batch.targets[i] >= 0) {
+            lastUse[batch.targets[i]] = i;
         }
     }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (int index = batch.targets[i]; index >= 0) {
+            results[i] = lastUse[index] == i ? std::move(rows[index]) : rows[index];
+        }
+    }
+    return results;
+}
+
+std::vector<size_t> DictionaryEncoder::queryValuesCount(std::span<const std::string> values) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    LookupBatch batch = lookupBatch(*v.dictionary, v.keyCount, values);
+    std::vector<size_t> counts(batch.numCodes, 0);
+    scanBatch(*v.column, v.rows, v.keyCount, batch, [&](size_t, size_t index) {
+        ++counts[index];
+        return true;
+    });
 
-    return -1; // No match found
+    std::vector<size_t> results(values.size(), 0);
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (batch.targets[i] >= 0) {
+            results[i] = counts[batch.targets[i]];
+        }
+    }
+    return results;
+}
+
+// Equality scan into a row bitmap, for combining with other predicates
+Bitmap DictionaryEncoder::queryEqual(const std::string& value) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryEqual);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    int code = findCode(v, value);
+    if (code < 0) {
+        return Bitmap(v.rows);
+    }
+    return scanCodeList(v, {code}, false);
+}
+
+// Past this many target codes, one bitset probe per row beats one compare per code
+static constexpr size_t kAnyOfCodes = 16;
+
+// Bitset over codes [0, keyCount) with the bits of codes set
+static std::vector<uint32_t> codeSet(const std::vector<int>& codes, int keyCount) {
+    std::vector<uint32_t> set((static_cast<size_t>(keyCount) + 31) / 32, 0);
+    for (int code : codes) {
+        set[code >> 5] |= 1u << (code & 31);
+    }
+    return set;
+}
+
+// Membership of one code, as scanAnyOf (set empty) or scanMember would decide it
+static bool codeIn(int code, const std::vector<int>& codes, const std::vector<uint32_t>& set, int keyCount) {
+    if (set.empty()) {
+        return std::find(codes.begin(), codes.end(), code) != codes.end();
+    }
+    return code >= 0 && code < keyCount && (set[code >> 5] >> (code & 31) & 1) != 0;
 }
 
 // Baseline vanilla prefix scan on raw data
-std::vector<int> DictionaryEncoder::vanillaQueryPrefix(const std::vector<std::string>& column, const std::string& prefix) {
-    std::vector<int> results;
+Bitmap DictionaryEncoder::vanillaQueryPrefix(const std::vector<std::string>& column, const std::string& prefix) {
+    Bitmap results(column.size());
     size_t index = 0;
 
     for (const auto& value : column) {
         if (value.compare(0, prefix.size(), prefix) == 0) { // Check if the prefix matches
-            results.push_back(index);
+            results.set(index);
         }
         ++index;
     }
@@ -187,18 +1159,30 @@ std::vector<int> DictionaryEncoder::vanillaQueryPrefix(const std::vector<std::st
 }
 
 // Non SIMD Prefix Query
-std::vector<int> DictionaryEncoder::queryPrefixNonSIMD(const std::string& prefix) const {
-    std::vector<int> matchingIndices;
+Bitmap DictionaryEncoder::queryPrefixNonSIMD(const std::string& prefix) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryPrefix);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    size_t n = v.rows;
+    Bitmap matchingIndices(n);
 
     // Early exit for empty prefix - return all indices
     if (prefix.empty()) {
-        matchingIndices.reserve(encodedColumn.size());
-        for (size_t i = 0; i < encodedColumn.size(); ++i) {
-            matchingIndices.push_back(static_cast<int>(i));
+        return ~matchingIndices;
+    }
+
+    // Order-preserving dictionary: matching keys share one code interval
+    if (v.codesOrdered) {
+        auto [lo, hi] = prefixCodeRange(v, prefix);
+        unsigned width = static_cast<unsigned>(hi - lo);
+        for (size_t i = 0; i < n; ++i) {
+            if (static_cast<unsigned>((*v.column)[i] - lo) < width) {
+                matchingIndices.set(i);
+            }
         }
-        return matchingIndices;
+        return recordScan(v, std::move(matchingIndices));
     }
-    
+
     // // direct (inefficient) implementation
     // for (const auto& [dictWord, dictIndex] : dictionary) {
     //     // Check if dictionary word starts with the prefix
@@ -206,152 +1190,1217 @@ std::vector<int> DictionaryEncoder::queryPrefixNonSIMD(const std::string& prefix
     //         dictWord.compare(0, prefix.size(), prefix) == 0) {
     //         for (size_t i = 0; i < encodedColumn.size(); ++i) {
     //             if (dictIndex == encodedColumn[i]) {
-    //                 matchingIndices.push_back(static_cast<int>(i));
+    //                 matchingIndices.set(i);
     //             }
     //         }
     //     }
     // }
 
-    // optimized implementation
-    std::unordered_set<int> matchingCodes;
-    for (const auto& [dictWord, dictIndex] : dictionary) {
-        // Check if dictionary word starts with the prefix
-        if (dictWord.size() >= prefix.size() &&
-            dictWord.compare(0, prefix.size(), prefix) == 0) {
-            matchingCodes.insert(dictIndex);
-        }
-    }
+    // optimized implementation: matching codes come from the prefix index when there is one
+    std::vector<int> codes = prefixCodes(v, prefix);
+    std::unordered_set<int> matchingCodes(codes.begin(), codes.end());
 
     // Early exit if no matches
     if (matchingCodes.empty()) {
         return matchingIndices;
     }
 
-    matchingIndices.reserve(encodedColumn.size()); // Reserve space for potential matches
-    for (size_t i = 0; i < encodedColumn.size(); ++i) {
-        if (matchingCodes.count(encodedColumn[i])) {
-            matchingIndices.push_back(static_cast<int>(i));
+    for (size_t i = 0; i < n; ++i) {
+        if (matchingCodes.count((*v.column)[i])) {
+            matchingIndices.set(i);
         }
     }
 
-    return matchingIndices;
+    return recordScan(v, std::move(matchingIndices));
 }
 
-std::vector<int> DictionaryEncoder::queryPrefixSIMD(const std::string& prefix) const {
-    std::vector<int> results;
-    std::shared_lock lock(dictMutex);
+Bitmap DictionaryEncoder::queryPrefixSIMD(const std::string& prefix) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryPrefix);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    size_t n = v.rows;
+    Bitmap results(n);
 
-    // Step 1: Collect matching dictionary values into an unordered_set
-    std::unordered_set<int> matchingCodes;
-    alignas(32) char paddedPrefix[32] = {0};
-    std::memcpy(paddedPrefix, prefix.data(), std::min(prefix.size(), size_t(32)));
+    // Order-preserving dictionary: one range compare per row instead of one compare per matching code
+    if (v.codesOrdered) {
+        auto [lo, hi] = prefixCodeRange(v, prefix);
+        return scanCodeRangeSIMD(v, lo, hi);
+    }
+
+    const ScanKernels& kernels = scanKernels();
 
-    __m256i prefixVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(paddedPrefix));
-    int prefixMask = (1 << prefix.size()) - 1; // Precompute mask for prefix length
+    // Step 1: Collect matching dictionary values from the prefix index, or else with the SIMD prefix comparison
+    std::vector<int> matchingCodes;
+    if (v.prefixIndex) {
+        matchingCodes = prefixCodes(v, prefix);
+    } else {
+        v.dictionary->forEach([&](std::string_view key, int value) {
+            // Skip keys shorter than the prefix and keys added after this version
+            if (value >= v.keyCount || key.size() < prefix.size()) {
+                return;
+            }
+            if (kernels.prefixMatch(key.data(), prefix.data(), prefix.size())) {
+                matchingCodes.push_back(value);
+            }
+        });
+    }
+
+    // Early truncation if no matching codes found
+    if (matchingCodes.empty()) {
+        return results;
+    }
 
-    for (const auto& [key, value] : dictionary) {
-        // Skip keys shorter than the prefix
-        if (key.size() < prefix.size()) {
+    // Step 2: SIMD scan of the encodedColumn against all matching codes: a compare per code
+    // for short lists, one bitset probe per row for long ones
+    return scanCodeList(v, matchingCodes, matchingCodes.size() > kAnyOfCodes);
+}
+
+// Serial scan for the rows holding any of codes: one compare per code and row, or with
+// useSet one bitset probe per row. Zones holding none of the codes are skipped.
+Bitmap DictionaryEncoder::scanCodeList(const Version& v, const std::vector<int>& codes, bool useSet) const {
+    Bitmap results(v.rows);
+    const ScanKernels& kernels = scanKernels();
+    if (codes.size() == 1 && !useSet) {
+        int code = codes[0];
+        size_t skipped = forEachZoneRun(*v.column, 0, v.rows, zonesHolding(code), [&](ZoneAction, size_t begin, size_t end) {
+            v.column->forEachStoredSegment(begin, end, [&](const auto* stored, size_t count, size_t firstRow) {
+                kernels.forCodes(stored).scanEqual(stored, count, code, results.data() + firstRow / 64);
+            }, [&](int runCode, size_t first, size_t last) {
+                if (runCode == code) {
+                    results.setRange(first, last);
+                }
+            });
+            return true;
+        });
+        return recordScan(v, std::move(results), skipped);
+    }
+
+    std::vector<uint32_t> set = useSet ? codeSet(codes, v.keyCount) : std::vector<uint32_t>();
+    int minCode = INT_MAX, maxCode = INT_MIN;
+    uint64_t mask = 0;
+    for (int code : codes) {
+        minCode = std::min(minCode, code);
+        maxCode = std::max(maxCode, code);
+        mask |= SegmentedColumn::zoneBit(code);
+    }
+    auto classify = [&](const SegmentedColumn::Zone& zone) {
+        return zone.mayContainAny(minCode, maxCode, mask) ? ZoneAction::Scan : ZoneAction::Skip;
+    };
+    size_t skipped = forEachZoneRun(*v.column, 0, v.rows, classify, [&](ZoneAction, size_t begin, size_t end) {
+        v.column->forEachSegment(begin, end, [&](const int* segment, size_t count, size_t firstRow) {
+            if (set.empty()) {
+                kernels.scanAnyOf(segment, count, codes.data(), codes.size(), results.data() + firstRow / 64);
+            } else {
+                kernels.scanMember(segment, count, set.data(), v.keyCount, results.data() + firstRow / 64);
+            }
+        }, [&](int code, size_t first, size_t last) {
+            if (codeIn(code, codes, set, v.keyCount)) {
+                results.setRange(first, last);
+            }
+        });
+        return true;
+    });
+    return recordScan(v, std::move(results), skipped);
+}
+
+// Range query over [lo, hi) in key order
+Bitmap DictionaryEncoder::queryRange(const std::string& lo, const std::string& hi) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryRange);
+    EpochGuard guard;
+    const Version& v = snapshot();
+
+    if (v.codesOrdered) {
+        auto [loCode, hiCode] = codeRange(v, lo, hi);
+        return scanCodeRangeSIMD(v, loCode, hiCode);
+    }
+
+    // Unordered codes: collect every code whose key falls in range, then probe per row
+    size_t n = v.rows;
+    Bitmap results(n);
+    std::vector<int> codes = rangeCodes(v, lo, hi);
+    std::unordered_set<int> matchingCodes(codes.begin(), codes.end());
+    if (matchingCodes.empty()) {
+        return results;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (matchingCodes.count((*v.column)[i])) {
+            results.set(i);
+        }
+    }
+    return recordScan(v, std::move(results));
+}
+
+// Binary search over codes [first, last) for the first code whose key fails pred
+// (keys are sorted by code while codesOrdered)
+template <typename Pred>
+static int partitionCodes(const VersionedDictionary& keys, int first, int last, Pred pred) {
+    std::string scratch;
+    while (first < last) {
+        int mid = first + (last - first) / 2;
+        if (pred(keys.key(mid, scratch))) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    return first;
+}
+
+// Front-coded base holding exactly the codes of v, whose searches run on the compressed keys
+static const FrontCodedDictionary* sortedKeys(const VersionedDictionary& dictionary, int keyCount) {
+    const FrontCodedDictionary* sorted = dictionary.frontCoded();
+    return sorted && static_cast<int>(sorted->size()) == keyCount ? sorted : nullptr;
+}
+
+// Map the key range [lo, hi) to its code interval with two binary searches
+std::pair<int, int> DictionaryEncoder::codeRange(const Version& v, const std::string& lo, const std::string& hi) {
+    if (const FrontCodedDictionary* sorted = sortedKeys(*v.dictionary, v.keyCount)) {
+        int first = sorted->lowerBound(lo);
+        return {first, std::max(first, sorted->lowerBound(hi))};
+    }
+    int first = partitionCodes(*v.dictionary, 0, v.keyCount, [&](std::string_view key) { return key < lo; });
+    int last = partitionCodes(*v.dictionary, first, v.keyCount, [&](std::string_view key) { return key < hi; });
+    return {first, last};
+}
+
+// Map all keys starting with prefix to their code interval
+std::pair<int, int> DictionaryEncoder::prefixCodeRange(const Version& v, const std::string& prefix) {
+    if (const FrontCodedDictionary* sorted = sortedKeys(*v.dictionary, v.keyCount)) {
+        return sorted->prefixRange(prefix);
+    }
+    int first = partitionCodes(*v.dictionary, 0, v.keyCount, [&](std::string_view key) { return key < prefix; });
+    // Truncated keys are non-decreasing, so the prefix block ends at the first key whose head exceeds prefix
+    int last = partitionCodes(*v.dictionary, first, v.keyCount, [&](std::string_view key) {
+        return key.substr(0, prefix.size()) <= prefix;
+    });
+    return {first, last};
+}
+
+// SIMD scan for lo <= code < hi using a single unsigned compare per lane. Zones outside the
+// range are skipped and zones inside it are taken whole, so on a column sorted or clustered
+// by key only the zones straddling lo or hi are read.
+Bitmap DictionaryEncoder::scanCodeRangeSIMD(const Version& v, int lo, int hi) const {
+    Bitmap results(v.rows);
+    if (lo >= hi) {
+        return recordScan(v, std::move(results), v.rows);
+    }
+    const ScanKernels& kernels = scanKernels();
+    size_t taken = 0;
+    size_t skipped = forEachZoneRun(*v.column, 0, v.rows, zonesInRange(lo, hi), [&](ZoneAction action, size_t begin, size_t end) {
+        if (action == ZoneAction::Take) {
+            results.setRange(begin, end);
+            taken += end - begin;
+            return true;
+        }
+        v.column->forEachStoredSegment(begin, end, [&](const auto* codes, size_t count, size_t firstRow) {
+            kernels.forCodes(codes).scanRange(codes, count, lo, hi, results.data() + firstRow / 64);
+        }, [&](int runCode, size_t first, size_t last) {
+            if (runCode >= lo && runCode < hi) {
+                results.setRange(first, last);
+            }
+        });
+        return true;
+    });
+    return recordScan(v, std::move(results), skipped + taken);
+}
+
+// Codes of the keys matching a predicate from a prefix index answer: the indexed codes
+// of keys written since the index was built are replaced by their current ones, and the
+// keys appended since are checked one by one past the index's bound
+template <typename Matches>
+std::vector<int> DictionaryEncoder::indexedCodes(const Version& v, std::span<const int> indexed, Matches&& matches) {
+    std::vector<int> codes(indexed.begin(), indexed.end());
+    std::string scratch;
+    for (int code = v.prefixIndex->codeBound(); code < v.keyCount; ++code) {
+        std::optional<std::string_view> key = v.dictionary->ownerKey(code, scratch); // Deleted keys match nothing
+        if (key && matches(*key)) {
+            codes.push_back(code);
+        }
+    }
+    if (!v.unindexedWrites) {
+        return codes;
+    }
+    std::unordered_set<std::string_view> written;
+    std::vector<int> stale;
+    for (const UnindexedWrite* write = v.unindexedWrites.get(); write != nullptr; write = write->older.get()) {
+        if (!matches(write->key) || !written.insert(write->key).second) {
             continue;
         }
+        std::span<const int> exact = v.prefixIndex->range(write->key, write->key + '\0'); // The key's code when indexed
+        stale.insert(stale.end(), exact.begin(), exact.end());
+        int code = v.dictionary->find(write->key);
+        if (code >= 0 && code < v.keyCount) {
+            codes.push_back(code);
+        }
+    }
+    // Drop one indexed occurrence per stale code: another matching key may share the code
+    std::sort(stale.begin(), stale.end());
+    std::sort(codes.begin(), codes.begin() + indexed.size());
+    auto staleCode = stale.begin();
+    auto kept = std::remove_if(codes.begin(), codes.begin() + indexed.size(), [&](int code) {
+        while (staleCode != stale.end() && *staleCode < code) {
+            ++staleCode;
+        }
+        if (staleCode != stale.end() && *staleCode == code) {
+            ++staleCode;
+            return true;
+        }
+        return false;
+    });
+    codes.erase(kept, codes.begin() + indexed.size());
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+    return codes;
+}
+
+// Collect the codes of every dictionary key starting with prefix: one trie descent when v
+// has a prefix index, plus a check of the keys appended or written since it was built
+std::vector<int> DictionaryEncoder::prefixCodes(const Version& v, const std::string& prefix) {
+    auto matches = [&](std::string_view key) { return key.substr(0, prefix.size()) == prefix; };
+    if (v.prefixIndex) {
+        return indexedCodes(v, v.prefixIndex->prefix(prefix), matches);
+    }
+    std::vector<int> codes;
+    v.dictionary->forEach([&](std::string_view key, int value) {
+        if (value < v.keyCount && matches(key)) {
+            codes.push_back(value);
+        }
+    });
+    return codes;
+}
+
+// Collect the codes of every dictionary key in [lo, hi), like prefixCodes()
+std::vector<int> DictionaryEncoder::rangeCodes(const Version& v, const std::string& lo, const std::string& hi) {
+    auto matches = [&](std::string_view key) { return key >= lo && key < hi; };
+    if (v.prefixIndex) {
+        return indexedCodes(v, v.prefixIndex->range(lo, hi), matches);
+    }
+    std::vector<int> codes;
+    v.dictionary->forEach([&](std::string_view key, int value) {
+        if (value < v.keyCount && matches(key)) {
+            codes.push_back(value);
+        }
+    });
+    return codes;
+}
+
+// Successor lookup: the index's lower bound, or a full pass, plus the keys appended since indexing
+std::optional<std::string> DictionaryEncoder::nextKey(const std::string& key) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    std::optional<std::string> best;
+    auto consider = [&](std::string_view candidate) {
+        if (candidate >= key && (!best || candidate < *best)) {
+            best = std::string(candidate);
+        }
+    };
+    std::string scratch;
+    if (v.prefixIndex) {
+        // Indexed keys written since are skipped; the ones still present are considered below
+        std::unordered_set<std::string_view> written;
+        for (const UnindexedWrite* write = v.unindexedWrites.get(); write != nullptr; write = write->older.get()) {
+            written.insert(write->key);
+        }
+        for (size_t rank = v.prefixIndex->lowerBound(key); rank < v.prefixIndex->size(); ++rank) {
+            std::string indexed = v.prefixIndex->keyAt(rank);
+            if (!written.contains(indexed)) {
+                best = std::move(indexed);
+                break;
+            }
+        }
+        for (std::string_view candidate : written) {
+            int code = v.dictionary->find(candidate);
+            if (code >= 0 && code < v.keyCount) {
+                consider(candidate);
+            }
+        }
+        for (int code = v.prefixIndex->codeBound(); code < v.keyCount; ++code) {
+            if (std::optional<std::string_view> candidate = v.dictionary->ownerKey(code, scratch)) {
+                consider(*candidate);
+            }
+        }
+        return best;
+    }
+    v.dictionary->forEach([&](std::string_view candidate, int value) {
+        if (value < v.keyCount) {
+            consider(candidate);
+        }
+    });
+    return best;
+}
 
-        // Load the first 32 bytes of the key directly
-        const char* keyData = key.data();
-        __m256i keyVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keyData));
-        __m256i cmpResult = _mm256_cmpeq_epi8(prefixVec, keyVec);
+// Single-item search on the bit-packed column
+int DictionaryEncoder::queryValuePacked(const std::string& value) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    if (!v.packed) {
+        return queryValueSIMD(value);
+    }
+    int code = findCode(v, value);
+    if (code < 0) {
+        return -1;
+    }
+    return static_cast<int>(v.packed->findFirst(code));
+}
 
-        int mask = _mm256_movemask_epi8(cmpResult);
+// Prefix scan on the bit-packed column: one range predicate when codes are ordered, an IN-list otherwise
+Bitmap DictionaryEncoder::queryPrefixPacked(const std::string& prefix) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    if (!v.packed) {
+        return queryPrefixSIMD(prefix);
+    }
+    if (v.codesOrdered) {
+        auto [lo, hi] = prefixCodeRange(v, prefix);
+        return v.packed->scanRange(lo, hi);
+    }
+    std::vector<int> codes = prefixCodes(v, prefix);
+    if (codes.empty()) {
+        return Bitmap(v.packed->size());
+    }
+    return v.packed->scanIn(std::move(codes));
+}
 
-        // If prefix matches, check additional bytes for long prefixes
-        if ((mask & prefixMask) == prefixMask) {
-            bool match = true;
+// Rows per parallel scan task: 64 KB of codes stays cache-resident, and a multiple
+// of 64 rows gives each morsel its own bitmap words
+static constexpr size_t kMorselRows = 16384;
 
-            // Fallback for prefixes longer than 32 bytes
-            for (size_t i = 32; i < prefix.size(); ++i) {
-                if (key[i] != prefix[i]) {
-                    match = false;
-                    break;
-                }
+// First row of morsel [begin, end) holding code, or SIZE_MAX
+static size_t findInMorsel(const SegmentedColumn& column, size_t begin, size_t end, int code, const ScanKernels& kernels) {
+    size_t found = SIZE_MAX;
+    forEachZoneRun(column, begin, end, zonesHolding(code), [&](ZoneAction, size_t first, size_t last) {
+        column.forEachStoredSegment(first, last, [&](const auto* codes, size_t count, size_t firstRow) {
+            long row = found == SIZE_MAX ? kernels.forCodes(codes).findEqual(codes, count, code) : -1;
+            if (row >= 0) {
+                found = firstRow + row;
+            }
+        }, [&](int runCode, size_t runBegin, size_t) {
+            if (found == SIZE_MAX && runCode == code) {
+                found = runBegin;
             }
+        });
+        return found == SIZE_MAX;
+    });
+    return found;
+}
 
-            if (match) {
-                matchingCodes.insert(value);
+// Lower firstMatch to row, if row is earlier
+static void lowerFirstMatch(std::atomic<size_t>& firstMatch, size_t row) {
+    size_t current = firstMatch.load(std::memory_order_relaxed);
+    while (row < current && !firstMatch.compare_exchange_weak(current, row, std::memory_order_relaxed)) {
+    }
+}
+
+// Set the rows of morsel [begin, end) with lo <= code < hi; returns the rows left unread
+static size_t scanRangeInMorsel(const SegmentedColumn& column, size_t begin, size_t end, int lo, int hi, const ScanKernels& kernels, Bitmap& results) {
+    size_t unread = 0;
+    unread += forEachZoneRun(column, begin, end, zonesInRange(lo, hi), [&](ZoneAction action, size_t first, size_t last) {
+        if (action == ZoneAction::Take) {
+            results.setRange(first, last); // Zones are whole bitmap words, so morsels never share one
+            unread += last - first;
+            return true;
+        }
+        column.forEachStoredSegment(first, last, [&](const auto* segment, size_t count, size_t firstRow) {
+            kernels.forCodes(segment).scanRange(segment, count, lo, hi, results.data() + firstRow / 64);
+        }, [&](int code, size_t runBegin, size_t runEnd) {
+            if (code >= lo && code < hi) {
+                results.setRange(runBegin, runEnd);
             }
+        });
+        return true;
+    });
+    return unread;
+}
+
+// Set the rows of morsel [begin, end) holding any of codes: a compare per code, or a probe of
+// set when it is not empty
+static void scanCodesInMorsel(const SegmentedColumn& column, size_t begin, size_t end, const std::vector<int>& codes,
+                              const std::vector<uint32_t>& set, int keyCount, const ScanKernels& kernels, Bitmap& results) {
+    column.forEachSegment(begin, end, [&](const int* segment, size_t count, size_t firstRow) {
+        uint64_t* words = results.data() + firstRow / 64;
+        if (set.empty()) {
+            kernels.scanAnyOf(segment, count, codes.data(), codes.size(), words);
+        } else {
+            kernels.scanMember(segment, count, set.data(), keyCount, words);
+        }
+    }, [&](int code, size_t runBegin, size_t runEnd) {
+        if (codeIn(code, codes, set, keyCount)) {
+            results.setRange(runBegin, runEnd);
         }
+    });
+}
+
+// Scans already running keep the old pool until their epoch guards end; a shared pool is
+// only let go, and stays alive through sharedPool
+void DictionaryEncoder::setScanThreads(int numThreads) {
+    ThreadPool* old = scanPool.exchange(new ThreadPool(std::max(1, numThreads)), std::memory_order_seq_cst);
+    if (old != sharedPool.get()) {
+        EpochManager::instance().retire(old);
     }
+}
 
-    // return matchingCodes;
+// Parallel first-match search: morsels are claimed in row order and skipped once an earlier match is known
+int DictionaryEncoder::parallelQueryValue(const std::string& value) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryValue);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    int code = findCode(v, value);
+    if (code < 0) {
+        return -1;
+    }
 
-    // Early truncation if no matching codes found
-    if (matchingCodes.empty()) {
+    size_t n = v.rows;
+    size_t numMorsels = (n + kMorselRows - 1) / kMorselRows;
+    std::atomic<size_t> firstMatch = n;
+    const ScanKernels& kernels = scanKernels();
+
+    scanPool.load(std::memory_order_seq_cst)->parallelFor(numMorsels, [&](size_t morsel) {
+        size_t begin = morsel * kMorselRows;
+        if (begin >= firstMatch.load(std::memory_order_relaxed)) {
+            return; // Early termination: an earlier morsel already matched
+        }
+        lowerFirstMatch(firstMatch, findInMorsel(*v.column, begin, std::min(begin + kMorselRows, n), code, kernels));
+    });
+
+    size_t row = firstMatch.load();
+    size_t scannedRows = std::min(n, row + 1); // Morsels past the match may have run too; they are not counted
+    statistics.scanned(scannedRows, scannedRows * v.column->codeBytes());
+    statistics.matched(row < n ? 1 : 0);
+    return row < n ? static_cast<int>(row) : -1;
+}
+
+// Parallel prefix scan
+Bitmap DictionaryEncoder::parallelQueryPrefix(const std::string& prefix) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryPrefix);
+    EpochGuard guard;
+    return scanPrefixParallel(snapshot(), prefix);
+}
+
+// Morsel-parallel prefix scan over version v; each morsel fills its own slice of the bitmap
+Bitmap DictionaryEncoder::scanPrefixParallel(const Version& v, const std::string& prefix) const {
+    size_t n = v.rows;
+    Bitmap results(n);
+
+    // Resolve the prefix to a code interval or a code list once, up front
+    int lo = 0, hi = 0;
+    std::vector<int> codes;
+    if (v.codesOrdered) {
+        std::tie(lo, hi) = prefixCodeRange(v, prefix);
+    } else {
+        codes = prefixCodes(v, prefix);
+    }
+    if (lo >= hi && codes.empty()) {
         return results;
     }
+    return scanMorsels(v, lo, hi, codes, codes.size() > kAnyOfCodes);
+}
+
+// Morsel-parallel scan for the rows holding any of codes, or with lo <= code < hi when codes
+// is empty; each morsel fills its own slice of the bitmap
+Bitmap DictionaryEncoder::scanMorsels(const Version& v, int lo, int hi, const std::vector<int>& codes, bool useSet) const {
+    size_t n = v.rows;
+    Bitmap results(n);
+    std::vector<uint32_t> set = useSet ? codeSet(codes, v.keyCount) : std::vector<uint32_t>();
+    size_t numMorsels = (n + kMorselRows - 1) / kMorselRows;
+    const ScanKernels& kernels = scanKernels();
+    std::atomic<size_t> skipped = 0;
+    scanPool.load(std::memory_order_seq_cst)->parallelFor(numMorsels, [&](size_t morsel) {
+        size_t begin = morsel * kMorselRows;
+        size_t end = std::min(begin + kMorselRows, n);
+        if (codes.empty()) {
+            skipped.fetch_add(scanRangeInMorsel(*v.column, begin, end, lo, hi, kernels, results), std::memory_order_relaxed);
+        } else {
+            scanCodesInMorsel(*v.column, begin, end, codes, set, v.keyCount, kernels, results);
+        }
+    });
+    return recordScan(v, std::move(results), skipped.load());
+}
+
+// Parallel prefix scan returning row indices: per-morsel lists are concatenated in morsel order
+std::vector<int> DictionaryEncoder::parallelQueryPrefixIndices(const std::string& prefix) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::QueryPrefix);
+    EpochGuard guard;
+    Bitmap matches = scanPrefixParallel(snapshot(), prefix);
+    ThreadPool& pool = *scanPool.load(std::memory_order_seq_cst);
+    size_t numWords = matches.wordCount();
+    size_t morselWords = kMorselRows / 64;
+    size_t numMorsels = (numWords + morselWords - 1) / morselWords;
+
+    // Count per morsel, prefix-sum into output offsets, then fill each morsel's slice
+    std::vector<size_t> offsets(numMorsels + 1, 0);
+    pool.parallelFor(numMorsels, [&](size_t morsel) {
+        size_t end = std::min(numWords, (morsel + 1) * morselWords);
+        size_t count = 0;
+        for (size_t w = morsel * morselWords; w < end; ++w) {
+            count += __builtin_popcountll(matches.data()[w]);
+        }
+        offsets[morsel + 1] = count;
+    });
+    for (size_t m = 0; m < numMorsels; ++m) {
+        offsets[m + 1] += offsets[m];
+    }
 
-    // Step 2: SIMD-optimized scan of the encodedColumn
-    size_t n = encodedColumn.size();
-    size_t numCodes = matchingCodes.size();
-    alignas(32) __m256i targetVecs[numCodes]; // Ensure proper alignment
+    std::vector<int> results(offsets[numMorsels]);
+    pool.parallelFor(numMorsels, [&](size_t morsel) {
+        size_t end = std::min(numWords, (morsel + 1) * morselWords);
+        int* out = results.data() + offsets[morsel];
+        for (size_t w = morsel * morselWords; w < end; ++w) {
+            uint64_t bits = matches.data()[w];
+            while (bits != 0) {
+                *out++ = static_cast<int>(w * 64 + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    });
+    return results;
+}
 
-    size_t idx = 0;
-    for (int code : matchingCodes) {
-        targetVecs[idx++] = _mm256_set1_epi32(code); // Broadcast code into SIMD register
+// Keys sampled to estimate how many codes a walked predicate matches
+static constexpr size_t kPlanSamples = 64;
+
+static bool keyMatches(const Predicate& predicate, std::string_view key) {
+    switch (predicate.op) {
+        case PredicateOp::Equal:
+            return key == predicate.value;
+        case PredicateOp::Prefix:
+            return key.starts_with(predicate.value);
+        case PredicateOp::Range:
+            return key >= predicate.value && key < predicate.upper;
     }
+    return false;
+}
 
-    for (size_t i = 0; i + 7 < n; i += 8) {
-        __m256i columnVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&encodedColumn[i]));
+static const char* opName(PredicateOp op) {
+    static const char* const names[] = {"equal", "prefix", "range"};
+    return names[static_cast<size_t>(op)];
+}
 
-        // Compare column values with all targetVecs
-        __m256i cmpResult = _mm256_setzero_si256();
-        for (size_t j = 0; j < matchingCodes.size(); ++j) {
-            cmpResult = _mm256_or_si256(cmpResult, _mm256_cmpeq_epi32(columnVec, targetVecs[j]));
+// Scattered codes that happen to be consecutive become an interval
+static void settleCodes(std::vector<int>& codes, int& lo, int& hi) {
+    if (codes.empty()) {
+        return;
+    }
+    auto [first, last] = std::minmax_element(codes.begin(), codes.end());
+    if (static_cast<size_t>(*last - *first) + 1 == codes.size()) {
+        lo = *first;
+        hi = *last + 1;
+        codes.clear();
+    }
+}
+
+PlanInput DictionaryEncoder::planInput(const Version& v, const Predicate& predicate, MatchingCodes& matching) const {
+    PlanInput input;
+    input.op = predicate.op;
+    input.rows = v.rows;
+    input.keys = static_cast<size_t>(v.keyCount);
+    input.codeBytes = v.column->codeBytes();
+    input.threads = scanPool.load(std::memory_order_seq_cst)->size();
+
+    // Cheap resolutions are done now and kept for the scan
+    if (predicate.op == PredicateOp::Equal) {
+        input.source = CodeSource::Lookup;
+        statistics.add(EncoderStats::Counter::DictionaryLookups);
+        int code = findCode(v, predicate.value);
+        if (code >= 0) {
+            matching.lo = code;
+            matching.hi = code + 1;
+        }
+        matching.resolved = true;
+    } else if (v.codesOrdered) {
+        input.source = CodeSource::Search;
+        std::tie(matching.lo, matching.hi) = predicate.op == PredicateOp::Prefix ? prefixCodeRange(v, predicate.value)
+                                                                                  : codeRange(v, predicate.value, predicate.upper);
+        matching.resolved = true;
+    } else if (v.prefixIndex) {
+        input.source = CodeSource::Index;
+        resolveCodes(v, predicate, matching);
+    } else {
+        // Walks cost a pass over the dictionary, so the matching codes are only estimated
+        input.source = CodeSource::Walk;
+        size_t samples = std::min(input.keys, kPlanSamples);
+        size_t hits = 0;
+        std::string scratch;
+        for (size_t i = 0; i < samples; ++i) {
+            std::optional<std::string_view> key = v.dictionary->ownerKey(static_cast<int>(i * input.keys / samples), scratch);
+            hits += key && keyMatches(predicate, *key);
+        }
+        input.matchingCodes = samples ? static_cast<double>(hits) * input.keys / samples : 0;
+        input.exact = samples == input.keys;
+        input.contiguous = false;
+        return input;
+    }
+    input.matchingCodes = static_cast<double>(matching.count());
+    input.exact = true;
+    input.contiguous = matching.codes.empty();
+    return input;
+}
+
+void DictionaryEncoder::resolveCodes(const Version& v, const Predicate& predicate, MatchingCodes& matching) const {
+    if (predicate.op == PredicateOp::Prefix) {
+        matching.codes = prefixCodes(v, predicate.value);
+    } else {
+        matching.codes = rangeCodes(v, predicate.value, predicate.upper);
+    }
+    settleCodes(matching.codes, matching.lo, matching.hi);
+    matching.resolved = true;
+}
+
+// Row scan: nothing is resolved up front. A code's key is compared the first time a row
+// holds it, and every later row with that code costs one byte lookup.
+Bitmap DictionaryEncoder::scanRowsByKey(const Version& v, const Predicate& predicate) const {
+    enum : uint8_t { kUnknown, kMatch, kMiss };
+    std::vector<uint8_t> verdicts(v.keyCount, kUnknown);
+    std::string scratch;
+    auto matches = [&](int code) {
+        if (static_cast<unsigned>(code) >= static_cast<unsigned>(v.keyCount)) {
+            return false;
         }
+        uint8_t& verdict = verdicts[code];
+        if (verdict == kUnknown) {
+            std::optional<std::string_view> key = v.dictionary->ownerKey(code, scratch); // Deleted keys match nothing
+            verdict = key && keyMatches(predicate, *key) ? kMatch : kMiss;
+        }
+        return verdict == kMatch;
+    };
+    Bitmap results(v.rows);
+    uint64_t* words = results.data();
+    v.column->forEachSegment(0, v.rows, [&](const int* codes, size_t count, size_t firstRow) {
+        for (size_t i = 0; i < count; ++i) {
+            size_t row = firstRow + i;
+            words[row / 64] |= uint64_t(matches(codes[i])) << (row % 64);
+        }
+    }, [&](int code, size_t first, size_t last) {
+        if (matches(code)) {
+            results.setRange(first, last);
+        }
+    });
+    return recordScan(v, std::move(results));
+}
 
-        // Extract matching indices
-        int mask = _mm256_movemask_epi8(cmpResult);
-        if (mask != 0) {
-            for (int j = 0; j < 8; ++j) {
-                if (mask & (1 << (j * 4))) {
-                    results.push_back(static_cast<int>(i + j));
+// Raw scan: the caller's strings compared one by one; neither the codes nor the dictionary are read
+Bitmap DictionaryEncoder::scanStrings(const Version& v, std::span<const std::string> strings, const Predicate& predicate) const {
+    Bitmap results(strings.size());
+    uint64_t* words = results.data();
+    // One loop per operator, so the row loop carries no switch
+    auto fill = [&](auto&& matches) {
+        for (size_t row = 0; row < strings.size(); ++row) {
+            words[row / 64] |= uint64_t(matches(std::string_view(strings[row]))) << (row % 64);
+        }
+    };
+    const std::string_view value = predicate.value;
+    const std::string_view upper = predicate.upper;
+    switch (predicate.op) {
+        case PredicateOp::Equal:
+            fill([&](std::string_view key) { return key == value; });
+            break;
+        case PredicateOp::Prefix:
+            fill([&](std::string_view key) { return key.starts_with(value); });
+            break;
+        case PredicateOp::Range:
+            fill([&](std::string_view key) { return key >= value && key < upper; });
+            break;
+    }
+    return recordScan(v, std::move(results));
+}
+
+Bitmap DictionaryEncoder::runPlan(const Version& v, const Predicate& predicate, QueryPlan& plan, MatchingCodes& matching, const PlanInput* replan) const {
+    if (plan.strategy == ScanStrategy::RowScan || plan.strategy == ScanStrategy::RawScan) {
+        return scanRowsByKey(v, predicate);
+    }
+    if (!matching.resolved) {
+        resolveCodes(v, predicate, matching);
+        plan.matchingCodes = static_cast<double>(matching.count());
+        plan.exact = true;
+        if (replan != nullptr) {
+            // The walk is paid for: pick the cheapest scan of the codes it found
+            PlanInput input = *replan;
+            input.matchingCodes = plan.matchingCodes;
+            input.exact = true;
+            input.contiguous = matching.codes.empty();
+            input.codesInHand = true;
+            QueryPlan revised = QueryPlanner::choose(input);
+            plan.strategy = revised.strategy;
+            plan.parallel = revised.parallel;
+        }
+    }
+    if (matching.count() == 0) {
+        plan.strategy = ScanStrategy::Empty;
+        plan.parallel = false;
+        return Bitmap(v.rows);
+    }
+
+    ScanStrategy strategy = plan.strategy;
+    if ((strategy == ScanStrategy::CodeRange && !matching.codes.empty()) || strategy == ScanStrategy::Empty) {
+        strategy = ScanStrategy::CodeSet;
+    }
+    if (strategy == ScanStrategy::CodeRange) {
+        return plan.parallel ? scanMorsels(v, matching.lo, matching.hi, {}, false) : scanCodeRangeSIMD(v, matching.lo, matching.hi);
+    }
+    std::vector<int> interval;
+    if (matching.codes.empty()) {
+        interval.resize(matching.count());
+        std::iota(interval.begin(), interval.end(), matching.lo);
+    }
+    const std::vector<int>& codes = matching.codes.empty() ? interval : matching.codes;
+    bool useSet = strategy == ScanStrategy::CodeSet;
+    return plan.parallel ? scanMorsels(v, 0, 0, codes, useSet) : scanCodeList(v, codes, useSet);
+}
+
+// Strings are only scanned raw when they are the vector v was encoded from: a buffer of the
+// same length may hold anything, and the column's own rows may since have been rewritten
+bool DictionaryEncoder::rawStringsOf(const Version& v, std::span<const std::string> strings) {
+    return v.encodedFrom != nullptr && strings.data() == v.encodedFrom && strings.size() == v.rows;
+}
+
+QueryPlan DictionaryEncoder::planQuery(const Predicate& predicate, std::span<const std::string> strings) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    MatchingCodes matching;
+    PlanInput input = planInput(v, predicate, matching);
+    input.rawStrings = rawStringsOf(v, strings);
+    return QueryPlanner::choose(input);
+}
+
+Bitmap DictionaryEncoder::query(const Predicate& predicate, std::span<const std::string> strings) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::Query);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    MatchingCodes matching;
+    PlanInput input = planInput(v, predicate, matching);
+    input.rawStrings = rawStringsOf(v, strings);
+    QueryPlan plan = QueryPlanner::choose(input);
+    Bitmap results = plan.strategy == ScanStrategy::RawScan ? scanStrings(v, strings, predicate)
+                                                            : runPlan(v, predicate, plan, matching, &input);
+    if (queryLogging.load(std::memory_order_relaxed)) {
+        std::clog << "query " << opName(predicate.op) << " \"" << predicate.value << "\": " << plan.describe() << "\n";
+    }
+    return results;
+}
+
+Bitmap DictionaryEncoder::query(const Predicate& predicate, ScanStrategy strategy, bool parallel) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::Query);
+    EpochGuard guard;
+    const Version& v = snapshot();
+    MatchingCodes matching;
+    QueryPlan plan = QueryPlanner::choose(planInput(v, predicate, matching));
+    plan.strategy = strategy;
+    plan.parallel = parallel && strategy != ScanStrategy::RowScan;
+    return runPlan(v, predicate, plan, matching, nullptr);
+}
+
+void DictionaryEncoder::setQueryLogging(bool enabled) {
+    queryLogging.store(enabled, std::memory_order_relaxed);
+}
+
+// A query waiting for a shared scan: a first-match lookup of key, or a prefix scan
+struct DictionaryEncoder::SharedQuery {
+    bool prefix = false;
+    std::string key;           // Value or prefix
+    std::promise<int> row;     // Value lookups
+    std::promise<Bitmap> rows; // Prefix scans
+};
+
+std::future<int> DictionaryEncoder::submitQueryValue(const std::string& value) const {
+    auto query = std::make_unique<SharedQuery>();
+    query->key = value;
+    std::future<int> result = query->row.get_future();
+    submitShared(std::move(query));
+    return result;
+}
+
+std::future<Bitmap> DictionaryEncoder::submitQueryPrefix(const std::string& prefix) const {
+    auto query = std::make_unique<SharedQuery>();
+    query->prefix = true;
+    query->key = prefix;
+    std::future<Bitmap> result = query->rows.get_future();
+    submitShared(std::move(query));
+    return result;
+}
+
+void DictionaryEncoder::submitShared(std::unique_ptr<SharedQuery> query) const {
+    {
+        std::lock_guard lock(sharedMutex);
+        sharedPending.push_back(std::move(query));
+        if (!sharedScanner.joinable()) {
+            sharedScanner = std::thread(&DictionaryEncoder::sharedScanLoop, this);
+        }
+    }
+    sharedReady.notify_one();
+}
+
+// A pass never waits for a batch to fill: it takes whatever arrived during the previous
+// pass, so a lone query is answered at once and batches grow with the load
+void DictionaryEncoder::sharedScanLoop() const {
+    std::unique_lock lock(sharedMutex);
+    while (true) {
+        sharedReady.wait(lock, [&] { return sharedStopping || !sharedPending.empty(); });
+        if (sharedPending.empty()) {
+            return; // Stopping, with every query answered
+        }
+        std::vector<std::unique_ptr<SharedQuery>> batch;
+        batch.swap(sharedPending);
+        lock.unlock();
+        sharedScan(batch);
+        lock.lock();
+    }
+}
+
+// Every query is resolved to codes first: a code interval for value lookups and for prefixes
+// of ordered codes, else a code list, with all unindexed prefixes matched in one pass over the
+// dictionary. Each morsel then runs every query's kernel back to back while its codes are in cache.
+void DictionaryEncoder::sharedScan(std::vector<std::unique_ptr<SharedQuery>>& batch) const {
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::SharedScan);
+    statistics.add(EncoderStats::Counter::SharedQueries, batch.size());
+    EpochGuard guard;
+    const Version& v = snapshot();
+    size_t n = v.rows;
+
+    struct Predicate {
+        const SharedQuery* query = nullptr;
+        int lo = 0, hi = 0;            // Code interval, when codes is empty
+        std::vector<int> codes;
+        std::vector<uint32_t> set;     // Bitset of codes, for long code lists
+        std::atomic<size_t> firstMatch; // Value lookups
+        Bitmap rows;                    // Prefix scans
+    };
+    std::vector<Predicate> predicates(batch.size());
+    std::vector<Predicate*> unindexed;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Predicate& p = predicates[i];
+        p.query = batch[i].get();
+        p.firstMatch = n;
+        const std::string& key = p.query->key;
+        if (!p.query->prefix) {
+            statistics.add(EncoderStats::Counter::DictionaryLookups);
+            int code = findCode(v, key);
+            if (code >= 0) {
+                p.lo = code;
+                p.hi = code + 1;
+            }
+            continue;
+        }
+        p.rows = Bitmap(n);
+        if (v.codesOrdered) {
+            std::tie(p.lo, p.hi) = prefixCodeRange(v, key);
+        } else if (v.prefixIndex) {
+            p.codes = prefixCodes(v, key);
+        } else {
+            unindexed.push_back(&p);
+        }
+    }
+    if (!unindexed.empty()) {
+        v.dictionary->forEach([&](std::string_view key, int value) {
+            if (value >= v.keyCount) {
+                return;
+            }
+            for (Predicate* p : unindexed) {
+                if (key.substr(0, p->query->key.size()) == p->query->key) {
+                    p->codes.push_back(value);
                 }
             }
+        });
+    }
+    for (Predicate& p : predicates) {
+        if (p.codes.size() > kAnyOfCodes) {
+            p.set = codeSet(p.codes, v.keyCount);
         }
     }
 
-    // Scalar fallback for remaining elements
-    for (size_t i = n - n % 8; i < n; ++i) {
-        if (matchingCodes.count(encodedColumn[i])) {
-            results.push_back(static_cast<int>(i));
+    size_t numMorsels = (n + kMorselRows - 1) / kMorselRows;
+    const ScanKernels& kernels = scanKernels();
+    scanPool.load(std::memory_order_seq_cst)->parallelFor(numMorsels, [&](size_t morsel) {
+        size_t begin = morsel * kMorselRows;
+        size_t end = std::min(begin + kMorselRows, n);
+        for (Predicate& p : predicates) {
+            if (!p.query->prefix) {
+                if (p.lo < p.hi && begin < p.firstMatch.load(std::memory_order_relaxed)) {
+                    lowerFirstMatch(p.firstMatch, findInMorsel(*v.column, begin, end, p.lo, kernels));
+                }
+            } else if (!p.codes.empty()) {
+                scanCodesInMorsel(*v.column, begin, end, p.codes, p.set, v.keyCount, kernels, p.rows);
+            } else if (p.lo < p.hi) {
+                scanRangeInMorsel(*v.column, begin, end, p.lo, p.hi, kernels, p.rows);
+            }
+        }
+    });
+
+    // The column is read once however many queries the pass answers
+    statistics.scanned(n, n * v.column->codeBytes());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Predicate& p = predicates[i];
+        if (!p.query->prefix) {
+            size_t row = p.firstMatch.load();
+            statistics.matched(row < n ? 1 : 0);
+            batch[i]->row.set_value(row < n ? static_cast<int>(row) : -1);
+        } else {
+            statistics.matched(p.rows);
+            batch[i]->rows.set_value(std::move(p.rows));
         }
     }
+}
 
-    return results;
+// Dense per-code histogram. Rows are split into one contiguous part per pool thread, each
+// counting into its own array, and the arrays are then summed in parallel over code blocks.
+// A part only gets its own array when it has at least as many rows as there are codes, so
+// the arrays never outgrow the column; a single part counts straight into the result.
+std::vector<size_t> DictionaryEncoder::codeHistogram(const Version& v) const {
+    ThreadPool& pool = *scanPool.load(std::memory_order_seq_cst);
+    size_t numMorsels = (v.rows + kMorselRows - 1) / kMorselRows;
+    unsigned keyCount = static_cast<unsigned>(v.keyCount);
+    size_t numParts = std::min({pool.size(), numMorsels, std::max<size_t>(1, v.rows / std::max(1u, keyCount))});
+
+    std::vector<size_t> histogram(keyCount, 0);
+    auto countPart = [&](auto* counts, size_t begin, size_t end) {
+        v.column->forEachStoredSegment(begin, end, [&](const auto* codes, size_t count, size_t) {
+            for (size_t i = 0; i < count; ++i) {
+                unsigned code = static_cast<unsigned>(codes[i]);
+                if (code < keyCount) {
+                    ++counts[code];
+                }
+            }
+        }, [&](int code, size_t first, size_t last) {
+            if (static_cast<unsigned>(code) < keyCount) {
+                counts[code] += last - first;
+            }
+        });
+    };
+    if (numParts <= 1) {
+        countPart(histogram.data(), 0, v.rows);
+        return histogram;
+    }
+
+    std::vector<std::vector<uint32_t>> partials(numParts);
+    pool.parallelFor(numParts, [&](size_t part) {
+        std::vector<uint32_t>& counts = partials[part];
+        counts.assign(keyCount, 0);
+        countPart(counts.data(), std::min(v.rows, part * numMorsels / numParts * kMorselRows),
+                  std::min(v.rows, (part + 1) * numMorsels / numParts * kMorselRows));
+    });
+
+    size_t numBlocks = (keyCount + kMorselRows - 1) / kMorselRows;
+    pool.parallelFor(numBlocks, [&](size_t block) {
+        size_t end = std::min<size_t>(keyCount, (block + 1) * kMorselRows);
+        for (const std::vector<uint32_t>& counts : partials) {
+            for (size_t code = block * kMorselRows; code < end; ++code) {
+                histogram[code] += counts[code];
+            }
+        }
+    });
+    return histogram;
+}
+
+// Count without materializing a bitmap: each morsel adds its kernel count to the total
+size_t DictionaryEncoder::countCodeRange(const Version& v, int lo, int hi) const {
+    if (lo >= hi) {
+        return 0;
+    }
+    size_t numMorsels = (v.rows + kMorselRows - 1) / kMorselRows;
+    std::atomic<size_t> total = 0;
+    const ScanKernels& kernels = scanKernels();
+    scanPool.load(std::memory_order_seq_cst)->parallelFor(numMorsels, [&](size_t morsel) {
+        size_t begin = morsel * kMorselRows;
+        size_t count = 0;
+        forEachZoneRun(*v.column, begin, std::min(v.rows, begin + kMorselRows), zonesInRange(lo, hi), [&](ZoneAction action, size_t first, size_t end) {
+            if (action == ZoneAction::Take) {
+                count += end - first;
+                return true;
+            }
+            v.column->forEachStoredSegment(first, end, [&](const auto* codes, size_t n, size_t) {
+                count += kernels.forCodes(codes).countRange(codes, n, lo, hi);
+            }, [&](int code, size_t runBegin, size_t runEnd) {
+                count += code >= lo && code < hi ? runEnd - runBegin : 0;
+            });
+            return true;
+        });
+        total.fetch_add(count, std::memory_order_relaxed);
+    });
+    return total.load();
+}
+
+// Count rows whose code is in a set, with the bitset membership kernel over morsel-sized bitmaps
+size_t DictionaryEncoder::countCodes(const Version& v, const std::vector<int>& codes) const {
+    if (codes.empty()) {
+        return 0;
+    }
+    std::vector<uint32_t> set = codeSet(codes, v.keyCount);
+    size_t numMorsels = (v.rows + kMorselRows - 1) / kMorselRows;
+    std::atomic<size_t> total = 0;
+    const ScanKernels& kernels = scanKernels();
+    scanPool.load(std::memory_order_seq_cst)->parallelFor(numMorsels, [&](size_t morsel) {
+        size_t begin = morsel * kMorselRows;
+        uint64_t words[kMorselRows / 64] = {};
+        size_t count = 0;
+        v.column->forEachSegment(begin, std::min(v.rows, begin + kMorselRows), [&](const int* segment, size_t n, size_t firstRow) {
+            kernels.scanMember(segment, n, set.data(), v.keyCount, words + (firstRow - begin) / 64);
+        }, [&](int code, size_t first, size_t last) {
+            count += codeIn(code, codes, set, v.keyCount) ? last - first : 0;
+        });
+        for (uint64_t word : words) {
+            count += __builtin_popcountll(word);
+        }
+        total.fetch_add(count, std::memory_order_relaxed);
+    });
+    return total.load();
+}
+
+std::vector<size_t> DictionaryEncoder::histogram() const {
+    EpochGuard guard;
+    return codeHistogram(snapshot());
+}
+
+size_t DictionaryEncoder::countValue(const std::string& value) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    int code = findCode(v, value);
+    return code < 0 ? 0 : countCodeRange(v, code, code + 1);
+}
+
+size_t DictionaryEncoder::countPrefix(const std::string& prefix) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    if (v.codesOrdered) {
+        auto [lo, hi] = prefixCodeRange(v, prefix);
+        return countCodeRange(v, lo, hi);
+    }
+    return countCodes(v, prefixCodes(v, prefix));
+}
+
+size_t DictionaryEncoder::countRange(const std::string& lo, const std::string& hi) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    if (v.codesOrdered) {
+        auto [loCode, hiCode] = codeRange(v, lo, hi);
+        return countCodeRange(v, loCode, hiCode);
+    }
+    return countCodes(v, rangeCodes(v, lo, hi));
+}
+
+size_t DictionaryEncoder::distinctValues() const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    std::vector<size_t> counts = codeHistogram(v);
+    std::string scratch;
+    size_t distinct = 0;
+    for (size_t code = 0; code < counts.size(); ++code) {
+        distinct += counts[code] > 0 && v.dictionary->ownerKey(static_cast<int>(code), scratch); // Rows of deleted keys hold no value
+    }
+    return distinct;
+}
+
+// Select the k largest counts on codes, ties broken by code; only the winners are decoded
+std::vector<std::pair<std::string, size_t>> DictionaryEncoder::topK(size_t k) const {
+    EpochGuard guard;
+    const Version& v = snapshot();
+    std::vector<size_t> counts = codeHistogram(v);
+    std::vector<int> codes;
+    std::string scratch;
+    for (size_t code = 0; code < counts.size(); ++code) {
+        if (counts[code] > 0 && v.dictionary->ownerKey(static_cast<int>(code), scratch)) {
+            codes.push_back(static_cast<int>(code));
+        }
+    }
+    k = std::min(k, codes.size());
+    std::partial_sort(codes.begin(), codes.begin() + k, codes.end(), [&](int a, int b) {
+        return counts[a] != counts[b] ? counts[a] > counts[b] : a < b;
+    });
+
+    std::vector<std::pair<std::string, size_t>> top;
+    top.reserve(k);
+    for (size_t i = 0; i < k; ++i) {
+        top.emplace_back(v.dictionary->key(codes[i], scratch), counts[codes[i]]);
+    }
+    return top;
 }
 
-// Insert or update a key-value pair
-void DictionaryEncoder::Put(const std::string& key, int value) {
-    std::unique_lock lock(dictMutex); // Exclusive access for modification
-    dictionary[key] = value;         // Insert or update the key-value pair
+// Insert or update a key-value pair: the change is a revision of the shared dictionary
+// store that only the new version sees, so readers of the previous version are unaffected
+bool DictionaryEncoder::Put(const std::string& key, int value) {
+    if (value < 0) {
+        std::cerr << "Put: negative value " << value << " for key " << key << "\n";
+        return false;
+    }
+    auto writer = lockWriter();
+    const Version& v = *current.load(std::memory_order_relaxed);
+    // Codes size every per-code array (histograms, code sets, the reverse lookup), so a value
+    // may at most open the next free code
+    if (value > v.dictionary->codeBound() || value == INT_MAX) {
+        std::cerr << "Put: value " << value << " for key " << key << " is past the next free code " << v.dictionary->codeBound() << "\n";
+        return false;
+    }
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::Put);
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    auto* next = new Version(v);
+    if (v.dictionary->find(key) != value) {
+        next->codesOrdered = false;  // Arbitrary codes break the key order
+    }
+    next->dictionary = v.dictionary->put(key, value);  // Key maps to value and value decodes to key
+    next->encodedFrom = nullptr;
+    if (next->dictionary->needsCompaction()) {
+        next->dictionary = next->dictionary->compact(); // The old store goes with the retired versions
+    }
+    next->keyCount = next->dictionary->codeBound();
+    deferIndexing(*next, key);
+    publish(next);
+    return true;
+}
+
+// Like append(): the written key is checked one by one against the index's answers until
+// the keys the index has not seen are a sizable share, and then the index is rebuilt
+void DictionaryEncoder::deferIndexing(Version& next, const std::string& key) {
+    if (!next.prefixIndex) {
+        return;
+    }
+    size_t written = (next.unindexedWrites ? next.unindexedWrites->count : 0) + 1;
+    size_t unindexed = next.keyCount - next.prefixIndex->codeBound() + written;
+    if (unindexed > std::max<size_t>(1024, next.prefixIndex->size() / 8)) {
+        next.prefixIndex = buildPrefixIndex(*next.dictionary, next.keyCount);
+        next.unindexedWrites = nullptr;
+    } else {
+        next.unindexedWrites = std::make_shared<const UnindexedWrite>(UnindexedWrite{key, written, next.unindexedWrites});
+    }
 }
 
 // Retrieve the value associated with a given key
 std::optional<int> DictionaryEncoder::Get(const std::string& key) const {
-    std::shared_lock lock(dictMutex); // Shared access for read-only
-    auto it = dictionary.find(key);
-    if (it != dictionary.end()) {
-        return it->second; // Return the associated value
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::Get, EncoderStats::kPointSampleShift);
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    EpochGuard guard;
+    int code = findCode(snapshot(), key);
+    if (code >= 0) {
+        return code;        // Return the associated value
     }
     return std::nullopt;   // Key not found
 }
 
-// Remove a key-value pair from the store
+// Remove a key-value pair from the store (a revision, like Put)
 bool DictionaryEncoder::Delete(const std::string& key) {
-    std::unique_lock lock(dictMutex); // Exclusive access for modification
-    return dictionary.erase(key) > 0; // Erase the key and return true if it existed
+    auto writer = lockWriter();
+    EncoderStats::Timer timer(statistics, EncoderStats::Operation::Delete);
+    statistics.add(EncoderStats::Counter::DictionaryLookups);
+    const Version& v = *current.load(std::memory_order_relaxed);
+    std::shared_ptr<VersionedDictionary> dictionary = v.dictionary->erase(key);
+    if (!dictionary) {
+        return false;
+    }
+    auto* next = new Version(v);
+    next->dictionary = dictionary->needsCompaction() ? dictionary->compact() : std::move(dictionary);
+    next->codesOrdered = false;      // Code range would still cover the deleted key
+    next->encodedFrom = nullptr;     // Its rows decode to nothing now
+    deferIndexing(*next, key);
+    publish(next);
+    return true;
 }
 
-// Clear dictionary and encoded column
+// Publish an empty dictionary and encoded column
 void DictionaryEncoder::clear() {
-    dictionary.clear();
-    encodedColumn.clear();
-    nextId = 0;
+    auto writer = lockWriter();
+    auto* next = new Version{std::make_shared<VersionedDictionary>(), 0, std::make_shared<SegmentedColumn>(1)};
+    if (packedStorage) {
+        next->packed = packColumn(*next->column, 0);
+    }
+    if (prefixIndexed) {
+        next->prefixIndex = buildPrefixIndex(*next->dictionary, 0);
+    }
+    publish(next);
 }
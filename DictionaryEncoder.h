@@ -13,39 +13,204 @@
 #include <cstring>
 #include <unordered_set>
 #include <unordered_map>
-#include <immintrin.h> // SIMD intrinsics
 #include <algorithm> // For std::find
 #include <optional>
+#include <memory>
+#include <span>
+#include <future>
+#include <condition_variable>
+#include "SegmentedColumn.h"
+#include "PackedColumn.h"
+#include "Bitmap.h"
+#include "ThreadPool.h"
+#include "VersionedDictionary.h"
+#include "EpochManager.h"
+#include "MappedFile.h"
+#include "PrefixIndex.h"
+#include "EncoderStats.h"
+#include "QueryPlanner.h"
+
+class ConcurrentDictionary;
 
 class DictionaryEncoder {
 private:
-    std::unordered_map<std::string, int> dictionary; // Maps strings to IDs
-    std::vector<int> encodedColumn;                 // Encoded data column
-    mutable std::shared_mutex dictMutex;            // Mutex for thread-safe dictionary updates
-    std::atomic<int> nextId = 0;                    // Atomic counter for dictionary IDs
+    struct SharedQuery; // A query waiting for the next shared scan
+    // Key written by Put() or Delete() since the prefix index was built, newest first; the
+    // index may hold a stale code for it, so lookups through the index check these keys too
+    struct UnindexedWrite {
+        std::string key;
+        size_t count = 0;                                  // Writes in this list
+        std::shared_ptr<const UnindexedWrite> older{};
+    };
+
+    // Everything a reader sees, published as one unit. A version is never modified after
+    // publication except past its own bounds: append() extends the shared dictionary and
+    // column beyond keyCount/rows, which this version's readers never look at.
+    struct Version {
+        std::shared_ptr<VersionedDictionary> dictionary{}; // Maps strings to IDs and back
+        int keyCount = 0;                                  // Codes visible in this version
+        std::shared_ptr<SegmentedColumn> column{};         // Encoded data column, as narrow as its codes allow
+        size_t rows = 0;                                   // Rows visible in this version
+        std::shared_ptr<const PackedColumn> packed{};      // Bit-packed copy of the visible rows, or null
+        bool codesOrdered = false;                         // True while code order matches key order
+        std::shared_ptr<const PrefixIndex> prefixIndex{};  // Trie over the keys with codes below its codeBound(), or null
+        std::shared_ptr<const UnindexedWrite> unindexedWrites{}; // Writes the prefix index has not seen, or null
+        const std::string* encodedFrom = nullptr;          // data() of the column given to encode(), until append(), Put() or Delete(); compared, never read
+    };
+
+    std::atomic<Version*> current;                  // Latest version; reclaimed through EpochManager
+    std::atomic<ThreadPool*> scanPool;              // Persistent workers for parallel scans
+    std::shared_ptr<ThreadPool> sharedPool;         // Pool passed to the constructor, shared with other encoders, or null
+    mutable std::mutex writerMutex;                 // Serializes writers; of the readers only dictionaryBytes() and distinctKeys() take it
+    bool packedStorage = false;                     // Maintain a packed copy in new versions
+    bool orderPreserving = false;                   // Assign codes in lexicographic key order during encode()
+    bool compressedDictionary = false;              // Front-code the keys of encode() instead of interning them
+    bool prefixIndexed = false;                     // Maintain a prefix index in new versions
+    mutable EncoderStats statistics;                // Counters and latencies; empty under DICTIONARY_NO_STATS
+    mutable std::mutex sharedMutex;                 // Guards the shared scan fields below
+    mutable std::condition_variable sharedReady;    // Signals pending queries or shutdown
+    mutable std::vector<std::unique_ptr<SharedQuery>> sharedPending; // Submitted, not yet taken by a pass
+    mutable std::thread sharedScanner;              // Runs the shared passes; started by the first submission
+    bool sharedStopping = false;
+    std::atomic<bool> queryLogging = false;         // Print the plan of every query() to std::clog
+
+    const Version& snapshot() const { return *current.load(std::memory_order_seq_cst); } // Caller holds an EpochGuard
+    void publish(Version* next);                                                          // Swap in next and retire the old version
+    std::unique_lock<std::mutex> lockWriter() const;                                      // Take writerMutex, timing the wait if contended
+    Bitmap recordScan(const Version& v, Bitmap matches, size_t skipped = 0) const;        // Count a scan of v, the rows its zones skipped and its matches
+    static int findCode(const Version& v, std::string_view key);                         // Code visible in v, or -1
+    static std::shared_ptr<const PackedColumn> packColumn(const SegmentedColumn& column, size_t rows);
+    static std::shared_ptr<const PrefixIndex> buildPrefixIndex(const VersionedDictionary& dictionary, int keyCount);
+    void publishEncoded(const ConcurrentDictionary& ids, int numIds, std::shared_ptr<SegmentedColumn> column, int numThreads,
+                        const std::string* encodedFrom = nullptr);
+
+    // Order-preserving helpers
+    static std::pair<int, int> codeRange(const Version& v, const std::string& lo, const std::string& hi); // Keys in [lo, hi) -> codes in [first, second)
+    static std::pair<int, int> prefixCodeRange(const Version& v, const std::string& prefix);             // Keys starting with prefix -> codes in [first, second)
+    Bitmap scanCodeRangeSIMD(const Version& v, int lo, int hi) const;                                    // Rows with lo <= code < hi
+    static std::vector<int> prefixCodes(const Version& v, const std::string& prefix);                    // Codes whose key starts with prefix
+    static std::vector<int> rangeCodes(const Version& v, const std::string& lo, const std::string& hi);  // Codes whose key is in [lo, hi)
+    template <typename Matches>
+    static std::vector<int> indexedCodes(const Version& v, std::span<const int> indexed, Matches&& matches); // Index result, made current
+    static void deferIndexing(Version& next, const std::string& key); // After a Put() or Delete() of key: note it, or reindex
+    Bitmap scanPrefixParallel(const Version& v, const std::string& prefix) const;                        // Morsel-parallel prefix scan
+    void submitShared(std::unique_ptr<SharedQuery> query) const;                                         // Queue query for the next pass
+    void sharedScanLoop() const;                                                                         // Body of sharedScanner
+    void sharedScan(std::vector<std::unique_ptr<SharedQuery>>& batch) const;                             // One column pass answering every query of batch
+
+    // Planned queries: the codes a predicate matches, as one interval or as a list
+    struct MatchingCodes {
+        bool resolved = false;
+        int lo = 0, hi = 0;     // Interval [lo, hi), when codes is empty
+        std::vector<int> codes; // Scattered codes
+        size_t count() const { return codes.empty() ? static_cast<size_t>(std::max(0, hi - lo)) : codes.size(); }
+    };
+    PlanInput planInput(const Version& v, const Predicate& predicate, MatchingCodes& matching) const; // Statistics, resolving the codes when cheap
+    void resolveCodes(const Version& v, const Predicate& predicate, MatchingCodes& matching) const;    // Walk the dictionary for the matching codes
+    // Run plan; given the input it was made from, a plan made on estimated codes is revised once they are resolved
+    Bitmap runPlan(const Version& v, const Predicate& predicate, QueryPlan& plan, MatchingCodes& matching, const PlanInput* replan) const;
+    Bitmap scanCodeList(const Version& v, const std::vector<int>& codes, bool useSet) const;          // Rows holding any of codes, skipping zones
+    Bitmap scanMorsels(const Version& v, int lo, int hi, const std::vector<int>& codes, bool useSet) const; // Parallel: rows holding codes, or in [lo, hi) when codes is empty
+    Bitmap scanRowsByKey(const Version& v, const Predicate& predicate) const;                         // Row scan deciding each code once
+    Bitmap scanStrings(const Version& v, std::span<const std::string> strings, const Predicate& predicate) const; // Raw scan of the caller's strings
+    static bool rawStringsOf(const Version& v, std::span<const std::string> strings);                 // strings is the vector v was encoded from
+
+    // Aggregation helpers: morsel-parallel passes over the codes of version v
+    std::vector<size_t> codeHistogram(const Version& v) const;                     // Rows per code
+    size_t countCodeRange(const Version& v, int lo, int hi) const;                 // Rows with lo <= code < hi
+    size_t countCodes(const Version& v, const std::vector<int>& codes) const;      // Rows holding any of codes
 
 public:
+    DictionaryEncoder();
+    explicit DictionaryEncoder(std::shared_ptr<ThreadPool> pool); // Scan on pool instead of a pool of its own
+    ~DictionaryEncoder();
+
     // Encoding
     void encode(const std::vector<std::string>& column, int numThreads);
+    void append(const std::vector<std::string>& batch); // Encode and add rows without re-encoding the column
+    // Encode a column file, one value per line: the whole line, or CSV field number field (from 0)
+    bool load(const std::string& path, int numThreads, int field = -1, bool skipHeader = false);
     void writeEncodedColumn(const std::string& filename);
     void writeDictionary(const std::string& filename);
+    void writeBinary(const std::string& filename);  // Dictionary and column as one binary image (ColumnFile.h)
+    bool open(const std::string& path);             // Map a writeBinary() file and serve queries from it in place
+    void setOrderPreserving(bool enabled); // Takes effect on the next encode()
+    void setPackedStorage(bool enabled);   // Packs the current column and keeps it packed on encode()
+    void setCompressedDictionary(bool enabled); // Takes effect on the next encode(); implies ordered codes
+    void setPrefixIndex(bool enabled);     // Indexes the current keys and keeps them indexed for prefix and range queries
+    size_t packedBytes() const;            // Memory held by the packed column
+    size_t columnBytes() const;            // Memory held by the encoded column
+    unsigned codeBytes() const;            // Bytes per stored code: 1, 2 or 4, the narrowest that fits the dictionary
+    size_t runEncodedSegments() const;     // Column segments stored as runs of one code
+    size_t dictionaryBytes() const;        // Memory held by the dictionary (arena, index, code table, compressed keys and revisions)
+    size_t distinctKeys() const;
+    void setScanThreads(int numThreads);   // Replace the scan pool with a pool of its own of this size
+    EncoderStats::Snapshot stats() const;  // Counters and latency histograms since construction or resetStats()
+    void resetStats();
 
     // Decoding
     std::vector<std::string> decode() const;
+    std::vector<std::string> decode(size_t begin, size_t end) const; // Rows [begin, end)
+    void decodeInto(size_t begin, std::span<std::string> out) const; // Rows [begin, begin + out.size())
+    std::vector<std::string> decodeRows(const Bitmap& selection) const; // Selected rows only, in row order
 
     // Query with and without SIMD
     int vanillaQueryValue(const std::vector<std::string>& column, const std::string& value);
     int queryValueNonSIMD(const std::string& value) const; // Single-item search (non-SIMD)
     int queryValueSIMD(const std::string& value) const;
-    std::vector<int> vanillaQueryPrefix(const std::vector<std::string>& column, const std::string& prefix);
-    std::vector<int> queryPrefixNonSIMD(const std::string& prefix) const; // Prefix scan (non-SIMD)
-    std::vector<int> queryPrefixSIMD(const std::string& prefix) const; // Prefix scan (SIMD)
+    std::vector<int> queryValueAll(const std::string& value) const; // Every matching row (SIMD)
+    Bitmap queryEqual(const std::string& value) const;              // Every matching row as a bitmap (SIMD)
+    // Batched point lookups (IN-lists): the dictionary is probed for all values together
+    // and a single column pass resolves every one of them
+    std::vector<int> queryValuesFirst(std::span<const std::string> values) const;            // First row per value, or -1
+    std::vector<std::vector<int>> queryValuesAll(std::span<const std::string> values) const; // Every row per value
+    std::vector<size_t> queryValuesCount(std::span<const std::string> values) const;         // Rows per value
+    Bitmap vanillaQueryPrefix(const std::vector<std::string>& column, const std::string& prefix);
+    Bitmap queryPrefixNonSIMD(const std::string& prefix) const; // Prefix scan (non-SIMD)
+    Bitmap queryPrefixSIMD(const std::string& prefix) const; // Prefix scan (SIMD)
+    Bitmap queryRange(const std::string& lo, const std::string& hi) const; // Range scan over [lo, hi)
+    std::optional<std::string> nextKey(const std::string& key) const;      // Smallest key >= key, if any
+    int queryValuePacked(const std::string& value) const;                  // Single-item search on packed codes
+    Bitmap queryPrefixPacked(const std::string& prefix) const;   // Prefix scan on packed codes
+
+    // Parallel morsel-driven scans on the scan pool
+    int parallelQueryValue(const std::string& value) const;                       // First match, stops early
+    Bitmap parallelQueryPrefix(const std::string& prefix) const;                  // Prefix scan
+    std::vector<int> parallelQueryPrefixIndices(const std::string& prefix) const; // Prefix scan, rows in order
+
+    // Cost-based evaluation of one equality, prefix or range predicate: the planner
+    // (QueryPlanner.h) picks the strategy from the statistics of the current version. A caller
+    // still holding, unchanged, the very vector the current column was encoded from can pass
+    // it, and the planner then weighs a raw scan of it too. Any other strings, and any strings
+    // after an append(), Put() or Delete(), or after load() or open(), are ignored.
+    Bitmap query(const Predicate& predicate, std::span<const std::string> strings = {}) const;
+    QueryPlan planQuery(const Predicate& predicate, std::span<const std::string> strings = {}) const; // The plan query() would start from
+    // A fixed strategy instead of the planned one, to compare them; code range on scattered
+    // codes and empty with matching codes run as a code set, and a raw scan, without the
+    // strings, as a row scan
+    Bitmap query(const Predicate& predicate, ScanStrategy strategy, bool parallel = false) const;
+    void setQueryLogging(bool enabled); // Print the plan of every query() to std::clog
+
+    // Shared scans for many concurrent users: queries submitted while a pass is running are
+    // batched into the next one, which evaluates all of them on each morsel of the column
+    // while it is in cache. Results come from the version current when their pass starts.
+    std::future<int> submitQueryValue(const std::string& value) const;      // Result of queryValueSIMD(value)
+    std::future<Bitmap> submitQueryPrefix(const std::string& prefix) const; // Result of queryPrefixSIMD(prefix)
+
+    // Aggregates computed on the codes; string keys are touched only to resolve predicates
+    // and to translate the final top-K codes
+    std::vector<size_t> histogram() const;                                  // Rows per code, indexed by code
+    size_t countValue(const std::string& value) const;                      // Rows equal to value
+    size_t countPrefix(const std::string& prefix) const;                    // Rows starting with prefix
+    size_t countRange(const std::string& lo, const std::string& hi) const;  // Rows in [lo, hi)
+    size_t distinctValues() const;                                          // Distinct codes present in the column
+    std::vector<std::pair<std::string, size_t>> topK(size_t k) const;       // Most frequent values, most frequent first
 
     // Helper
-    void Put(const std::string& key, int value);
+    bool Put(const std::string& key, int value); // False for a negative value or one past the next free code
     std::optional<int> Get(const std::string& key) const;
     bool Delete(const std::string& key);
-    void clear(); // Resets the dictionary and encoded column
+    void clear(); // Publishes an empty dictionary and encoded column
 };
 
 #endif
@@ -0,0 +1,158 @@
+#include "EncoderStats.h"
+#include <sstream>
+#include <bit>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const char* EncoderStats::name(Counter c) {
+    static const char* const names[kNumCounters] = {"dictionaryLookups", "dictionaryProbes", "rowsScanned", "bytesScanned", "rowsMatched",
+                                                    "rowsSkipped", "sharedQueries"};
+    return names[static_cast<size_t>(c)];
+}
+
+const char* EncoderStats::name(Operation op) {
+    static const char* const names[kNumOperations] = {"encodeHash", "encodeOrder", "encodeNarrow", "encodeBuild", "loadTokenize",
+                                                      "append", "queryValue", "queryPrefix", "queryEqual", "queryRange",
+                                                      "query", "sharedScan", "put", "get", "delete", "writerWait"};
+    return names[static_cast<size_t>(op)];
+}
+
+// Ticks counted over a short busy wait; the TSC runs at a constant rate on current x86 parts
+double EncoderStats::nanosPerTick() {
+    static const double ratio = [] {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t first = ticks();
+        while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2)) {
+        }
+        uint64_t elapsedTicks = ticks() - first;
+        double elapsedNanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return elapsedTicks ? elapsedNanos / elapsedTicks : 1.0;
+    }();
+    return ratio;
+}
+
+double EncoderStats::Latency::percentileNanos(double p) const {
+    if (timed == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * timed + 0.999999));
+    uint64_t seen = 0;
+    size_t b = 0;
+    while (b + 1 < kBuckets && (seen += buckets[b]) < rank) {
+        ++b;
+    }
+    return static_cast<double>((uint64_t(2) << b) - 1) * nanosPerTick;
+}
+
+double EncoderStats::Snapshot::selectivity() const {
+    uint64_t rows = counter(Counter::RowsScanned);
+    return rows ? static_cast<double>(counter(Counter::RowsMatched)) / rows : 0;
+}
+
+// Operations that never ran are left out; histograms stop at their last non-empty bucket
+std::string EncoderStats::Snapshot::toJson() const {
+    std::ostringstream out;
+    out << "{\"enabled\": " << (enabled ? "true" : "false") << ", \"counters\": {";
+    for (size_t c = 0; c < kNumCounters; ++c) {
+        out << (c ? ", \"" : "\"") << name(static_cast<Counter>(c)) << "\": " << counters[c];
+    }
+    out << "}, \"selectivity\": " << selectivity() << ", \"operations\": {";
+    bool first = true;
+    for (size_t op = 0; op < kNumOperations; ++op) {
+        const Latency& latency = operations[op];
+        if (latency.count == 0) {
+            continue;
+        }
+        out << (first ? "\"" : ", \"") << name(static_cast<Operation>(op)) << "\": {\"count\": " << latency.count
+            << ", \"timed\": " << latency.timed << ", \"totalNanos\": " << latency.totalNanos << ", \"meanNanos\": " << latency.meanNanos()
+            << ", \"p50Nanos\": " << latency.percentileNanos(0.5) << ", \"p99Nanos\": " << latency.percentileNanos(0.99)
+            << ", \"maxNanos\": " << latency.percentileNanos(1.0) << ", \"nanosPerTick\": " << latency.nanosPerTick
+            << ", \"log2TickHistogram\": [";
+        size_t last = kBuckets;
+        while (last > 0 && latency.buckets[last - 1] == 0) {
+            --last;
+        }
+        for (size_t b = 0; b < last; ++b) {
+            out << (b ? ", " : "") << latency.buckets[b];
+        }
+        out << "]}";
+        first = false;
+    }
+    out << "}}";
+    return out.str();
+}
+
+#ifndef DICTIONARY_NO_STATS
+EncoderStats::EncoderStats()
+    : slotMask(std::clamp<size_t>(std::bit_ceil(2 * std::max<size_t>(1, std::thread::hardware_concurrency())), kMinSlots, kMaxSlots) - 1),
+      slots(std::make_unique<Slot[]>(slotMask + 1)) {}
+
+// Never destroyed: threads may exit during static destruction
+static std::mutex threadIndexMutex;
+static std::vector<bool>& threadIndexTaken = *new std::vector<bool>();
+
+size_t EncoderStats::acquireThreadIndex() {
+    std::lock_guard<std::mutex> lock(threadIndexMutex);
+    size_t index = std::find(threadIndexTaken.begin(), threadIndexTaken.end(), false) - threadIndexTaken.begin();
+    if (index == threadIndexTaken.size()) {
+        threadIndexTaken.push_back(true);
+    } else {
+        threadIndexTaken[index] = true;
+    }
+    return index;
+}
+
+void EncoderStats::releaseThreadIndex(size_t index) {
+    std::lock_guard<std::mutex> lock(threadIndexMutex);
+    threadIndexTaken[index] = false;
+}
+
+// Slots are read while other threads may be adding to them: each value is exact, but a
+// snapshot taken during updates need not be one consistent cut across counters
+EncoderStats::Snapshot EncoderStats::snapshot() const {
+    Snapshot result;
+    result.enabled = true;
+    std::array<uint64_t, kNumOperations> timedTicks{};
+    for (size_t s = 0; s <= slotMask; ++s) {
+        const Slot& slot = slots[s];
+        for (size_t c = 0; c < kNumCounters; ++c) {
+            result.counters[c] += slot.counters[c].load(std::memory_order_relaxed);
+        }
+        for (size_t op = 0; op < kNumOperations; ++op) {
+            result.operations[op].count += slot.counts[op].load(std::memory_order_relaxed);
+            timedTicks[op] += slot.ticks[op].load(std::memory_order_relaxed);
+            for (size_t b = 0; b < kBuckets; ++b) {
+                result.operations[op].buckets[b] += slot.buckets[op][b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    for (size_t op = 0; op < kNumOperations; ++op) {
+        Latency& latency = result.operations[op];
+        latency.nanosPerTick = nanosPerTick();
+        for (uint64_t bucket : latency.buckets) {
+            latency.timed += bucket;
+        }
+        if (latency.timed > 0) {
+            latency.totalNanos = timedTicks[op] * latency.nanosPerTick * latency.count / latency.timed;
+        }
+    }
+    return result;
+}
+
+void EncoderStats::reset() {
+    for (size_t s = 0; s <= slotMask; ++s) {
+        Slot& slot = slots[s];
+        for (auto& counter : slot.counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (size_t op = 0; op < kNumOperations; ++op) {
+            slot.counts[op].store(0, std::memory_order_relaxed);
+            slot.ticks[op].store(0, std::memory_order_relaxed);
+            for (auto& bucket : slot.buckets[op]) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+#endif
@@ -0,0 +1,193 @@
+#ifndef ENCODER_STATS_H
+#define ENCODER_STATS_H
+
+#include <atomic>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "Bitmap.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Counters and latency histograms for one DictionaryEncoder, cheap enough to leave on.
+// Each thread updates its own cache-line-padded slot with relaxed atomics, so threads never
+// share a line on the hot path; snapshot() sums the slots on demand. There are two slots per
+// hardware thread, and a thread keeps its slot index from first use until it exits. Timers read the TSC
+// rather than the system clock and are converted to nanoseconds only in snapshots. Build with
+// -DDICTIONARY_NO_STATS to compile every update out: the calls become empty inline functions.
+class EncoderStats {
+public:
+    enum class Counter {
+        DictionaryLookups, // Keys looked up or inserted
+        DictionaryProbes,  // Hash slots inspected by encode() and load()
+        RowsScanned,       // Rows read by the column scans
+        BytesScanned,      // Code bytes read by the column scans
+        RowsMatched,       // Rows selected by the column scans
+        RowsSkipped,       // Rows passed over by the scans on their zone summaries alone
+        SharedQueries,     // Queries answered by shared scans
+        Count
+    };
+
+    enum class Operation {
+        EncodeHash,   // encode()/load(): parallel key hashing into the column
+        EncodeOrder,  // Sort keys and remap the column (order-preserving dictionaries)
+        EncodeNarrow, // Narrow the column's codes, summarize its zones and run-length encode clustered segments
+        EncodeBuild,  // Intern the keys and build the packed column and prefix index
+        LoadTokenize, // load(): cut the mapped file into chunks, count their lines and sample values
+        Append,
+        QueryValue,   // queryValue*, parallelQueryValue
+        QueryPrefix,  // queryPrefix*, parallelQueryPrefix*
+        QueryEqual,
+        QueryRange,
+        Query,        // query(): planning, code resolution and the chosen scan
+        SharedScan,   // One shared pass, whatever the number of queries it answers
+        Put,
+        Get,
+        Delete,
+        WriterWait,   // Time a writer waited for writerMutex; only contended acquisitions count
+        Count
+    };
+
+    static constexpr size_t kNumCounters = static_cast<size_t>(Counter::Count);
+    static constexpr size_t kNumOperations = static_cast<size_t>(Operation::Count);
+    static constexpr size_t kBuckets = 48;          // Bucket b holds latencies in [2^b, 2^(b+1)) ticks; the last one is open
+    static constexpr unsigned kPointSampleShift = 4; // Point lookups time one call in 16 per thread; reading the clock costs more than they do
+
+    // Totals over all threads at one point in time. Every call is counted; the histogram
+    // holds the timed ones, which are all of them unless the operation is sampled.
+    struct Latency {
+        uint64_t count = 0;
+        uint64_t timed = 0;
+        double totalNanos = 0; // Extrapolated from the timed calls when sampled
+        std::array<uint64_t, kBuckets> buckets{};
+        double nanosPerTick = 1;
+        double meanNanos() const { return count ? totalNanos / count : 0; }
+        double percentileNanos(double p) const; // Upper bound of the bucket holding the p-th timed latency
+    };
+    struct Snapshot {
+        bool enabled = false;
+        std::array<uint64_t, kNumCounters> counters{};
+        std::array<Latency, kNumOperations> operations{};
+        uint64_t counter(Counter c) const { return counters[static_cast<size_t>(c)]; }
+        const Latency& operation(Operation op) const { return operations[static_cast<size_t>(op)]; }
+        double selectivity() const; // Matched / scanned rows
+        std::string toJson() const;
+    };
+
+    static const char* name(Counter c);
+    static const char* name(Operation op);
+
+    // Timer clock: the TSC on x86, steady_clock nanoseconds elsewhere
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    static double nanosPerTick(); // Measured against steady_clock on first use
+
+#ifndef DICTIONARY_NO_STATS
+    static constexpr bool kEnabled = true;
+
+    EncoderStats();
+
+    void add(Counter c, uint64_t n = 1) {
+        slot().counters[static_cast<size_t>(c)].fetch_add(n, std::memory_order_relaxed);
+    }
+    void scanned(size_t rows, size_t bytes) {
+        add(Counter::RowsScanned, rows);
+        add(Counter::BytesScanned, bytes);
+    }
+    void matched(size_t rows) { add(Counter::RowsMatched, rows); }
+    void matched(const Bitmap& rows) { add(Counter::RowsMatched, rows.count()); }
+
+    Snapshot snapshot() const;
+    void reset();
+
+    // Counts one call of op and records its time from construction to stop() or destruction,
+    // whichever comes first. With a sample shift s, only one call in 2^s per thread is timed.
+    class Timer {
+    private:
+        EncoderStats* stats = nullptr; // Null when this call is not timed
+        Operation op;
+        uint64_t start = 0;
+
+    public:
+        Timer(EncoderStats& owner, Operation op, unsigned sampleShift = 0) : op(op) {
+            uint64_t calls = owner.slot().counts[static_cast<size_t>(op)].fetch_add(1, std::memory_order_relaxed);
+            if ((calls & ((uint64_t(1) << sampleShift) - 1)) == 0) {
+                stats = &owner;
+                start = ticks();
+            }
+        }
+        ~Timer() { stop(); }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+        void stop() {
+            if (stats != nullptr) {
+                stats->record(op, ticks() - start);
+                stats = nullptr;
+            }
+        }
+    };
+
+private:
+    static constexpr size_t kMinSlots = 16;
+    static constexpr size_t kMaxSlots = 256; // Threads beyond the slot count share slots, which stays correct but contends
+
+    struct alignas(64) Slot {
+        std::array<std::atomic<uint64_t>, kNumCounters> counters{};
+        std::array<std::atomic<uint64_t>, kNumOperations> counts{};
+        std::array<std::atomic<uint64_t>, kNumOperations> ticks{};
+        std::array<std::array<std::atomic<uint64_t>, kBuckets>, kNumOperations> buckets{};
+    };
+
+    size_t slotMask;                     // Slot count - 1, a power of two
+    std::unique_ptr<Slot[]> slots;
+
+    void record(Operation op, uint64_t elapsedTicks) {
+        Slot& s = slot();
+        size_t i = static_cast<size_t>(op);
+        size_t bucket = std::min<size_t>(63 - __builtin_clzll(elapsedTicks | 1), kBuckets - 1);
+        s.ticks[i].fetch_add(elapsedTicks, std::memory_order_relaxed);
+        s.buckets[i][bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Dense per-thread index: a thread takes the lowest free one on first use and hands it back
+    // when it exits, so no two live threads share one and exited threads leave no gaps
+    static size_t acquireThreadIndex();
+    static void releaseThreadIndex(size_t index);
+    struct ThreadIndex {
+        size_t value = acquireThreadIndex();
+        ~ThreadIndex() { releaseThreadIndex(value); }
+    };
+    static size_t threadIndex() {
+        thread_local ThreadIndex index;
+        return index.value;
+    }
+    Slot& slot() { return slots[threadIndex() & slotMask]; }
+#else
+    static constexpr bool kEnabled = false;
+
+    void add(Counter, uint64_t = 1) {}
+    void scanned(size_t, size_t) {}
+    void matched(size_t) {}
+    void matched(const Bitmap&) {}
+    Snapshot snapshot() const { return {}; }
+    void reset() {}
+
+    class Timer {
+    public:
+        Timer(EncoderStats&, Operation, unsigned = 0) {}
+        void stop() {}
+    };
+#endif
+};
+
+#endif
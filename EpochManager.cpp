@@ -0,0 +1,104 @@
+#include "EpochManager.h"
+#include <algorithm>
+#include <stdexcept>
+
+EpochManager& EpochManager::instance() {
+    static EpochManager manager;
+    return manager;
+}
+
+// No readers remain at shutdown
+EpochManager::~EpochManager() {
+    for (const Retired& entry : retired) {
+        entry.deleter(entry.object);
+    }
+}
+
+EpochManager::ThreadState& EpochManager::threadState() {
+    thread_local ThreadState state;
+    return state;
+}
+
+EpochManager::ThreadState::~ThreadState() {
+    if (slot != nullptr) {
+        instance().releaseSlot(slot);
+    }
+}
+
+// Claimed once per thread on its first guard and held until the thread exits
+EpochManager::Slot* EpochManager::claimSlot() {
+    for (Slot& slot : slots) {
+        bool expected = false;
+        if (!slot.claimed.load(std::memory_order_relaxed) &&
+            slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return &slot;
+        }
+    }
+    throw std::runtime_error("EpochManager: too many reader threads");
+}
+
+void EpochManager::releaseSlot(Slot* slot) {
+    slot->epoch.store(kIdle, std::memory_order_release);
+    slot->claimed.store(false, std::memory_order_release);
+}
+
+// Oldest epoch any reader still has pinned (kIdle if none)
+uint64_t EpochManager::oldestPinned() const {
+    uint64_t oldest = kIdle;
+    for (const Slot& slot : slots) {
+        oldest = std::min(oldest, slot.epoch.load(std::memory_order_seq_cst));
+    }
+    return oldest;
+}
+
+// The caller has already unpublished object. Readers that pin after the epoch
+// advances below can no longer reach it, so it is freed once all older pins end.
+void EpochManager::retire(void* object, void (*deleter)(void*)) {
+    {
+        std::lock_guard lock(retiredMutex);
+        retired.push_back({object, deleter, globalEpoch.fetch_add(1, std::memory_order_seq_cst)});
+    }
+    reclaim();
+}
+
+void EpochManager::reclaim() {
+    std::vector<Retired> freeable;
+    {
+        std::lock_guard lock(retiredMutex);
+        uint64_t oldest = oldestPinned();
+        auto keep = std::partition(retired.begin(), retired.end(), [&](const Retired& entry) {
+            return entry.epoch >= oldest;
+        });
+        freeable.assign(keep, retired.end());
+        retired.erase(keep, retired.end());
+    }
+    // Deleters run outside the lock: destroying an object may retire others
+    for (const Retired& entry : freeable) {
+        entry.deleter(entry.object);
+    }
+}
+
+size_t EpochManager::pending() {
+    std::lock_guard lock(retiredMutex);
+    return retired.size();
+}
+
+EpochGuard::EpochGuard() {
+    EpochManager::ThreadState& state = EpochManager::threadState();
+    if (state.depth++ > 0) {
+        return; // Nested guard: the outer one already pinned an epoch
+    }
+    EpochManager& manager = EpochManager::instance();
+    if (state.slot == nullptr) {
+        state.slot = manager.claimSlot();
+    }
+    // Publish the pin before any protected pointer is loaded
+    state.slot->epoch.store(manager.globalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+EpochGuard::~EpochGuard() {
+    EpochManager::ThreadState& state = EpochManager::threadState();
+    if (--state.depth == 0) {
+        state.slot->epoch.store(EpochManager::kIdle, std::memory_order_release);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef EPOCH_MANAGER_H
+#define EPOCH_MANAGER_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Epoch-based reclamation for objects that readers reach through an atomic pointer.
+// A reader pins the current global epoch in its own cache line for the duration of an
+// EpochGuard; a writer that unpublishes an object retires it, and the object is freed
+// once every pinned epoch is newer than the retirement. Readers never write shared state.
+class EpochManager {
+private:
+    static constexpr uint64_t kIdle = UINT64_MAX;
+    static constexpr size_t kMaxThreads = 256; // Threads that may hold a guard at once
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{kIdle}; // Epoch pinned by the owning thread, kIdle outside guards
+        std::atomic<bool> claimed{false};
+    };
+
+    struct Retired {
+        void* object;
+        void (*deleter)(void*);
+        uint64_t epoch; // Readers pinned at or before this epoch may still hold object
+    };
+
+    Slot slots[kMaxThreads];
+    alignas(64) std::atomic<uint64_t> globalEpoch{1};
+    std::mutex retiredMutex;            // Writers only
+    std::vector<Retired> retired;
+
+    // Per-thread slot and guard nesting depth
+    struct ThreadState {
+        Slot* slot = nullptr;
+        int depth = 0;
+        ~ThreadState();
+    };
+    static ThreadState& threadState();
+
+    uint64_t oldestPinned() const;
+    Slot* claimSlot();
+    void releaseSlot(Slot* slot);
+
+    friend class EpochGuard;
+
+public:
+    static EpochManager& instance();
+    ~EpochManager();
+
+    // Free object with deleter once no reader can still hold it
+    void retire(void* object, void (*deleter)(void*));
+    template <typename T>
+    void retire(T* object) {
+        retire(object, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    void reclaim();        // Free every retired object no pinned reader can reach
+    size_t pending();      // Retired objects not yet freed
+};
+
+// Pins the calling thread's epoch; objects loaded while a guard is alive stay valid until it ends.
+// Guards nest, so a read path may call other read paths.
+class EpochGuard {
+public:
+    EpochGuard();
+    ~EpochGuard();
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "FrontCodedDictionary.h"
+#include <algorithm>
+
+static void writeVarint(std::vector<char>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t FrontCodedDictionary::readVarint(const char*& p) {
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+static size_t commonPrefix(std::string_view a, std::string_view b) {
+    size_t limit = std::min(a.size(), b.size());
+    size_t i = 0;
+    while (i < limit && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+FrontCodedDictionary::FrontCodedDictionary(const std::vector<std::string_view>& sortedKeys) : numKeys(sortedKeys.size()) {
+    blocks.reserve((numKeys + kBlockKeys - 1) / kBlockKeys);
+    for (size_t i = 0; i < numKeys; ++i) {
+        std::string_view key = sortedKeys[i];
+        size_t shared = 0;
+        if (i % kBlockKeys == 0) {
+            blocks.push_back(bytes.size());
+        } else {
+            shared = commonPrefix(sortedKeys[i - 1], key);
+            writeVarint(bytes, shared);
+        }
+        writeVarint(bytes, key.size() - shared);
+        bytes.insert(bytes.end(), key.begin() + shared, key.end());
+    }
+    bytes.shrink_to_fit();
+}
+
+std::string_view FrontCodedDictionary::head(size_t block) const {
+    const char* p = bytes.data() + blocks[block];
+    uint64_t length = readVarint(p);
+    return {p, length};
+}
+
+// First code whose key is not below target. With skipPrefixed, keys that start with
+// target also count as below, which gives the end of target's prefix block.
+//
+// Inside a block, matched is the common prefix of target and the previous key, which
+// is known to be below target. A key sharing more than matched bytes with its
+// predecessor is below too, and one sharing fewer is above, so suffix bytes are
+// compared only when the shared length equals matched.
+int FrontCodedDictionary::search(std::string_view target, bool skipPrefixed, bool* exact) const {
+    auto below = [&](std::string_view key) {
+        return skipPrefixed ? key.substr(0, target.size()) <= target : key < target;
+    };
+    *exact = false;
+
+    // Blocks whose head is below target
+    size_t lo = 0, hi = blocks.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (below(head(mid))) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        *exact = numKeys > 0 && !skipPrefixed && head(0) == target;
+        return 0;
+    }
+
+    size_t block = lo - 1;
+    size_t first = block * kBlockKeys;
+    size_t count = std::min(kBlockKeys, numKeys - first);
+    const char* p = bytes.data() + blocks[block];
+    uint64_t length = readVarint(p);
+    size_t matched = commonPrefix(std::string_view(p, length), target);
+    p += length;
+
+    for (size_t i = 1; i < count; ++i) {
+        uint64_t shared = readVarint(p);
+        length = readVarint(p);
+        std::string_view suffix(p, length);
+        p += length;
+        if (shared > matched) {
+            continue; // Agrees with the previous key past the point where it fell below target
+        }
+        if (shared < matched) {
+            return static_cast<int>(first + i); // Differs from target where the previous key matched it
+        }
+        size_t extra = commonPrefix(suffix, target.substr(matched));
+        size_t reached = matched + extra;
+        if (reached == target.size()) {
+            if (skipPrefixed) {
+                matched = reached;
+                continue; // Starts with target
+            }
+            *exact = extra == suffix.size();
+            return static_cast<int>(first + i);
+        }
+        if (extra == suffix.size() || static_cast<unsigned char>(suffix[extra]) < static_cast<unsigned char>(target[reached])) {
+            matched = reached;
+            continue; // Proper prefix of target, or smaller at the first differing byte
+        }
+        return static_cast<int>(first + i);
+    }
+    // Not below target means the next head is the answer, and it may equal target
+    *exact = !skipPrefixed && block + 1 < blocks.size() && head(block + 1) == target;
+    return static_cast<int>(first + count);
+}
+
+int FrontCodedDictionary::find(std::string_view key) const {
+    bool exact;
+    int code = search(key, false, &exact);
+    return exact ? code : -1;
+}
+
+int FrontCodedDictionary::lowerBound(std::string_view key) const {
+    bool exact;
+    return search(key, false, &exact);
+}
+
+std::pair<int, int> FrontCodedDictionary::prefixRange(std::string_view prefix) const {
+    bool exact;
+    return {search(prefix, false, &exact), search(prefix, true, &exact)};
+}
+
+// Replay the block up to code
+std::string_view FrontCodedDictionary::key(int code, std::string& scratch) const {
+    size_t block = static_cast<size_t>(code) / kBlockKeys;
+    const char* p = bytes.data() + blocks[block];
+    uint64_t length = readVarint(p);
+    scratch.assign(p, length);
+    p += length;
+    for (size_t i = block * kBlockKeys; i < static_cast<size_t>(code); ++i) {
+        uint64_t shared = readVarint(p);
+        length = readVarint(p);
+        scratch.resize(shared);
+        scratch.append(p, length);
+        p += length;
+    }
+    return scratch;
+}
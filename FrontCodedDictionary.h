@@ -0,0 +1,61 @@
+#ifndef FRONT_CODED_DICTIONARY_H
+#define FRONT_CODED_DICTIONARY_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Immutable sorted key list in front-coded blocks; a key's code is its rank.
+// Each block stores its first key verbatim and every following key as
+// (shared prefix length with the previous key, suffix). Searches binary-search
+// the block heads and then walk one block comparing only the suffix bytes that
+// can still decide the order, so keys are never reconstructed to be matched.
+class FrontCodedDictionary {
+private:
+    static constexpr size_t kBlockKeys = 16;
+
+    std::vector<char> bytes;        // Blocks back to back; lengths are LEB128 varints
+    std::vector<uint64_t> blocks;   // Start of each block in bytes
+    size_t numKeys = 0;
+
+    std::string_view head(size_t block) const;
+    int search(std::string_view target, bool skipPrefixed, bool* exact) const;
+
+public:
+    explicit FrontCodedDictionary(const std::vector<std::string_view>& sortedKeys);
+
+    size_t size() const { return numKeys; }
+    size_t memoryBytes() const { return bytes.capacity() + blocks.capacity() * sizeof(uint64_t); }
+
+    int find(std::string_view key) const;                        // Code of key, or -1
+    int lowerBound(std::string_view key) const;                  // First code whose key is >= key
+    std::pair<int, int> prefixRange(std::string_view prefix) const; // Codes of keys starting with prefix
+    std::string_view key(int code, std::string& scratch) const;  // Decompress into scratch
+
+    // fn(key, code) in key order; the view is valid only during the call
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        std::string current;
+        for (size_t block = 0; block < blocks.size(); ++block) {
+            const char* p = bytes.data() + blocks[block];
+            size_t first = block * kBlockKeys;
+            size_t count = std::min(kBlockKeys, numKeys - first);
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t shared = i == 0 ? 0 : readVarint(p);
+                uint64_t length = readVarint(p);
+                current.resize(shared);
+                current.append(p, length);
+                p += length;
+                fn(std::string_view(current), static_cast<int>(first + i));
+            }
+        }
+    }
+
+    static uint64_t readVarint(const char*& p);
+};
+
+#endif
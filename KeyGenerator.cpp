@@ -0,0 +1,57 @@
+#include "KeyGenerator.h"
+#include <random>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+
+std::vector<std::string> generateDistinctKeys(size_t count, size_t minLength, size_t maxLength, uint64_t seed) {
+    static const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    std::mt19937_64 generator(seed);
+    std::uniform_int_distribution<size_t> character(0, sizeof(charset) - 2);
+    std::uniform_int_distribution<size_t> length(minLength, std::max(minLength, maxLength));
+
+    // Duplicates are redrawn; short lengths may not hold count keys, so give up after a while
+    std::vector<std::string> keys;
+    std::unordered_set<std::string> seen;
+    keys.reserve(count);
+    for (size_t attempts = 0; keys.size() < count && attempts < 4 * count + 1000; ++attempts) {
+        std::string key(length(generator), ' ');
+        for (char& c : key) {
+            c = charset[character(generator)];
+        }
+        if (seen.insert(key).second) {
+            keys.push_back(std::move(key));
+        }
+    }
+    return keys;
+}
+
+std::vector<std::string> generateKeys(const KeySpec& spec) {
+    std::vector<std::string> keys = generateDistinctKeys(spec.cardinality, spec.minLength, spec.maxLength, spec.seed);
+    std::vector<std::string> column(spec.rows);
+    if (keys.empty()) {
+        return column;
+    }
+    std::mt19937_64 generator(spec.seed + 1);
+    if (spec.zipf <= 0) {
+        std::uniform_int_distribution<size_t> rank(0, keys.size() - 1);
+        for (auto& value : column) {
+            value = keys[rank(generator)];
+        }
+        return column;
+    }
+
+    // Inverse transform sampling over the cumulative weights of the ranks
+    std::vector<double> cumulative(keys.size());
+    double total = 0;
+    for (size_t r = 0; r < keys.size(); ++r) {
+        total += 1.0 / std::pow(static_cast<double>(r + 1), spec.zipf);
+        cumulative[r] = total;
+    }
+    std::uniform_real_distribution<double> uniform(0, total);
+    for (auto& value : column) {
+        size_t r = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin();
+        value = keys[std::min(r, keys.size() - 1)];
+    }
+    return column;
+}
@@ -0,0 +1,26 @@
+#ifndef KEY_GENERATOR_H
+#define KEY_GENERATOR_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Shape of a generated column. The same spec always yields the same column.
+struct KeySpec {
+    size_t rows = 100000;
+    size_t cardinality = 100000; // Distinct keys drawn from (fewer when the lengths cannot hold that many)
+    size_t minLength = 8;
+    size_t maxLength = 8;
+    double zipf = 0;             // Zipf exponent of the key frequencies; 0 draws keys uniformly
+    uint64_t seed = 42;
+};
+
+// Distinct random alphabetic keys of lengths in [minLength, maxLength]
+std::vector<std::string> generateDistinctKeys(size_t count, size_t minLength, size_t maxLength, uint64_t seed);
+
+// Column of spec.rows values drawn from spec.cardinality distinct keys. Under a Zipf
+// distribution the key of rank r (from 1) is drawn with probability proportional to 1 / r^zipf.
+std::vector<std::string> generateKeys(const KeySpec& spec);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef KEY_HASH_H
+#define KEY_HASH_H
+
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// Key hashing and comparison for the dictionary probes. Both are inlined with the key length
+// as a compile-time constant for the common fixed widths (4, 8, 16 and 32 bytes), so those
+// keys are loaded as whole integers instead of walking a loop or calling memcmp.
+
+// 8 bytes per multiply-xorshift round, then a final avalanche. Persisted in column files
+// (VersionedDictionary::hashKey), so the result must never change.
+__attribute__((always_inline)) inline uint64_t hashKeyBytes(const char* bytes, size_t length) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 31;
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, length - i);
+        hash = (hash ^ word) * 0x94D049BB133111EBull;
+        hash ^= hash >> 29;
+    }
+    hash *= 0xBF58476D1CE4E5B9ull;
+    return hash ^ (hash >> 32);
+}
+
+inline uint64_t hashKeyBytes(std::string_view key) {
+    switch (key.size()) {
+        case 4: return hashKeyBytes(key.data(), 4);
+        case 8: return hashKeyBytes(key.data(), 8);
+        case 16: return hashKeyBytes(key.data(), 16);
+        case 32: return hashKeyBytes(key.data(), 32);
+        default: return hashKeyBytes(key.data(), key.size());
+    }
+}
+
+// First length bytes of a and b equal: two overlapping word loads up to 16 bytes, memcmp beyond
+__attribute__((always_inline)) inline bool sameKeyBytes(const char* a, const char* b, size_t length) {
+    if (length >= 8 && length <= 16) {
+        uint64_t a0, a1, b0, b1;
+        std::memcpy(&a0, a, 8);
+        std::memcpy(&b0, b, 8);
+        std::memcpy(&a1, a + length - 8, 8);
+        std::memcpy(&b1, b + length - 8, 8);
+        return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+    }
+    if (length >= 4 && length < 8) {
+        uint32_t a0, a1, b0, b1;
+        std::memcpy(&a0, a, 4);
+        std::memcpy(&b0, b, 4);
+        std::memcpy(&a1, a + length - 4, 4);
+        std::memcpy(&b1, b + length - 4, 4);
+        return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+    }
+    return std::memcmp(a, b, length) == 0;
+}
+
+inline bool sameKey(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    switch (a.size()) {
+        case 4: return sameKeyBytes(a.data(), b.data(), 4);
+        case 8: return sameKeyBytes(a.data(), b.data(), 8);
+        case 16: return sameKeyBytes(a.data(), b.data(), 16);
+        case 32: return sameKeyBytes(a.data(), b.data(), 32);
+        default: return sameKeyBytes(a.data(), b.data(), a.size());
+    }
+}
+
+#endif
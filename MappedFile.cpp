@@ -0,0 +1,40 @@
+#include "MappedFile.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error opening file: " << path << " (" << std::strerror(errno) << ")\n";
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        std::cerr << "Error reading file size: " << path << "\n";
+        ::close(fd);
+        return nullptr;
+    }
+    size_t length = static_cast<size_t>(info.st_size);
+    if (length == 0) { // mmap rejects empty mappings; an empty file maps to no bytes
+        ::close(fd);
+        return std::shared_ptr<MappedFile>(new MappedFile(nullptr, 0));
+    }
+    void* bytes = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file referenced
+    if (bytes == MAP_FAILED) {
+        std::cerr << "Error mapping file: " << path << " (" << std::strerror(errno) << ")\n";
+        return nullptr;
+    }
+    return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const char*>(bytes), length));
+}
+
+MappedFile::~MappedFile() {
+    if (length > 0) {
+        munmap(const_cast<char*>(bytes), length);
+    }
+}
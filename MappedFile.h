@@ -0,0 +1,27 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <memory>
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first touch,
+// so opening costs the same regardless of file size.
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+
+    MappedFile(const char* bytes, size_t length) : bytes(bytes), length(length) {}
+
+public:
+    static std::shared_ptr<MappedFile> open(const std::string& path); // Null (and a message on stderr) on failure
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "PackedColumn.h"
+#include "ScanKernels.h"
+#include <algorithm>
+
+// Up to this many disjoint code runs, IN-lists are evaluated as ORed range predicates
+static constexpr size_t kMaxInListRuns = 8;
+// Words evaluated per kernel call (delimiter masks are staged on the stack)
+static constexpr size_t kBlockWords = 256;
+
+// Pack codes with just enough bits for maxCode
+void PackedColumn::pack(const int* codes, size_t n, int maxCode) {
+    reset(maxCode);
+    append(codes, n);
+}
+
+void PackedColumn::reset(int maxCode) {
+    bitWidth = 1;
+    while (bitWidth < 31 && (int64_t(1) << bitWidth) <= maxCode) {
+        ++bitWidth;
+    }
+    fieldsPerWord = 64 / (bitWidth + 1);
+
+    valueMask = 0;
+    delimiterMask = 0;
+    std::fill(std::begin(fieldOfBit), std::end(fieldOfBit), 0);
+    for (int f = 0; f < fieldsPerWord; ++f) {
+        int base = f * (bitWidth + 1);
+        valueMask |= ((uint64_t(1) << bitWidth) - 1) << base;
+        delimiterMask |= uint64_t(1) << (base + bitWidth);
+        fieldOfBit[base + bitWidth] = static_cast<uint8_t>(f);
+    }
+
+    rows = 0;
+    words.clear();
+}
+
+// Fill the partial last word first, then whole new words
+void PackedColumn::append(const int* codes, size_t n) {
+    words.resize((rows + n + fieldsPerWord - 1) / fieldsPerWord, 0);
+    size_t w = rows / fieldsPerWord;
+    int f = static_cast<int>(rows % fieldsPerWord);
+    for (size_t i = 0; i < n; ++i) {
+        words[w] |= uint64_t(codes[i]) << (f * (bitWidth + 1));
+        if (++f == fieldsPerWord) {
+            f = 0;
+            ++w;
+        }
+    }
+    rows += n;
+}
+
+void PackedColumn::clear() {
+    words.clear();
+    rows = 0;
+}
+
+int PackedColumn::get(size_t row) const {
+    uint64_t word = words[row / fieldsPerWord];
+    int shift = static_cast<int>(row % fieldsPerWord) * (bitWidth + 1);
+    return static_cast<int>((word >> shift) & ((uint64_t(1) << bitWidth) - 1));
+}
+
+// Copy code into every field; code may be 2^bitWidth, which sets only the delimiter bits
+uint64_t PackedColumn::replicate(uint64_t code) const {
+    uint64_t result = 0;
+    for (int f = 0; f < fieldsPerWord; ++f) {
+        result |= code << (f * (bitWidth + 1));
+    }
+    return result;
+}
+
+// Translate the delimiter bits of one word into row bits of the result bitmap
+void PackedColumn::emitMatches(size_t word, uint64_t matches, Bitmap& bitmap) const {
+    size_t base = word * fieldsPerWord;
+    while (matches != 0) {
+        size_t row = base + fieldOfBit[__builtin_ctzll(matches)];
+        if (row < rows) { // Padding fields in the last word hold code 0
+            bitmap.set(row);
+        }
+        matches &= matches - 1;
+    }
+}
+
+// Replicated bounds for lo <= code < hi, clamped to the representable interval [0, 2^w]
+PackedRun PackedColumn::makeRun(int64_t lo, int64_t hi) const {
+    int64_t limit = int64_t(1) << bitWidth;
+    return {replicate(std::clamp<int64_t>(lo, 0, limit)), replicate(std::clamp<int64_t>(hi, 0, limit))};
+}
+
+// Evaluate the ORed runs one block of words at a time with the dispatched kernel
+Bitmap PackedColumn::scan(const std::vector<PackedRun>& runs) const {
+    Bitmap bitmap(rows);
+    if (runs.empty()) {
+        return bitmap;
+    }
+    const ScanKernels& kernels = scanKernels();
+    uint64_t matches[kBlockWords];
+    for (size_t w = 0; w < words.size(); w += kBlockWords) {
+        size_t count = std::min(kBlockWords, words.size() - w);
+        kernels.packedMatch(&words[w], count, runs.data(), runs.size(), valueMask, delimiterMask, matches);
+        for (size_t j = 0; j < count; ++j) {
+            if (matches[j] != 0) {
+                emitMatches(w + j, matches[j], bitmap);
+            }
+        }
+    }
+    return bitmap;
+}
+
+long PackedColumn::findFirst(int code) const {
+    if (code < 0 || (int64_t(code) >> bitWidth) != 0) {
+        return -1; // Not representable, so not present
+    }
+    PackedRun run = makeRun(code, int64_t(code) + 1);
+    const ScanKernels& kernels = scanKernels();
+    uint64_t matches[kBlockWords];
+    for (size_t w = 0; w < words.size(); w += kBlockWords) {
+        size_t count = std::min(kBlockWords, words.size() - w);
+        kernels.packedMatch(&words[w], count, &run, 1, valueMask, delimiterMask, matches);
+        for (size_t j = 0; j < count; ++j) {
+            if (matches[j] != 0) {
+                size_t row = (w + j) * fieldsPerWord + fieldOfBit[__builtin_ctzll(matches[j])];
+                return row < rows ? static_cast<long>(row) : -1;
+            }
+        }
+    }
+    return -1;
+}
+
+Bitmap PackedColumn::scanEqual(int code) const {
+    if (code < 0 || (int64_t(code) >> bitWidth) != 0) {
+        return Bitmap(rows);
+    }
+    return scan({makeRun(code, int64_t(code) + 1)});
+}
+
+Bitmap PackedColumn::scanRange(int lo, int hi) const {
+    if (lo >= hi) {
+        return Bitmap(rows);
+    }
+    return scan({makeRun(lo, hi)});
+}
+
+Bitmap PackedColumn::scanIn(std::vector<int> codes) const {
+    int64_t limit = int64_t(1) << bitWidth;
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+    // Coalesce consecutive codes into [lo, hi) runs
+    std::vector<std::pair<int64_t, int64_t>> bounds;
+    for (int code : codes) {
+        if (code < 0 || code >= limit) {
+            continue;
+        }
+        if (!bounds.empty() && bounds.back().second == code) {
+            bounds.back().second = code + 1;
+        } else {
+            bounds.emplace_back(code, code + 1);
+        }
+    }
+
+    if (bounds.size() <= kMaxInListRuns) {
+        // Few runs: OR together one range predicate per run
+        std::vector<PackedRun> runs;
+        for (const auto& [first, last] : bounds) {
+            runs.push_back(makeRun(first, last));
+        }
+        return scan(runs);
+    }
+
+    // Many runs: probe a bitset over the code domain once per field
+    std::vector<uint64_t> member((limit + 63) / 64, 0);
+    for (int code : codes) {
+        if (code >= 0 && code < limit) {
+            member[code / 64] |= uint64_t(1) << (code % 64);
+        }
+    }
+    Bitmap bitmap(rows);
+    uint64_t fieldMask = (uint64_t(1) << bitWidth) - 1;
+    for (size_t w = 0; w < words.size(); ++w) {
+        uint64_t word = words[w];
+        uint64_t matches = 0;
+        for (int f = 0; f < fieldsPerWord; ++f) {
+            int shift = f * (bitWidth + 1);
+            uint64_t code = (word >> shift) & fieldMask;
+            if (member[code / 64] & (uint64_t(1) << (code % 64))) {
+                matches |= uint64_t(1) << (shift + bitWidth);
+            }
+        }
+        emitMatches(w, matches, bitmap);
+    }
+    return bitmap;
+}
@@ -0,0 +1,48 @@
+#ifndef PACKED_COLUMN_H
+#define PACKED_COLUMN_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Bitmap.h"
+#include "ScanKernels.h"
+
+// Bit-packed code column in BitWeaving/H layout.
+// Each 64-bit word holds fieldsPerWord codes of bitWidth bits, each followed by a
+// zero delimiter bit. Predicates are evaluated on whole words with add/xor
+// arithmetic whose carries land in the delimiter bits, several words per SIMD op.
+class PackedColumn {
+private:
+    std::vector<uint64_t> words;  // Packed codes, fieldsPerWord per word
+    size_t rows = 0;              // Number of packed codes
+    int bitWidth = 1;             // Bits per code
+    int fieldsPerWord = 32;       // floor(64 / (bitWidth + 1))
+    uint64_t valueMask = 0;       // Low bitWidth bits of every field
+    uint64_t delimiterMask = 0;   // Delimiter bit of every field
+    uint8_t fieldOfBit[64] = {};  // Delimiter bit position -> field index
+
+    uint64_t replicate(uint64_t code) const; // Copy code into every field
+    PackedRun makeRun(int64_t lo, int64_t hi) const;
+    Bitmap scan(const std::vector<PackedRun>& runs) const; // Rows matching any run
+    void emitMatches(size_t word, uint64_t matches, Bitmap& bitmap) const;
+
+public:
+    void pack(const int* codes, size_t n, int maxCode); // Width = ceil(log2(maxCode + 1))
+    void reset(int maxCode);                            // Empty column sized for codes up to maxCode
+    void append(const int* codes, size_t n);            // Codes must fit the current width
+    bool fits(int code) const { return code >= 0 && (int64_t(code) >> bitWidth) == 0; }
+    void clear();
+
+    int get(size_t row) const;
+    size_t size() const { return rows; }
+    int width() const { return bitWidth; }
+    size_t memoryBytes() const { return words.size() * sizeof(uint64_t); }
+
+    // Predicate kernels on the packed form
+    long findFirst(int code) const;                          // First row == code, or -1
+    Bitmap scanEqual(int code) const;         // code == target
+    Bitmap scanRange(int lo, int hi) const;   // lo <= code < hi
+    Bitmap scanIn(std::vector<int> codes) const; // code in list
+};
+
+#endif
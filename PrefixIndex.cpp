@@ -0,0 +1,129 @@
+#include "PrefixIndex.h"
+#include <algorithm>
+#include <cstring>
+
+PrefixIndex::PrefixIndex(std::vector<std::pair<std::string_view, int>> entries, int codeBound) : bound(codeBound) {
+    std::sort(entries.begin(), entries.end());
+    codes.reserve(entries.size());
+    for (const auto& entry : entries) {
+        codes.push_back(entry.second);
+    }
+    nodes.push_back({0, 0, 0, 0, 0, static_cast<uint32_t>(entries.size())});
+    branches.push_back(0);
+    build(0, entries, 0);
+}
+
+// Split the keys of node, which all share their first depth bytes, into one child per
+// next byte. Each child's label runs to the longest prefix its keys share.
+void PrefixIndex::build(uint32_t node, const std::vector<std::pair<std::string_view, int>>& entries, size_t depth) {
+    size_t begin = nodes[node].begin, end = nodes[node].end;
+    if (begin < end && entries[begin].first.size() == depth) {
+        ++begin; // The key ending here sorts first
+    }
+
+    uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+    for (size_t i = begin; i < end;) {
+        unsigned char byte = entries[i].first[depth];
+        size_t groupEnd = i + 1;
+        while (groupEnd < end && static_cast<unsigned char>(entries[groupEnd].first[depth]) == byte) {
+            ++groupEnd;
+        }
+        // Sorted keys: the group's shared prefix is that of its first and last key
+        std::string_view first = entries[i].first, last = entries[groupEnd - 1].first;
+        size_t shared = depth + 1;
+        while (shared < first.size() && shared < last.size() && first[shared] == last[shared]) {
+            ++shared;
+        }
+        nodes.push_back({static_cast<uint32_t>(labels.size()), static_cast<uint32_t>(shared - depth), 0, 0,
+                         static_cast<uint32_t>(i), static_cast<uint32_t>(groupEnd)});
+        branches.push_back(byte);
+        labels.insert(labels.end(), first.begin() + depth, first.begin() + shared);
+        i = groupEnd;
+    }
+    uint32_t numChildren = static_cast<uint32_t>(nodes.size()) - firstChild;
+    nodes[node].firstChild = firstChild;
+    nodes[node].numChildren = numChildren;
+
+    for (uint32_t c = firstChild; c < firstChild + numChildren; ++c) {
+        build(c, entries, depth + nodes[c].labelLength);
+    }
+}
+
+const PrefixIndex::Node* PrefixIndex::child(const Node& node, unsigned char byte) const {
+    const unsigned char* first = branches.data() + node.firstChild;
+    const unsigned char* last = first + node.numChildren;
+    const unsigned char* it = std::lower_bound(first, last, byte);
+    return it != last && *it == byte ? &nodes[it - branches.data()] : nullptr;
+}
+
+std::span<const int> PrefixIndex::prefix(std::string_view prefix) const {
+    const Node* node = &nodes[0];
+    size_t depth = 0;
+    while (true) {
+        size_t n = std::min<size_t>(node->labelLength, prefix.size() - depth);
+        if (n != 0 && std::memcmp(labels.data() + node->label, prefix.data() + depth, n) != 0) {
+            return {};
+        }
+        depth += n;
+        if (depth == prefix.size()) {
+            return {codes.data() + node->begin, node->end - node->begin};
+        }
+        node = child(*node, prefix[depth]);
+        if (node == nullptr) {
+            return {};
+        }
+    }
+}
+
+size_t PrefixIndex::lowerBound(std::string_view key) const {
+    const Node* node = &nodes[0];
+    size_t depth = 0;
+    while (true) {
+        size_t n = std::min<size_t>(node->labelLength, key.size() - depth);
+        int order = n == 0 ? 0 : std::memcmp(labels.data() + node->label, key.data() + depth, n);
+        if (order != 0) {
+            return order > 0 ? node->begin : node->end; // Every key below node is greater / smaller
+        }
+        depth += n;
+        if (depth == key.size()) {
+            return node->begin; // Every key below node starts with key
+        }
+        // key continues past this node: a key ending here is smaller, so find the first child not below key
+        const unsigned char* first = branches.data() + node->firstChild;
+        const unsigned char* last = first + node->numChildren;
+        const unsigned char* it = std::lower_bound(first, last, static_cast<unsigned char>(key[depth]));
+        if (it == last) {
+            return node->end;
+        }
+        const Node* next = &nodes[it - branches.data()];
+        if (*it != static_cast<unsigned char>(key[depth])) {
+            return next->begin;
+        }
+        node = next;
+    }
+}
+
+// Spell out the key of rank by following the children whose ranks contain it
+std::string PrefixIndex::keyAt(size_t rank) const {
+    std::string key;
+    const Node* node = &nodes[0];
+    while (true) {
+        key.append(labels.data() + node->label, node->labelLength);
+        const Node* first = &nodes[0] + node->firstChild;
+        const Node* last = first + node->numChildren;
+        if (first == last || first->begin > rank) {
+            return key; // The key ending at this node
+        }
+        node = std::upper_bound(first, last, rank, [](size_t r, const Node& n) { return r < n.begin; }) - 1;
+    }
+}
+
+std::span<const int> PrefixIndex::range(std::string_view lo, std::string_view hi) const {
+    size_t first = lowerBound(lo);
+    size_t last = std::max(first, lowerBound(hi));
+    return {codes.data() + first, last - first};
+}
+
+size_t PrefixIndex::memoryBytes() const {
+    return nodes.capacity() * sizeof(Node) + branches.capacity() + labels.capacity() + codes.capacity() * sizeof(int);
+}
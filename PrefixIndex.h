@@ -0,0 +1,49 @@
+#ifndef PREFIX_INDEX_H
+#define PREFIX_INDEX_H
+
+#include <vector>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// Immutable path-compressed trie over (key, code) pairs. Keys are numbered by rank, and
+// every node covers one contiguous run of ranks, so the codes of all keys starting with a
+// prefix are a slice of codes[] found in O(|prefix|) steps, whatever the dictionary size.
+// Range bounds and successors come from the same descent.
+class PrefixIndex {
+private:
+    struct Node {
+        uint32_t label;       // Offset of the edge label (bytes consumed from the parent) in labels
+        uint32_t labelLength;
+        uint32_t firstChild;  // Children are nodes [firstChild, firstChild + numChildren), by first label byte
+        uint32_t numChildren;
+        uint32_t begin, end;  // Ranks of the keys below this node
+    };
+
+    std::vector<Node> nodes;             // nodes[0] is the root, with an empty label
+    std::vector<unsigned char> branches; // First label byte of every node, searched when descending
+    std::vector<char> labels;
+    std::vector<int> codes;              // Codes in key order
+    int bound = 0;                       // Every key with a code below this is indexed
+
+    const Node* child(const Node& node, unsigned char byte) const;
+    void build(uint32_t node, const std::vector<std::pair<std::string_view, int>>& entries, size_t depth);
+
+public:
+    // Index entries, each code below codeBound; sorts entries
+    PrefixIndex(std::vector<std::pair<std::string_view, int>> entries, int codeBound);
+
+    std::span<const int> prefix(std::string_view prefix) const;                 // Codes of keys starting with prefix
+    size_t lowerBound(std::string_view key) const;                              // Rank of the first key >= key
+    std::span<const int> range(std::string_view lo, std::string_view hi) const; // Codes of keys in [lo, hi)
+    std::string keyAt(size_t rank) const;                                       // Successor of key: keyAt(lowerBound(key))
+
+    size_t size() const { return codes.size(); }
+    int codeBound() const { return bound; }
+    size_t memoryBytes() const;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "QueryPlanner.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+// Nanoseconds per unit of work
+static constexpr double kLookup = 100;           // One dictionary probe
+static constexpr double kSearchStep = 40;        // One key compare of a binary search
+static constexpr double kIndexDescent = 1000;    // Trie descent
+static constexpr double kIndexCode = 2;          // Code copied out of the index
+static constexpr double kWalkKey = 15;           // Dictionary key visited and compared by a walk, in hash order
+static constexpr double kVerdictKey = 5;         // Key compared the first time a row scan meets its code; codes mostly come in order
+static constexpr double kRangeKey = 10;          // Extra per key compared with a range: two compares, their branches mispredicted
+static constexpr double kRowScanRow = 2.3;       // Row scan: code widened and its verdict looked up
+static constexpr double kVerdictMissRow = 2.5;   // Extra per row once the verdicts outgrow the L1 cache
+static constexpr size_t kVerdictCacheBytes = 32768;
+static constexpr double kStoredRowByte = 0.075;  // Equality or range compare per stored code byte (SIMD, narrow kernels)
+static constexpr double kAnyOfRow = 0.45;        // Compare against a code list: row widened and its bit written
+static constexpr double kAnyOfRowCode = 0.025;   // ... plus one compare per listed code
+static constexpr double kMemberRow = 0.7;        // One bitset probe (gathered)
+static constexpr double kSetWord = 1;            // Bitset word cleared and filled
+static constexpr double kParallelStart = 20000;  // Waking the scan pool and joining it
+static constexpr double kRawEqualRow = 1.5;      // Raw scan: string compare, mostly decided by the length
+static constexpr double kRawPrefixRow = 3;       // ... leading bytes compared
+static constexpr double kRawRangeRow = kRangeKey; // ... two compares
+
+static constexpr double kNotApplicable = std::numeric_limits<double>::infinity();
+
+// Extra time to compare one key with the predicate, beyond an equality or prefix compare
+static double compareCost(const PlanInput& input) {
+    return input.op == PredicateOp::Range ? kRangeKey : 0;
+}
+
+// Time to find the codes of the matching keys
+static double resolveCost(const PlanInput& input) {
+    if (input.codesInHand) {
+        return 0;
+    }
+    double keys = static_cast<double>(input.keys);
+    switch (input.source) {
+        case CodeSource::Lookup:
+            return kLookup;
+        case CodeSource::Search:
+            return kSearchStep * 2 * std::log2(keys + 1);
+        case CodeSource::Index:
+            return kIndexDescent + kIndexCode * input.matchingCodes;
+        case CodeSource::Walk:
+            return (kWalkKey + compareCost(input)) * keys;
+    }
+    return kNotApplicable;
+}
+
+double QueryPlanner::cost(const PlanInput& input, ScanStrategy strategy, bool parallel) {
+    double rows = static_cast<double>(input.rows);
+    double codes = std::max(1.0, input.matchingCodes);
+    if (parallel && (input.threads < 2 || strategy == ScanStrategy::Empty || strategy == ScanStrategy::RowScan ||
+                     strategy == ScanStrategy::RawScan)) {
+        return kNotApplicable;
+    }
+    double scan = 0;
+    switch (strategy) {
+        case ScanStrategy::Empty:
+            return input.exact && input.matchingCodes == 0 ? resolveCost(input) : kNotApplicable;
+        case ScanStrategy::RowScan:
+            if (input.codesInHand) {
+                return kNotApplicable;
+            }
+            // No resolution: each distinct code met is decided once, at most one per key
+            return rows * (kRowScanRow + (input.keys > kVerdictCacheBytes ? kVerdictMissRow : 0)) +
+                   std::min(rows, static_cast<double>(input.keys)) * (kVerdictKey + compareCost(input));
+        case ScanStrategy::RawScan:
+            if (!input.rawStrings || input.codesInHand) {
+                return kNotApplicable;
+            }
+            // Nothing resolved; no dictionary access at all
+            return rows * (input.op == PredicateOp::Equal ? kRawEqualRow : input.op == PredicateOp::Prefix ? kRawPrefixRow : kRawRangeRow);
+        case ScanStrategy::CodeCompare:
+            // One code has a kernel at the stored width; lists compare widened rows
+            scan = codes <= 1 ? rows * kStoredRowByte * input.codeBytes : rows * (kAnyOfRow + kAnyOfRowCode * codes);
+            break;
+        case ScanStrategy::CodeSet:
+            scan = rows * kMemberRow + static_cast<double>(input.keys) / 32 * kSetWord;
+            break;
+        case ScanStrategy::CodeRange:
+            if (!input.contiguous) {
+                return kNotApplicable;
+            }
+            scan = rows * kStoredRowByte * input.codeBytes;
+            break;
+    }
+    if (parallel) {
+        scan = scan / static_cast<double>(input.threads) + kParallelStart;
+    }
+    return resolveCost(input) + scan;
+}
+
+QueryPlan QueryPlanner::choose(const PlanInput& input) {
+    QueryPlan plan;
+    plan.source = input.source;
+    plan.matchingCodes = input.matchingCodes;
+    plan.exact = input.exact;
+    plan.costNanos = kNotApplicable;
+    // On a tie the earlier strategy wins: a single code compares with the zone masks, which skip more than bounds
+    for (ScanStrategy strategy : {ScanStrategy::Empty, ScanStrategy::CodeCompare, ScanStrategy::CodeRange, ScanStrategy::CodeSet,
+                                  ScanStrategy::RowScan, ScanStrategy::RawScan}) {
+        for (bool parallel : {false, true}) {
+            double estimate = cost(input, strategy, parallel);
+            if (estimate < plan.costNanos) {
+                plan.strategy = strategy;
+                plan.parallel = parallel;
+                plan.costNanos = estimate;
+            }
+        }
+    }
+    return plan;
+}
+
+std::string QueryPlan::describe() const {
+    std::ostringstream out;
+    out << QueryPlanner::name(strategy) << (parallel ? " (parallel)" : "") << ", codes by " << QueryPlanner::name(source) << ", "
+        << (exact ? "" : "~") << static_cast<size_t>(matchingCodes + 0.5) << " matching codes, estimated " << costNanos / 1000 << " us";
+    return out.str();
+}
+
+const char* QueryPlanner::name(ScanStrategy strategy) {
+    static const char* const names[] = {"empty", "row scan", "code compare", "code set", "code range", "raw scan"};
+    return names[static_cast<size_t>(strategy)];
+}
+
+const char* QueryPlanner::name(CodeSource source) {
+    static const char* const names[] = {"lookup", "search", "index", "walk"};
+    return names[static_cast<size_t>(source)];
+}
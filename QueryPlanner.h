@@ -0,0 +1,76 @@
+#ifndef QUERY_PLANNER_H
+#define QUERY_PLANNER_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+enum class PredicateOp { Equal, Prefix, Range };
+
+// One predicate on the keys of a column
+struct Predicate {
+    PredicateOp op;
+    std::string value; // Equal: the value, Prefix: the prefix, Range: inclusive lower bound
+    std::string upper; // Range: exclusive upper bound
+};
+
+// How a predicate's rows are found
+enum class ScanStrategy {
+    Empty,       // No key matches: no column pass
+    RowScan,     // One pass deciding each code on first sight by comparing its key; nothing resolved up front
+    CodeCompare, // Resolve the matching codes, then compare every row with each of them
+    CodeSet,     // Resolve the matching codes into a bitset, then one bit probe per row
+    CodeRange,   // Matching codes form one interval: one unsigned compare per row, zones skipped or taken whole
+    RawScan      // The predicate compared with every row's string; only when the caller passes the strings
+};
+
+// How the matching codes are resolved in the dictionary
+enum class CodeSource {
+    Lookup, // Equal: one hash probe
+    Search, // Ordered codes: binary search for the code interval
+    Index,  // Prefix index: one trie descent, plus the keys appended since it was built
+    Walk    // Every dictionary key compared
+};
+
+// What the planner knows about a column version and a predicate. Matching codes are exact
+// when resolving them is cheap (lookups, searches, index descents) and sampled otherwise.
+struct PlanInput {
+    PredicateOp op = PredicateOp::Equal;
+    size_t rows = 0;
+    size_t keys = 0;              // Dictionary codes visible
+    unsigned codeBytes = 4;       // Bytes per stored code
+    CodeSource source = CodeSource::Walk;
+    double matchingCodes = 0;     // Codes whose key matches
+    bool exact = false;           // matchingCodes is a count, not an estimate
+    bool contiguous = false;      // The matching codes form one interval
+    bool codesInHand = false;     // Already resolved: nothing left to pay for them, and no reason to row scan
+    bool rawStrings = false;      // The caller passed the column's strings, so a raw scan is possible
+    size_t threads = 1;           // Scan pool size
+};
+
+// A chosen strategy and the estimate that won it
+struct QueryPlan {
+    ScanStrategy strategy = ScanStrategy::Empty;
+    CodeSource source = CodeSource::Walk;
+    bool parallel = false;        // Morsel-parallel on the scan pool
+    double matchingCodes = 0;
+    bool exact = false;
+    double costNanos = 0;         // Estimated time to answer
+
+    std::string describe() const; // One line, for logs
+};
+
+// Cost model over the scan strategies. Costs are nanoseconds on one core, from per-row and
+// per-key constants measured with the kernels of ScanKernels.h; they only need to rank
+// the strategies, not predict times. Code strategies pay for resolving the codes first.
+// The encoder keeps no strings, so a raw scan is only weighed when the caller has them.
+class QueryPlanner {
+public:
+    static QueryPlan choose(const PlanInput& input);
+    static double cost(const PlanInput& input, ScanStrategy strategy, bool parallel); // Infinite when not applicable
+
+    static const char* name(ScanStrategy strategy);
+    static const char* name(CodeSource source);
+};
+
+#endif
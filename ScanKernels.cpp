@@ -0,0 +1,974 @@
+#include "ScanKernels.h"
+#include "KeyHash.h"
+#include <immintrin.h> // SIMD intrinsics
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+// Each instruction set gets its own functions compiled with a target attribute,
+// so the binary runs on any x86-64 CPU and only calls what the CPU supports.
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+
+// ---------------------------------------------------------------------------
+// Scalar kernels (also used for the tails of the SIMD kernels)
+// ---------------------------------------------------------------------------
+
+static long findEqualScalar(const int* codes, size_t n, int code) {
+    for (size_t i = 0; i < n; ++i) {
+        if (codes[i] == code) {
+            return static_cast<long>(i);
+        }
+    }
+    return -1;
+}
+
+static void scanEqualScalarFrom(const int* codes, size_t begin, size_t n, int code, uint64_t* bitmap) {
+    for (size_t i = begin; i < n; ++i) {
+        bitmap[i / 64] |= uint64_t(codes[i] == code) << (i % 64);
+    }
+}
+
+static void scanEqualScalar(const int* codes, size_t n, int code, uint64_t* bitmap) {
+    scanEqualScalarFrom(codes, 0, n, code, bitmap);
+}
+
+// lo <= code < hi as one unsigned compare: (code - lo) < (hi - lo)
+static void scanRangeScalarFrom(const int* codes, size_t begin, size_t n, int lo, int hi, uint64_t* bitmap) {
+    if (lo >= hi) {
+        return;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    for (size_t i = begin; i < n; ++i) {
+        bitmap[i / 64] |= uint64_t(static_cast<unsigned>(codes[i]) - static_cast<unsigned>(lo) < width) << (i % 64);
+    }
+}
+
+static void scanRangeScalar(const int* codes, size_t n, int lo, int hi, uint64_t* bitmap) {
+    scanRangeScalarFrom(codes, 0, n, lo, hi, bitmap);
+}
+
+static size_t countRangeScalarFrom(const int* codes, size_t begin, size_t n, int lo, int hi) {
+    if (lo >= hi) {
+        return 0;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    size_t count = 0;
+    for (size_t i = begin; i < n; ++i) {
+        count += static_cast<unsigned>(codes[i]) - static_cast<unsigned>(lo) < width;
+    }
+    return count;
+}
+
+static size_t countRangeScalar(const int* codes, size_t n, int lo, int hi) {
+    return countRangeScalarFrom(codes, 0, n, lo, hi);
+}
+
+static void scanAnyOfScalarFrom(const int* codes, size_t begin, size_t n, const int* targets, size_t numTargets, uint64_t* bitmap) {
+    for (size_t i = begin; i < n; ++i) {
+        bool match = false;
+        for (size_t t = 0; t < numTargets; ++t) {
+            match |= codes[i] == targets[t];
+        }
+        bitmap[i / 64] |= uint64_t(match) << (i % 64);
+    }
+}
+
+static void scanAnyOfScalar(const int* codes, size_t n, const int* targets, size_t numTargets, uint64_t* bitmap) {
+    scanAnyOfScalarFrom(codes, 0, n, targets, numTargets, bitmap);
+}
+
+// Out-of-range codes probe bit 0 instead of branching, and the range test masks the result
+static void scanMemberScalarFrom(const int* codes, size_t begin, size_t n, const uint32_t* set, int limit, uint64_t* bitmap) {
+    if (limit <= 0) {
+        return;
+    }
+    for (size_t i = begin; i < n; ++i) {
+        unsigned code = static_cast<unsigned>(codes[i]);
+        bool inRange = code < static_cast<unsigned>(limit);
+        unsigned probe = code & -static_cast<unsigned>(inRange);
+        uint64_t match = inRange & (set[probe >> 5] >> (probe & 31));
+        bitmap[i / 64] |= match << (i % 64);
+    }
+}
+
+static void scanMemberScalar(const int* codes, size_t n, const uint32_t* set, int limit, uint64_t* bitmap) {
+    scanMemberScalarFrom(codes, 0, n, set, limit, bitmap);
+}
+
+// Branch-free selection: always store, advance only on a match
+static size_t selectEqualScalarFrom(const int* codes, size_t begin, size_t n, int code, int* out, size_t count) {
+    for (size_t i = begin; i < n; ++i) {
+        out[count] = static_cast<int>(i);
+        count += codes[i] == code;
+    }
+    return count;
+}
+
+static size_t selectEqualScalar(const int* codes, size_t n, int code, int* out) {
+    return selectEqualScalarFrom(codes, 0, n, code, out, 0);
+}
+
+static size_t selectRangeScalarFrom(const int* codes, size_t begin, size_t n, int lo, int hi, int* out, size_t count) {
+    if (lo >= hi) {
+        return count;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    for (size_t i = begin; i < n; ++i) {
+        out[count] = static_cast<int>(i);
+        count += static_cast<unsigned>(codes[i]) - static_cast<unsigned>(lo) < width;
+    }
+    return count;
+}
+
+static size_t selectRangeScalar(const int* codes, size_t n, int lo, int hi, int* out) {
+    return selectRangeScalarFrom(codes, 0, n, lo, hi, out, 0);
+}
+
+static bool prefixMatchScalar(const char* key, const char* prefix, size_t length) {
+    return std::memcmp(key, prefix, length) == 0;
+}
+
+static void hashKeysScalar(const std::string_view* keys, size_t n, uint64_t* hashes) {
+    for (size_t i = 0; i < n; ++i) {
+        hashes[i] = hashKeyBytes(keys[i]);
+    }
+}
+
+// BitWeaving/H less-than: (2^w - 1 - x) + c carries into the delimiter bit iff x < c
+static inline uint64_t packedLess(uint64_t x, uint64_t c, uint64_t valueMask, uint64_t delimiterMask) {
+    return ((x ^ valueMask) + c) & delimiterMask;
+}
+
+static void packedMatchScalarFrom(const uint64_t* words, size_t begin, size_t n, const PackedRun* runs, size_t numRuns,
+                                  uint64_t valueMask, uint64_t delimiterMask, uint64_t* matches) {
+    for (size_t w = begin; w < n; ++w) {
+        uint64_t m = 0;
+        for (size_t r = 0; r < numRuns; ++r) {
+            m |= packedLess(words[w], runs[r].hi, valueMask, delimiterMask) &
+                 ~packedLess(words[w], runs[r].lo, valueMask, delimiterMask);
+        }
+        matches[w] = m;
+    }
+}
+
+static void packedMatchScalar(const uint64_t* words, size_t n, const PackedRun* runs, size_t numRuns,
+                              uint64_t valueMask, uint64_t delimiterMask, uint64_t* matches) {
+    packedMatchScalarFrom(words, 0, n, runs, numRuns, valueMask, delimiterMask, matches);
+}
+
+// Narrow codes: [lo, hi) clipped to the values Code can hold, as its first code and the
+// largest offset from it. lo <= code < hi is then (Code)(code - first) <= last, an unsigned
+// compare that fits the lanes of the codes themselves. False when nothing can match.
+template <typename Code>
+static bool narrowRange(long lo, long hi, Code& first, Code& last) {
+    lo = std::max(lo, 0L);
+    hi = std::min(hi, long(std::numeric_limits<Code>::max()) + 1);
+    if (lo >= hi) {
+        return false;
+    }
+    first = static_cast<Code>(lo);
+    last = static_cast<Code>(hi - lo - 1);
+    return true;
+}
+
+template <typename Code>
+static long findNarrowScalarFrom(const Code* codes, size_t begin, size_t n, Code first, Code last) {
+    for (size_t i = begin; i < n; ++i) {
+        if (static_cast<Code>(codes[i] - first) <= last) {
+            return static_cast<long>(i);
+        }
+    }
+    return -1;
+}
+
+template <typename Code>
+static void scanNarrowScalarFrom(const Code* codes, size_t begin, size_t n, Code first, Code last, uint64_t* bitmap) {
+    for (size_t i = begin; i < n; ++i) {
+        bitmap[i / 64] |= uint64_t(static_cast<Code>(codes[i] - first) <= last) << (i % 64);
+    }
+}
+
+template <typename Code>
+static size_t countNarrowScalarFrom(const Code* codes, size_t begin, size_t n, Code first, Code last) {
+    size_t count = 0;
+    for (size_t i = begin; i < n; ++i) {
+        count += static_cast<Code>(codes[i] - first) <= last;
+    }
+    return count;
+}
+
+template <typename Code>
+static long findNarrowScalar(const Code* codes, size_t n, Code first, Code last) {
+    return findNarrowScalarFrom(codes, 0, n, first, last);
+}
+
+template <typename Code>
+static void scanNarrowScalar(const Code* codes, size_t n, Code first, Code last, uint64_t* bitmap) {
+    scanNarrowScalarFrom(codes, 0, n, first, last, bitmap);
+}
+
+template <typename Code>
+static size_t countNarrowScalar(const Code* codes, size_t n, Code first, Code last) {
+    return countNarrowScalarFrom(codes, 0, n, first, last);
+}
+
+// ---------------------------------------------------------------------------
+// SSE4.2 kernels: 4 codes / 16 bytes / 2 packed words per instruction
+// ---------------------------------------------------------------------------
+
+TARGET_SSE42 static long findEqualSSE42(const int* codes, size_t n, int code) {
+    __m128i target = _mm_set1_epi32(code);
+    size_t i = 0;
+    for (; i + 3 < n; i += 4) {
+        __m128i cmp = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), target);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+        if (mask != 0) {
+            return static_cast<long>(i + __builtin_ctz(mask));
+        }
+    }
+    long tail = findEqualScalar(codes + i, n - i, code);
+    return tail < 0 ? -1 : static_cast<long>(i) + tail;
+}
+
+TARGET_SSE42 static void scanEqualSSE42(const int* codes, size_t n, int code, uint64_t* bitmap) {
+    __m128i target = _mm_set1_epi32(code);
+    size_t i = 0;
+    for (; i + 3 < n; i += 4) {
+        __m128i cmp = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), target);
+        bitmap[i / 64] |= uint64_t(_mm_movemask_ps(_mm_castsi128_ps(cmp))) << (i % 64);
+    }
+    scanEqualScalarFrom(codes, i, n, code, bitmap);
+}
+
+// SSE/AVX2 lack unsigned compares, so flip the sign bit on both sides of (code - lo) < width
+TARGET_SSE42 static inline __m128i inRangeSSE42(__m128i x, __m128i lo, __m128i limit) {
+    __m128i offset = _mm_xor_si128(_mm_sub_epi32(x, lo), _mm_set1_epi32(static_cast<int>(0x80000000u)));
+    return _mm_cmpgt_epi32(limit, offset);
+}
+
+TARGET_SSE42 static void scanRangeSSE42(const int* codes, size_t n, int lo, int hi, uint64_t* bitmap) {
+    if (lo >= hi) {
+        return;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    __m128i loVec = _mm_set1_epi32(lo);
+    __m128i limit = _mm_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+    size_t i = 0;
+    for (; i + 3 < n; i += 4) {
+        __m128i cmp = inRangeSSE42(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), loVec, limit);
+        bitmap[i / 64] |= uint64_t(_mm_movemask_ps(_mm_castsi128_ps(cmp))) << (i % 64);
+    }
+    scanRangeScalarFrom(codes, i, n, lo, hi, bitmap);
+}
+
+// Matching lanes are all ones, so subtracting the compare result counts per lane
+TARGET_SSE42 static size_t countRangeSSE42(const int* codes, size_t n, int lo, int hi) {
+    if (lo >= hi) {
+        return 0;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    __m128i loVec = _mm_set1_epi32(lo);
+    __m128i limit = _mm_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+    __m128i counts = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 3 < n; i += 4) {
+        counts = _mm_sub_epi32(counts, inRangeSSE42(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), loVec, limit));
+    }
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), counts);
+    return size_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3] + countRangeScalarFrom(codes, i, n, lo, hi);
+}
+
+TARGET_SSE42 static void scanAnyOfSSE42(const int* codes, size_t n, const int* targets, size_t numTargets, uint64_t* bitmap) {
+    size_t i = 0;
+    for (; i + 3 < n; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i));
+        __m128i cmp = _mm_setzero_si128();
+        for (size_t t = 0; t < numTargets; ++t) {
+            cmp = _mm_or_si128(cmp, _mm_cmpeq_epi32(x, _mm_set1_epi32(targets[t])));
+        }
+        bitmap[i / 64] |= uint64_t(_mm_movemask_ps(_mm_castsi128_ps(cmp))) << (i % 64);
+    }
+    scanAnyOfScalarFrom(codes, i, n, targets, numTargets, bitmap);
+}
+
+TARGET_SSE42 static size_t selectEqualSSE42(const int* codes, size_t n, int code, int* out) {
+    __m128i target = _mm_set1_epi32(code);
+    size_t count = 0, i = 0;
+    for (; i + 3 < n; i += 4) {
+        __m128i cmp = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), target);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+        while (mask != 0) {
+            out[count++] = static_cast<int>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return selectEqualScalarFrom(codes, i, n, code, out, count);
+}
+
+TARGET_SSE42 static size_t selectRangeSSE42(const int* codes, size_t n, int lo, int hi, int* out) {
+    if (lo >= hi) {
+        return 0;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    __m128i loVec = _mm_set1_epi32(lo);
+    __m128i limit = _mm_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+    size_t count = 0, i = 0;
+    for (; i + 3 < n; i += 4) {
+        __m128i cmp = inRangeSSE42(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), loVec, limit);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+        while (mask != 0) {
+            out[count++] = static_cast<int>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return selectRangeScalarFrom(codes, i, n, lo, hi, out, count);
+}
+
+// Compare 16-byte chunks; the last chunk overlaps the previous one instead of reading past length
+TARGET_SSE42 static bool prefixMatchSSE42(const char* key, const char* prefix, size_t length) {
+    if (length < 16) {
+        return prefixMatchScalar(key, prefix, length);
+    }
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) {
+            return false;
+        }
+    }
+    if (i < length) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + length - 16));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix + length - 16));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF;
+    }
+    return true;
+}
+
+// CRC32C, one crc32 instruction per 8 bytes. Inlined with a constant length for the fixed widths.
+TARGET_SSE42 __attribute__((always_inline)) static inline uint64_t crcKey(const char* bytes, size_t length) {
+    uint64_t crc = 0x9E3779B9u ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        crc = _mm_crc32_u64(crc, word);
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, length - i);
+        crc = _mm_crc32_u64(crc, word);
+    }
+    return crc;
+}
+
+// Keys of a block do not depend on each other, so their crc32 chains overlap in the pipeline
+TARGET_SSE42 static void hashKeysSSE42(const std::string_view* keys, size_t n, uint64_t* hashes) {
+    for (size_t i = 0; i < n; ++i) {
+        const char* bytes = keys[i].data();
+        switch (keys[i].size()) {
+            case 4: hashes[i] = crcKey(bytes, 4); break;
+            case 8: hashes[i] = crcKey(bytes, 8); break;
+            case 16: hashes[i] = crcKey(bytes, 16); break;
+            case 32: hashes[i] = crcKey(bytes, 32); break;
+            default: hashes[i] = crcKey(bytes, keys[i].size());
+        }
+    }
+}
+
+TARGET_SSE42 static void packedMatchSSE42(const uint64_t* words, size_t n, const PackedRun* runs, size_t numRuns,
+                                          uint64_t valueMask, uint64_t delimiterMask, uint64_t* matches) {
+    __m128i vVec = _mm_set1_epi64x(valueMask);
+    __m128i dVec = _mm_set1_epi64x(delimiterMask);
+    size_t w = 0;
+    for (; w + 1 < n; w += 2) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words + w)), vVec);
+        __m128i m = _mm_setzero_si128();
+        for (size_t r = 0; r < numRuns; ++r) {
+            __m128i belowHi = _mm_add_epi64(x, _mm_set1_epi64x(runs[r].hi));
+            __m128i belowLo = _mm_add_epi64(x, _mm_set1_epi64x(runs[r].lo));
+            m = _mm_or_si128(m, _mm_andnot_si128(belowLo, belowHi));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(matches + w), _mm_and_si128(m, dVec));
+    }
+    packedMatchScalarFrom(words, w, n, runs, numRuns, valueMask, delimiterMask, matches);
+}
+
+// Narrow codes, 16 per step: one compare of 16 uint8 codes, or two of 8 uint16 codes
+// packed down to bytes. In range is min(code - first, last) == code - first.
+template <typename Code>
+TARGET_SSE42 static inline __m128i broadcastSSE42(Code value) {
+    return sizeof(Code) == 1 ? _mm_set1_epi8(static_cast<char>(value)) : _mm_set1_epi16(static_cast<short>(value));
+}
+
+template <typename Code>
+TARGET_SSE42 static inline unsigned narrowMaskSSE42(const Code* codes, __m128i first, __m128i last) {
+    if constexpr (sizeof(Code) == 1) {
+        __m128i offset = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes)), first);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(offset, last), offset));
+    } else {
+        __m128i a = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes)), first);
+        __m128i b = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 8)), first);
+        __m128i inA = _mm_cmpeq_epi16(_mm_min_epu16(a, last), a);
+        __m128i inB = _mm_cmpeq_epi16(_mm_min_epu16(b, last), b);
+        return _mm_movemask_epi8(_mm_packs_epi16(inA, inB));
+    }
+}
+
+template <typename Code>
+TARGET_SSE42 static long findNarrowSSE42(const Code* codes, size_t n, Code first, Code last) {
+    __m128i firstVec = broadcastSSE42(first), lastVec = broadcastSSE42(last);
+    size_t i = 0;
+    for (; i + 15 < n; i += 16) {
+        unsigned mask = narrowMaskSSE42(codes + i, firstVec, lastVec);
+        if (mask != 0) {
+            return static_cast<long>(i + __builtin_ctz(mask));
+        }
+    }
+    return findNarrowScalarFrom(codes, i, n, first, last);
+}
+
+template <typename Code>
+TARGET_SSE42 static void scanNarrowSSE42(const Code* codes, size_t n, Code first, Code last, uint64_t* bitmap) {
+    __m128i firstVec = broadcastSSE42(first), lastVec = broadcastSSE42(last);
+    size_t i = 0;
+    for (; i + 15 < n; i += 16) {
+        bitmap[i / 64] |= uint64_t(narrowMaskSSE42(codes + i, firstVec, lastVec)) << (i % 64);
+    }
+    scanNarrowScalarFrom(codes, i, n, first, last, bitmap);
+}
+
+template <typename Code>
+TARGET_SSE42 static size_t countNarrowSSE42(const Code* codes, size_t n, Code first, Code last) {
+    __m128i firstVec = broadcastSSE42(first), lastVec = broadcastSSE42(last);
+    size_t count = 0, i = 0;
+    for (; i + 15 < n; i += 16) {
+        count += __builtin_popcount(narrowMaskSSE42(codes + i, firstVec, lastVec));
+    }
+    return count + countNarrowScalarFrom(codes, i, n, first, last);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels: 8 codes / 32 bytes / 4 packed words per instruction
+// ---------------------------------------------------------------------------
+
+TARGET_AVX2 static long findEqualAVX2(const int* codes, size_t n, int code) {
+    __m256i target = _mm256_set1_epi32(code);
+    size_t i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256i cmp = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i)), target);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+        if (mask != 0) {
+            return static_cast<long>(i + __builtin_ctz(mask));
+        }
+    }
+    long tail = findEqualScalar(codes + i, n - i, code);
+    return tail < 0 ? -1 : static_cast<long>(i) + tail;
+}
+
+TARGET_AVX2 static void scanEqualAVX2(const int* codes, size_t n, int code, uint64_t* bitmap) {
+    __m256i target = _mm256_set1_epi32(code);
+    size_t i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256i cmp = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i)), target);
+        bitmap[i / 64] |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(cmp))) << (i % 64);
+    }
+    scanEqualScalarFrom(codes, i, n, code, bitmap);
+}
+
+TARGET_AVX2 static inline __m256i inRangeAVX2(__m256i x, __m256i lo, __m256i limit) {
+    __m256i offset = _mm256_xor_si256(_mm256_sub_epi32(x, lo), _mm256_set1_epi32(static_cast<int>(0x80000000u)));
+    return _mm256_cmpgt_epi32(limit, offset);
+}
+
+TARGET_AVX2 static void scanRangeAVX2(const int* codes, size_t n, int lo, int hi, uint64_t* bitmap) {
+    if (lo >= hi) {
+        return;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    __m256i loVec = _mm256_set1_epi32(lo);
+    __m256i limit = _mm256_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+    size_t i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256i cmp = inRangeAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i)), loVec, limit);
+        bitmap[i / 64] |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(cmp))) << (i % 64);
+    }
+    scanRangeScalarFrom(codes, i, n, lo, hi, bitmap);
+}
+
+TARGET_AVX2 static size_t countRangeAVX2(const int* codes, size_t n, int lo, int hi) {
+    if (lo >= hi) {
+        return 0;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    __m256i loVec = _mm256_set1_epi32(lo);
+    __m256i limit = _mm256_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+    __m256i counts = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 7 < n; i += 8) {
+        counts = _mm256_sub_epi32(counts, inRangeAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i)), loVec, limit));
+    }
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), counts);
+    size_t count = countRangeScalarFrom(codes, i, n, lo, hi);
+    for (uint32_t lane : lanes) {
+        count += lane;
+    }
+    return count;
+}
+
+TARGET_AVX2 static void scanAnyOfAVX2(const int* codes, size_t n, const int* targets, size_t numTargets, uint64_t* bitmap) {
+    size_t i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i));
+        __m256i cmp = _mm256_setzero_si256();
+        for (size_t t = 0; t < numTargets; ++t) {
+            cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(x, _mm256_set1_epi32(targets[t])));
+        }
+        bitmap[i / 64] |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(cmp))) << (i % 64);
+    }
+    scanAnyOfScalarFrom(codes, i, n, targets, numTargets, bitmap);
+}
+
+// Out-of-range lanes are masked out of the gather, so they never touch the set
+TARGET_AVX2 static void scanMemberAVX2(const int* codes, size_t n, const uint32_t* set, int limit, uint64_t* bitmap) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i limitVec = _mm256_set1_epi32(static_cast<int>(static_cast<unsigned>(limit) ^ 0x80000000u));
+    __m256i bitMask = _mm256_set1_epi32(31);
+    __m256i one = _mm256_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i));
+        __m256i valid = inRangeAVX2(x, zero, limitVec);
+        __m256i words = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int*>(set), _mm256_srli_epi32(x, 5), valid, 4);
+        __m256i bits = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(x, bitMask)), one);
+        __m256i match = _mm256_cmpeq_epi32(bits, one);
+        bitmap[i / 64] |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(match))) << (i % 64);
+    }
+    scanMemberScalarFrom(codes, i, n, set, limit, bitmap);
+}
+
+TARGET_AVX2 static size_t selectEqualAVX2(const int* codes, size_t n, int code, int* out) {
+    __m256i target = _mm256_set1_epi32(code);
+    size_t count = 0, i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256i cmp = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i)), target);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+        while (mask != 0) {
+            out[count++] = static_cast<int>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return selectEqualScalarFrom(codes, i, n, code, out, count);
+}
+
+TARGET_AVX2 static size_t selectRangeAVX2(const int* codes, size_t n, int lo, int hi, int* out) {
+    if (lo >= hi) {
+        return 0;
+    }
+    unsigned width = static_cast<unsigned>(hi) - static_cast<unsigned>(lo);
+    __m256i loVec = _mm256_set1_epi32(lo);
+    __m256i limit = _mm256_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+    size_t count = 0, i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256i cmp = inRangeAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i)), loVec, limit);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+        while (mask != 0) {
+            out[count++] = static_cast<int>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return selectRangeScalarFrom(codes, i, n, lo, hi, out, count);
+}
+
+TARGET_AVX2 static bool prefixMatchAVX2(const char* key, const char* prefix, size_t length) {
+    if (length < 32) {
+        return prefixMatchSSE42(key, prefix, length);
+    }
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefix + i));
+        if (static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) != 0xFFFFFFFFu) {
+            return false;
+        }
+    }
+    if (i < length) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + length - 32));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefix + length - 32));
+        return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) == 0xFFFFFFFFu;
+    }
+    return true;
+}
+
+TARGET_AVX2 static void packedMatchAVX2(const uint64_t* words, size_t n, const PackedRun* runs, size_t numRuns,
+                                        uint64_t valueMask, uint64_t delimiterMask, uint64_t* matches) {
+    __m256i vVec = _mm256_set1_epi64x(valueMask);
+    __m256i dVec = _mm256_set1_epi64x(delimiterMask);
+    size_t w = 0;
+    for (; w + 3 < n; w += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + w)), vVec);
+        __m256i m = _mm256_setzero_si256();
+        for (size_t r = 0; r < numRuns; ++r) {
+            __m256i belowHi = _mm256_add_epi64(x, _mm256_set1_epi64x(runs[r].hi));
+            __m256i belowLo = _mm256_add_epi64(x, _mm256_set1_epi64x(runs[r].lo));
+            m = _mm256_or_si256(m, _mm256_andnot_si256(belowLo, belowHi));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(matches + w), _mm256_and_si256(m, dVec));
+    }
+    packedMatchScalarFrom(words, w, n, runs, numRuns, valueMask, delimiterMask, matches);
+}
+
+// Narrow codes, 32 per step: one compare of 32 uint8 codes, or two of 16 uint16 codes.
+// The 16-bit pack works within 128-bit lanes, so a qword permute restores row order.
+template <typename Code>
+TARGET_AVX2 static inline __m256i broadcastAVX2(Code value) {
+    return sizeof(Code) == 1 ? _mm256_set1_epi8(static_cast<char>(value)) : _mm256_set1_epi16(static_cast<short>(value));
+}
+
+template <typename Code>
+TARGET_AVX2 static inline uint32_t narrowMaskAVX2(const Code* codes, __m256i first, __m256i last) {
+    if constexpr (sizeof(Code) == 1) {
+        __m256i offset = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes)), first);
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(offset, last), offset)));
+    } else {
+        __m256i a = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes)), first);
+        __m256i b = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + 16)), first);
+        __m256i inA = _mm256_cmpeq_epi16(_mm256_min_epu16(a, last), a);
+        __m256i inB = _mm256_cmpeq_epi16(_mm256_min_epu16(b, last), b);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(inA, inB), 0xD8);
+        return static_cast<uint32_t>(_mm256_movemask_epi8(packed));
+    }
+}
+
+template <typename Code>
+TARGET_AVX2 static long findNarrowAVX2(const Code* codes, size_t n, Code first, Code last) {
+    __m256i firstVec = broadcastAVX2(first), lastVec = broadcastAVX2(last);
+    size_t i = 0;
+    for (; i + 31 < n; i += 32) {
+        uint32_t mask = narrowMaskAVX2(codes + i, firstVec, lastVec);
+        if (mask != 0) {
+            return static_cast<long>(i + __builtin_ctz(mask));
+        }
+    }
+    return findNarrowScalarFrom(codes, i, n, first, last);
+}
+
+template <typename Code>
+TARGET_AVX2 static void scanNarrowAVX2(const Code* codes, size_t n, Code first, Code last, uint64_t* bitmap) {
+    __m256i firstVec = broadcastAVX2(first), lastVec = broadcastAVX2(last);
+    size_t i = 0;
+    for (; i + 31 < n; i += 32) {
+        bitmap[i / 64] |= uint64_t(narrowMaskAVX2(codes + i, firstVec, lastVec)) << (i % 64);
+    }
+    scanNarrowScalarFrom(codes, i, n, first, last, bitmap);
+}
+
+template <typename Code>
+TARGET_AVX2 static size_t countNarrowAVX2(const Code* codes, size_t n, Code first, Code last) {
+    __m256i firstVec = broadcastAVX2(first), lastVec = broadcastAVX2(last);
+    size_t count = 0, i = 0;
+    for (; i + 31 < n; i += 32) {
+        count += __builtin_popcount(narrowMaskAVX2(codes + i, firstVec, lastVec));
+    }
+    return count + countNarrowScalarFrom(codes, i, n, first, last);
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512 kernels: 16 codes / 64 bytes / 8 packed words per instruction.
+// Compares produce mask registers directly and tails use masked loads.
+// ---------------------------------------------------------------------------
+
+TARGET_AVX512 static inline __mmask16 tailMask16(size_t remaining) {
+    return static_cast<__mmask16>((1u << remaining) - 1);
+}
+
+TARGET_AVX512 static long findEqualAVX512(const int* codes, size_t n, int code) {
+    __m512i target = _mm512_set1_epi32(code);
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __mmask16 mask = _mm512_mask_cmpeq_epi32_mask(valid, _mm512_maskz_loadu_epi32(valid, codes + i), target);
+        if (mask != 0) {
+            return static_cast<long>(i + __builtin_ctz(mask));
+        }
+    }
+    return -1;
+}
+
+TARGET_AVX512 static void scanEqualAVX512(const int* codes, size_t n, int code, uint64_t* bitmap) {
+    __m512i target = _mm512_set1_epi32(code);
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __mmask16 mask = _mm512_mask_cmpeq_epi32_mask(valid, _mm512_maskz_loadu_epi32(valid, codes + i), target);
+        bitmap[i / 64] |= uint64_t(mask) << (i % 64);
+    }
+}
+
+TARGET_AVX512 static void scanRangeAVX512(const int* codes, size_t n, int lo, int hi, uint64_t* bitmap) {
+    if (lo >= hi) {
+        return;
+    }
+    __m512i loVec = _mm512_set1_epi32(lo);
+    __m512i width = _mm512_set1_epi32(static_cast<int>(static_cast<unsigned>(hi) - static_cast<unsigned>(lo)));
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __m512i offset = _mm512_sub_epi32(_mm512_maskz_loadu_epi32(valid, codes + i), loVec);
+        __mmask16 mask = _mm512_mask_cmplt_epu32_mask(valid, offset, width); // Native unsigned compare
+        bitmap[i / 64] |= uint64_t(mask) << (i % 64);
+    }
+}
+
+TARGET_AVX512 static size_t countRangeAVX512(const int* codes, size_t n, int lo, int hi) {
+    if (lo >= hi) {
+        return 0;
+    }
+    __m512i loVec = _mm512_set1_epi32(lo);
+    __m512i width = _mm512_set1_epi32(static_cast<int>(static_cast<unsigned>(hi) - static_cast<unsigned>(lo)));
+    size_t count = 0;
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __m512i offset = _mm512_sub_epi32(_mm512_maskz_loadu_epi32(valid, codes + i), loVec);
+        count += __builtin_popcount(_mm512_mask_cmplt_epu32_mask(valid, offset, width));
+    }
+    return count;
+}
+
+TARGET_AVX512 static void scanAnyOfAVX512(const int* codes, size_t n, const int* targets, size_t numTargets, uint64_t* bitmap) {
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __m512i x = _mm512_maskz_loadu_epi32(valid, codes + i);
+        __mmask16 mask = 0;
+        for (size_t t = 0; t < numTargets; ++t) {
+            mask |= _mm512_mask_cmpeq_epi32_mask(valid, x, _mm512_set1_epi32(targets[t]));
+        }
+        bitmap[i / 64] |= uint64_t(mask) << (i % 64);
+    }
+}
+
+TARGET_AVX512 static void scanMemberAVX512(const int* codes, size_t n, const uint32_t* set, int limit, uint64_t* bitmap) {
+    __m512i limitVec = _mm512_set1_epi32(limit);
+    __m512i bitMask = _mm512_set1_epi32(31);
+    __m512i one = _mm512_set1_epi32(1);
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 loaded = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __m512i x = _mm512_maskz_loadu_epi32(loaded, codes + i);
+        __mmask16 valid = _mm512_mask_cmplt_epu32_mask(loaded, x, limitVec);
+        __m512i words = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), valid, _mm512_maskz_srli_epi32(valid, x, 5), set, 4);
+        __m512i bits = _mm512_maskz_srlv_epi32(valid, words, _mm512_and_si512(x, bitMask));
+        __mmask16 mask = _mm512_mask_test_epi32_mask(valid, bits, one);
+        bitmap[i / 64] |= uint64_t(mask) << (i % 64);
+    }
+}
+
+// Compress-store the row numbers of matching lanes straight into out
+TARGET_AVX512 static size_t selectEqualAVX512(const int* codes, size_t n, int code, int* out) {
+    __m512i target = _mm512_set1_epi32(code);
+    __m512i rows = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i step = _mm512_set1_epi32(16);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __mmask16 mask = _mm512_mask_cmpeq_epi32_mask(valid, _mm512_maskz_loadu_epi32(valid, codes + i), target);
+        _mm512_mask_compressstoreu_epi32(out + count, mask, rows);
+        count += __builtin_popcount(mask);
+        rows = _mm512_add_epi32(rows, step);
+    }
+    return count;
+}
+
+TARGET_AVX512 static size_t selectRangeAVX512(const int* codes, size_t n, int lo, int hi, int* out) {
+    if (lo >= hi) {
+        return 0;
+    }
+    __m512i loVec = _mm512_set1_epi32(lo);
+    __m512i width = _mm512_set1_epi32(static_cast<int>(static_cast<unsigned>(hi) - static_cast<unsigned>(lo)));
+    __m512i rows = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i step = _mm512_set1_epi32(16);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF) : tailMask16(n - i);
+        __m512i offset = _mm512_sub_epi32(_mm512_maskz_loadu_epi32(valid, codes + i), loVec);
+        __mmask16 mask = _mm512_mask_cmplt_epu32_mask(valid, offset, width);
+        _mm512_mask_compressstoreu_epi32(out + count, mask, rows);
+        count += __builtin_popcount(mask);
+        rows = _mm512_add_epi32(rows, step);
+    }
+    return count;
+}
+
+// Masked byte loads never touch memory past length
+TARGET_AVX512 static bool prefixMatchAVX512(const char* key, const char* prefix, size_t length) {
+    for (size_t i = 0; i < length; i += 64) {
+        __mmask64 valid = length - i >= 64 ? ~__mmask64(0) : (__mmask64(1) << (length - i)) - 1;
+        __m512i a = _mm512_maskz_loadu_epi8(valid, key + i);
+        __m512i b = _mm512_maskz_loadu_epi8(valid, prefix + i);
+        if (_mm512_mask_cmpneq_epi8_mask(valid, a, b) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TARGET_AVX512 static void packedMatchAVX512(const uint64_t* words, size_t n, const PackedRun* runs, size_t numRuns,
+                                            uint64_t valueMask, uint64_t delimiterMask, uint64_t* matches) {
+    __m512i vVec = _mm512_set1_epi64(valueMask);
+    __m512i dVec = _mm512_set1_epi64(delimiterMask);
+    for (size_t w = 0; w < n; w += 8) {
+        __mmask8 valid = n - w >= 8 ? __mmask8(0xFF) : static_cast<__mmask8>((1u << (n - w)) - 1);
+        __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(valid, words + w), vVec);
+        __m512i m = _mm512_setzero_si512();
+        for (size_t r = 0; r < numRuns; ++r) {
+            __m512i belowHi = _mm512_add_epi64(x, _mm512_set1_epi64(runs[r].hi));
+            __m512i belowLo = _mm512_add_epi64(x, _mm512_set1_epi64(runs[r].lo));
+            m = _mm512_ternarylogic_epi64(m, belowLo, belowHi, 0xF2); // m | (~belowLo & belowHi)
+        }
+        _mm512_mask_storeu_epi64(matches + w, valid, _mm512_and_si512(m, dVec));
+    }
+}
+
+// Narrow codes, 64 bytes per step with AVX-512BW's native unsigned byte and word compares
+template <typename Code>
+TARGET_AVX512 static inline __m512i broadcastAVX512(Code value) {
+    return sizeof(Code) == 1 ? _mm512_set1_epi8(static_cast<char>(value)) : _mm512_set1_epi16(static_cast<short>(value));
+}
+
+template <typename Code>
+TARGET_AVX512 static inline uint64_t narrowMaskAVX512(const Code* codes, size_t remaining, __m512i first, __m512i last) {
+    if constexpr (sizeof(Code) == 1) {
+        __mmask64 valid = remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1;
+        __m512i offset = _mm512_sub_epi8(_mm512_maskz_loadu_epi8(valid, codes), first);
+        return _mm512_mask_cmple_epu8_mask(valid, offset, last);
+    } else {
+        __mmask32 valid = remaining >= 32 ? ~__mmask32(0) : static_cast<__mmask32>((1u << remaining) - 1);
+        __m512i offset = _mm512_sub_epi16(_mm512_maskz_loadu_epi16(valid, codes), first);
+        return _mm512_mask_cmple_epu16_mask(valid, offset, last);
+    }
+}
+
+template <typename Code>
+TARGET_AVX512 static long findNarrowAVX512(const Code* codes, size_t n, Code first, Code last) {
+    __m512i firstVec = broadcastAVX512(first), lastVec = broadcastAVX512(last);
+    for (size_t i = 0; i < n; i += 64 / sizeof(Code)) {
+        uint64_t mask = narrowMaskAVX512(codes + i, n - i, firstVec, lastVec);
+        if (mask != 0) {
+            return static_cast<long>(i + __builtin_ctzll(mask));
+        }
+    }
+    return -1;
+}
+
+template <typename Code>
+TARGET_AVX512 static void scanNarrowAVX512(const Code* codes, size_t n, Code first, Code last, uint64_t* bitmap) {
+    __m512i firstVec = broadcastAVX512(first), lastVec = broadcastAVX512(last);
+    for (size_t i = 0; i < n; i += 64 / sizeof(Code)) {
+        bitmap[i / 64] |= narrowMaskAVX512(codes + i, n - i, firstVec, lastVec) << (i % 64);
+    }
+}
+
+template <typename Code>
+TARGET_AVX512 static size_t countNarrowAVX512(const Code* codes, size_t n, Code first, Code last) {
+    __m512i firstVec = broadcastAVX512(first), lastVec = broadcastAVX512(last);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i += 64 / sizeof(Code)) {
+        count += __builtin_popcountll(narrowMaskAVX512(codes + i, n - i, firstVec, lastVec));
+    }
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+// Narrow entry points: clip the int predicate to Code once, then run an ISA's core loop
+template <typename Code, long (*Find)(const Code*, size_t, Code, Code)>
+static long findEqualNarrow(const Code* codes, size_t n, int code) {
+    Code first, last;
+    return narrowRange(code, long(code) + 1, first, last) ? Find(codes, n, first, last) : -1;
+}
+
+template <typename Code, void (*Scan)(const Code*, size_t, Code, Code, uint64_t*)>
+static void scanEqualNarrow(const Code* codes, size_t n, int code, uint64_t* bitmap) {
+    Code first, last;
+    if (narrowRange(code, long(code) + 1, first, last)) {
+        Scan(codes, n, first, last, bitmap);
+    }
+}
+
+template <typename Code, void (*Scan)(const Code*, size_t, Code, Code, uint64_t*)>
+static void scanRangeNarrow(const Code* codes, size_t n, int lo, int hi, uint64_t* bitmap) {
+    Code first, last;
+    if (narrowRange(lo, hi, first, last)) {
+        Scan(codes, n, first, last, bitmap);
+    }
+}
+
+template <typename Code, size_t (*Count)(const Code*, size_t, Code, Code)>
+static size_t countRangeNarrow(const Code* codes, size_t n, int lo, int hi) {
+    Code first, last;
+    return narrowRange(lo, hi, first, last) ? Count(codes, n, first, last) : 0;
+}
+
+template <typename Code, long (*Find)(const Code*, size_t, Code, Code), void (*Scan)(const Code*, size_t, Code, Code, uint64_t*),
+          size_t (*Count)(const Code*, size_t, Code, Code)>
+static constexpr CodeKernels<Code> narrowKernels() {
+    return {findEqualNarrow<Code, Find>, scanEqualNarrow<Code, Scan>, scanRangeNarrow<Code, Scan>, countRangeNarrow<Code, Count>};
+}
+
+static const ScanKernels kScalarKernels = {
+    Isa::Scalar, "Scalar", findEqualScalar, scanEqualScalar, scanRangeScalar, scanAnyOfScalar, scanMemberScalar,
+    countRangeScalar, selectEqualScalar, selectRangeScalar, prefixMatchScalar, packedMatchScalar, hashKeysScalar,
+    narrowKernels<uint8_t, findNarrowScalar<uint8_t>, scanNarrowScalar<uint8_t>, countNarrowScalar<uint8_t>>(),
+    narrowKernels<uint16_t, findNarrowScalar<uint16_t>, scanNarrowScalar<uint16_t>, countNarrowScalar<uint16_t>>()};
+
+// SSE4.2 has no gather, so set membership stays scalar
+static const ScanKernels kSSE42Kernels = {
+    Isa::SSE42, "SSE4.2", findEqualSSE42, scanEqualSSE42, scanRangeSSE42, scanAnyOfSSE42, scanMemberScalar,
+    countRangeSSE42, selectEqualSSE42, selectRangeSSE42, prefixMatchSSE42, packedMatchSSE42, hashKeysSSE42,
+    narrowKernels<uint8_t, findNarrowSSE42<uint8_t>, scanNarrowSSE42<uint8_t>, countNarrowSSE42<uint8_t>>(),
+    narrowKernels<uint16_t, findNarrowSSE42<uint16_t>, scanNarrowSSE42<uint16_t>, countNarrowSSE42<uint16_t>>()};
+
+static const ScanKernels kAVX2Kernels = {
+    Isa::AVX2, "AVX2", findEqualAVX2, scanEqualAVX2, scanRangeAVX2, scanAnyOfAVX2, scanMemberAVX2,
+    countRangeAVX2, selectEqualAVX2, selectRangeAVX2, prefixMatchAVX2, packedMatchAVX2, hashKeysSSE42,
+    narrowKernels<uint8_t, findNarrowAVX2<uint8_t>, scanNarrowAVX2<uint8_t>, countNarrowAVX2<uint8_t>>(),
+    narrowKernels<uint16_t, findNarrowAVX2<uint16_t>, scanNarrowAVX2<uint16_t>, countNarrowAVX2<uint16_t>>()};
+
+static const ScanKernels kAVX512Kernels = {
+    Isa::AVX512, "AVX-512", findEqualAVX512, scanEqualAVX512, scanRangeAVX512, scanAnyOfAVX512, scanMemberAVX512,
+    countRangeAVX512, selectEqualAVX512, selectRangeAVX512, prefixMatchAVX512, packedMatchAVX512, hashKeysSSE42,
+    narrowKernels<uint8_t, findNarrowAVX512<uint8_t>, scanNarrowAVX512<uint8_t>, countNarrowAVX512<uint8_t>>(),
+    narrowKernels<uint16_t, findNarrowAVX512<uint16_t>, scanNarrowAVX512<uint16_t>, countNarrowAVX512<uint16_t>>()};
+
+const ScanKernels* scanKernelsFor(Isa isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case Isa::Scalar:
+            return &kScalarKernels;
+        case Isa::SSE42:
+            return __builtin_cpu_supports("sse4.2") ? &kSSE42Kernels : nullptr;
+        case Isa::AVX2:
+            return __builtin_cpu_supports("avx2") ? &kAVX2Kernels : nullptr;
+        case Isa::AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") ? &kAVX512Kernels : nullptr;
+    }
+    return nullptr;
+}
+
+std::vector<Isa> supportedIsas() {
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512}) {
+        if (scanKernelsFor(isa) != nullptr) {
+            isas.push_back(isa);
+        }
+    }
+    return isas;
+}
+
+const ScanKernels& scanKernels() {
+    // Detected once on first use; static initialization is thread-safe
+    static const ScanKernels* best = scanKernelsFor(supportedIsas().back());
+    return *best;
+}
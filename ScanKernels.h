@@ -0,0 +1,65 @@
+#ifndef SCAN_KERNELS_H
+#define SCAN_KERNELS_H
+
+#include <vector>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Instruction sets with a kernel implementation, in ascending preference
+enum class Isa { Scalar, SSE42, AVX2, AVX512 };
+
+// Replicated [lo, hi) bounds for one range predicate on a PackedColumn word
+struct PackedRun {
+    uint64_t lo;
+    uint64_t hi;
+};
+
+// Equality and range kernels over codes stored narrower than int (uint8_t or uint16_t).
+// Targets are ints and may lie outside the range of Code, which simply matches nothing.
+template <typename Code>
+struct CodeKernels {
+    long (*findEqual)(const Code* codes, size_t n, int code);
+    void (*scanEqual)(const Code* codes, size_t n, int code, uint64_t* bitmap);
+    void (*scanRange)(const Code* codes, size_t n, int lo, int hi, uint64_t* bitmap);
+    size_t (*countRange)(const Code* codes, size_t n, int lo, int hi);
+};
+
+// Column scan kernels for one instruction set.
+// Bitmap outputs are ORed into caller-zeroed words: bit (i % 64) of bitmap[i / 64] is row i.
+// Index outputs are written to out (room for n entries) and the count is returned.
+struct ScanKernels {
+    Isa isa;
+    const char* name;
+
+    long (*findEqual)(const int* codes, size_t n, int code);                          // First row == code, or -1
+    void (*scanEqual)(const int* codes, size_t n, int code, uint64_t* bitmap);        // code == target
+    void (*scanRange)(const int* codes, size_t n, int lo, int hi, uint64_t* bitmap);  // lo <= code < hi
+    void (*scanAnyOf)(const int* codes, size_t n, const int* targets, size_t numTargets, uint64_t* bitmap);
+    // 0 <= code < limit and bit code of set is on: one gathered bitset probe per row, whatever the set size
+    void (*scanMember)(const int* codes, size_t n, const uint32_t* set, int limit, uint64_t* bitmap);
+    size_t (*countRange)(const int* codes, size_t n, int lo, int hi);                 // Rows with lo <= code < hi
+    size_t (*selectEqual)(const int* codes, size_t n, int code, int* out);
+    size_t (*selectRange)(const int* codes, size_t n, int lo, int hi, int* out);
+    bool (*prefixMatch)(const char* key, const char* prefix, size_t length);          // First length bytes equal
+    // Delimiter bits of fields matching any run, one output word per input word
+    void (*packedMatch)(const uint64_t* words, size_t n, const PackedRun* runs, size_t numRuns,
+                        uint64_t valueMask, uint64_t delimiterMask, uint64_t* matches);
+    // Hashes of n keys for hash tables that never leave this process: CRC32C where the CPU
+    // has it, else the persistent word hash of KeyHash.h. They differ between instruction sets.
+    void (*hashKeys)(const std::string_view* keys, size_t n, uint64_t* hashes);
+
+    CodeKernels<uint8_t> codes8;   // 32 codes per AVX2 compare
+    CodeKernels<uint16_t> codes16; // 16 codes per AVX2 compare
+
+    // Kernels for codes stored as Code, as visited by SegmentedColumn::forEachStoredSegment
+    CodeKernels<uint8_t> forCodes(const uint8_t*) const { return codes8; }
+    CodeKernels<uint16_t> forCodes(const uint16_t*) const { return codes16; }
+    CodeKernels<int> forCodes(const int*) const { return {findEqual, scanEqual, scanRange, countRange}; }
+};
+
+const ScanKernels& scanKernels();           // Best kernels for this CPU, detected once
+const ScanKernels* scanKernelsFor(Isa isa); // nullptr when the CPU lacks isa
+std::vector<Isa> supportedIsas();
+
+#endif
@@ -0,0 +1,190 @@
+#include "SegmentedColumn.h"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+SegmentedColumn::SegmentedColumn(unsigned codeBytes)
+    : directory(std::make_unique<std::atomic<Segment*>[]>(kMaxSegments)), bytesPerCode(codeBytes) {
+    if (codeBytes != 1 && codeBytes != 2 && codeBytes != 4) {
+        throw std::invalid_argument("SegmentedColumn: codes must be 1, 2 or 4 bytes wide");
+    }
+}
+
+SegmentedColumn::~SegmentedColumn() {
+    clear();
+}
+
+// Segment pointers are stored before the row count that covers them is published
+void SegmentedColumn::allocateThrough(size_t numRows) {
+    size_t needed = (numRows + kSegmentRows - 1) >> kSegmentShift;
+    if (needed > kMaxSegments) {
+        throw std::length_error("SegmentedColumn: row count exceeds int row indices");
+    }
+    for (; allocatedSegments < needed; ++allocatedSegments) {
+        auto* segment = new Segment{.owned = std::make_unique_for_overwrite<unsigned char[]>(kSegmentRows * bytesPerCode), .codes = nullptr};
+        segment->codes = segment->owned.get();
+        directory[allocatedSegments].store(segment, std::memory_order_release);
+    }
+}
+
+// Narrow columns truncate each code to the stored width; callers check fits() first
+void SegmentedColumn::append(const int* codes, size_t n) {
+    size_t begin = rows.load(std::memory_order_relaxed);
+    allocateThrough(begin + n);
+    while (n > 0) {
+        size_t offset = begin & (kSegmentRows - 1);
+        size_t count = std::min(kSegmentRows - offset, n);
+        unsigned char* out = directory[begin >> kSegmentShift].load(std::memory_order_relaxed)->codes;
+        switch (bytesPerCode) {
+            case 1:
+                std::copy(codes, codes + count, out + offset);
+                break;
+            case 2:
+                std::copy(codes, codes + count, reinterpret_cast<uint16_t*>(out) + offset);
+                break;
+            default:
+                std::memcpy(reinterpret_cast<int*>(out) + offset, codes, count * sizeof(int));
+        }
+        widenZones(codes, count, begin);
+        codes += count;
+        begin += count;
+        n -= count;
+    }
+    rows.store(begin, std::memory_order_release); // Publish: readers now see the new rows
+}
+
+void SegmentedColumn::widenZones(const int* codes, size_t n, size_t firstRow) {
+    while (n > 0) {
+        size_t count = std::min(kZoneRows - (firstRow & (kZoneRows - 1)), n);
+        int lo = INT_MAX, hi = INT_MIN;
+        uint64_t mask = 0;
+        for (size_t i = 0; i < count; ++i) {
+            lo = std::min(lo, codes[i]);
+            hi = std::max(hi, codes[i]);
+            mask |= zoneBit(codes[i]);
+        }
+        ZoneCell& cell = zoneCell(firstRow);
+        cell.min.store(std::min(lo, cell.min.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        cell.max.store(std::max(hi, cell.max.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        cell.codes.store(mask | cell.codes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        codes += count;
+        firstRow += count;
+        n -= count;
+    }
+}
+
+void SegmentedColumn::markUnknown(size_t begin, size_t end) {
+    for (size_t row = begin; row < end; row = (row | (kZoneRows - 1)) + 1) {
+        ZoneCell& cell = zoneCell(row);
+        cell.min.store(INT_MIN, std::memory_order_relaxed);
+        cell.max.store(INT_MAX, std::memory_order_relaxed);
+        cell.codes.store(~uint64_t(0), std::memory_order_relaxed);
+    }
+}
+
+void SegmentedColumn::resize(size_t n) {
+    size_t begin = rows.load(std::memory_order_relaxed);
+    allocateThrough(n);
+    markUnknown(begin, n);
+    rows.store(n, std::memory_order_release);
+}
+
+// Summaries are replaced, not widened: only for columns no reader can see yet
+void SegmentedColumn::summarize() {
+    size_t n = rows.load(std::memory_order_relaxed);
+    for (size_t row = 0; row < n; row += kZoneRows) {
+        ZoneCell& cell = zoneCell(row);
+        cell.min.store(INT_MAX, std::memory_order_relaxed);
+        cell.max.store(INT_MIN, std::memory_order_relaxed);
+        cell.codes.store(0, std::memory_order_relaxed);
+    }
+    forEachSegment(0, n, [&](const int* codes, size_t count, size_t firstRow) {
+        widenZones(codes, count, firstRow);
+    });
+}
+
+// Only for columns no reader can see yet: segments change representation in place.
+// Attached segments are left alone, as they are not ours to free.
+size_t SegmentedColumn::compactRuns() {
+    size_t fullSegments = rows.load(std::memory_order_relaxed) >> kSegmentShift;
+    size_t maxRuns = kSegmentRows * bytesPerCode / (sizeof(Run) * kMinRunGain);
+    size_t compacted = 0;
+    std::vector<Run> runs;
+    for (size_t i = 0; i < fullSegments; ++i) {
+        Segment& s = *directory[i].load(std::memory_order_relaxed);
+        if (s.runs || !s.owned) {
+            continue;
+        }
+        runs.clear();
+        bool tooMany = false;
+        forEachSegment(i << kSegmentShift, (i + 1) << kSegmentShift, [&](const int* codes, size_t count, size_t firstRow) {
+            uint32_t offset = static_cast<uint32_t>(firstRow & (kSegmentRows - 1));
+            for (size_t j = 0; j < count && !tooMany; ++j) {
+                if (runs.empty() || runs.back().code != codes[j]) {
+                    tooMany = runs.size() == maxRuns;
+                    runs.push_back({codes[j], 0});
+                }
+                runs.back().end = offset + static_cast<uint32_t>(j) + 1;
+            }
+        });
+        if (tooMany) {
+            continue;
+        }
+        s.runs = std::make_unique<Run[]>(runs.size());
+        std::copy(runs.begin(), runs.end(), s.runs.get());
+        s.numRuns = static_cast<uint32_t>(runs.size());
+        s.owned.reset();
+        s.codes = nullptr;
+        runBytes += runs.size() * sizeof(Run);
+        ++runSegments;
+        ++compacted;
+    }
+    return compacted;
+}
+
+// Full segments point straight into codes; a partial last segment is copied so that
+// append() never writes to the external memory, which may be a read-only mapping
+void SegmentedColumn::attach(const int* codes, size_t n, std::shared_ptr<const void> owner) {
+    if (bytesPerCode != 4) {
+        throw std::invalid_argument("SegmentedColumn: attached codes are 4 bytes wide");
+    }
+    size_t fullSegments = n >> kSegmentShift;
+    if (fullSegments + 1 > kMaxSegments) {
+        throw std::length_error("SegmentedColumn: row count exceeds int row indices");
+    }
+    backing = std::move(owner);
+    for (; allocatedSegments < fullSegments; ++allocatedSegments) {
+        auto* external = reinterpret_cast<unsigned char*>(const_cast<int*>(codes + (allocatedSegments << kSegmentShift))); // Never written: rows are sealed
+        directory[allocatedSegments].store(new Segment{.owned = nullptr, .codes = external}, std::memory_order_release);
+    }
+    markUnknown(0, fullSegments << kSegmentShift); // Summarizing would read every page of the mapping
+    rows.store(fullSegments << kSegmentShift, std::memory_order_release);
+    size_t tail = n - (fullSegments << kSegmentShift);
+    if (tail > 0) {
+        append(codes + (fullSegments << kSegmentShift), tail);
+    }
+}
+
+// Run-length encoded segments are encoded again in the copy
+std::shared_ptr<SegmentedColumn> SegmentedColumn::withCodeBytes(unsigned codeBytes, size_t numRows) const {
+    auto copy = std::make_shared<SegmentedColumn>(codeBytes);
+    forEachSegment(0, numRows, [&](const int* codes, size_t count, size_t) {
+        copy->append(codes, count);
+    });
+    if (runSegments > 0) {
+        copy->compactRuns();
+    }
+    return copy;
+}
+
+// Not safe while readers are scanning
+void SegmentedColumn::clear() {
+    rows.store(0, std::memory_order_release);
+    for (size_t i = 0; i < allocatedSegments; ++i) {
+        delete directory[i].exchange(nullptr, std::memory_order_relaxed);
+    }
+    allocatedSegments = 0;
+    runSegments = 0;
+    runBytes = 0;
+    backing.reset();
+}
@@ -0,0 +1,273 @@
+#ifndef SEGMENTED_COLUMN_H
+#define SEGMENTED_COLUMN_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <climits>
+
+// Encoded column stored as fixed-size segments that are never moved once allocated.
+// One writer appends past the published row count and then publishes the new count,
+// so readers can scan rows [0, size()) concurrently without any lock.
+// Codes are stored 1, 2 or 4 bytes wide, fixed for the life of the column; a column
+// whose codes outgrow its width is replaced by a wider copy (withCodeBytes).
+// Full segments whose codes come in long runs can be stored run-length encoded instead
+// (compactRuns()); visitors expand them on the fly unless the caller takes them run by run.
+// Every kZoneRows rows carry a zone summary (min, max and a 64-bit code mask) that scans
+// consult to skip zones that cannot match. append() widens summaries as rows arrive, and
+// only ever widens them, so a reader's rows are always covered by what it loads.
+class SegmentedColumn {
+public:
+    static constexpr size_t kSegmentShift = 16;
+    static constexpr size_t kSegmentRows = size_t(1) << kSegmentShift; // 64-256 KB of codes, a multiple of 64 rows
+    static constexpr size_t kMaxSegments = size_t(1) << 15;            // 2^31 rows: row indices are int
+    static constexpr size_t kWidenRows = 2048;                         // Narrow codes handed to int visitors per call
+    static constexpr size_t kZoneShift = 12;
+    static constexpr size_t kZoneRows = size_t(1) << kZoneShift;       // Rows per zone summary; divides kSegmentRows
+    static constexpr size_t kMinRunGain = 4;                           // Runs must take at most 1/4 of a segment's plain bytes
+
+    // Bit of code in a zone's code mask
+    static uint64_t zoneBit(int code) { return uint64_t(1) << ((static_cast<uint32_t>(code) * 0x9E3779B1u) >> 26); }
+
+    // Summary of the codes in one zone. Zones filled in place and not yet summarized, and
+    // zones of attached memory, are unknown: they admit every code.
+    struct Zone {
+        int min = INT_MIN;
+        int max = INT_MAX;
+        uint64_t codes = ~uint64_t(0); // zoneBit() of every code present; false positives only
+        bool mayContain(int code) const { return code >= min && code <= max && (codes & zoneBit(code)) != 0; }
+        bool mayContainAny(int lo, int hi, uint64_t mask) const { return max >= lo && min <= hi && (codes & mask) != 0; } // Codes in [lo, hi] with mask bits
+        bool mayOverlap(int lo, int hi) const { return max >= lo && min < hi; }                                           // Any code in [lo, hi)
+        bool within(int lo, int hi) const { return min >= lo && max < hi; }                                               // Every code in [lo, hi)
+    };
+
+private:
+    // Zone fields are written by the writer alone and read by scans; stale reads only see a narrower summary of rows the reader cannot see
+    struct ZoneCell {
+        std::atomic<int> min{INT_MAX};
+        std::atomic<int> max{INT_MIN};
+        std::atomic<uint64_t> codes{0};
+    };
+
+    struct Run {
+        int code;
+        uint32_t end; // Rows [previous run's end, end) of the segment hold code
+    };
+
+    struct Segment {
+        std::unique_ptr<unsigned char[]> owned; // Null for segments that point into attached memory
+        unsigned char* codes;                   // Null for run-length encoded segments
+        std::unique_ptr<ZoneCell[]> zones = std::make_unique<ZoneCell[]>(kSegmentRows / kZoneRows);
+        std::unique_ptr<Run[]> runs{};          // Set instead of codes for run-length encoded segments
+        uint32_t numRuns = 0;
+    };
+
+    std::unique_ptr<std::atomic<Segment*>[]> directory; // Fixed-size, so readers never see it reallocate
+    size_t allocatedSegments = 0;                       // Writer-side count of non-null directory entries
+    std::atomic<size_t> rows{0};                        // Published row count
+    std::shared_ptr<const void> backing;                // Keeps attached memory alive
+    unsigned bytesPerCode;                              // 1, 2 or 4
+    size_t runSegments = 0;                             // Writer-side count of run-length encoded segments
+    size_t runBytes = 0;                                // Bytes held by their runs
+
+    void allocateThrough(size_t numRows); // Make sure segments exist for rows [0, numRows)
+    ZoneCell& zoneCell(size_t row) const {
+        return directory[row >> kSegmentShift].load(std::memory_order_relaxed)->zones[(row & (kSegmentRows - 1)) >> kZoneShift];
+    }
+    void widenZones(const int* codes, size_t n, size_t firstRow); // Merge rows [firstRow, firstRow + n) into their zones
+    void markUnknown(size_t begin, size_t end);                   // Zones of rows [begin, end) admit every code
+    const Segment& segment(size_t row) const { return *directory[row >> kSegmentShift].load(std::memory_order_relaxed); }
+
+    // Run of a run-length encoded segment holding offset
+    static const Run* findRun(const Segment& s, size_t offset) {
+        return std::upper_bound(s.runs.get(), s.runs.get() + s.numRuns, offset, [](size_t row, const Run& run) { return row < run.end; });
+    }
+    // Copy count codes of a run-length encoded segment, from offset on, to out
+    template <typename Code>
+    static void expandRuns(const Segment& s, size_t offset, size_t count, Code* out) {
+        size_t end = offset + count;
+        for (const Run* run = findRun(s, offset); offset < end; ++run) {
+            size_t last = std::min<size_t>(run->end, end);
+            std::fill(out, out + (last - offset), static_cast<Code>(run->code));
+            out += last - offset;
+            offset = last;
+        }
+    }
+
+    // One piece per plain segment; run-length encoded segments are expanded kWidenRows rows at a time
+    template <typename Code, typename Fn>
+    void forEachSegmentAs(size_t begin, size_t end, Fn& fn) const {
+        while (begin < end) {
+            const Segment& s = segment(begin);
+            size_t offset = begin & (kSegmentRows - 1);
+            size_t count = std::min(kSegmentRows - offset, end - begin);
+            if (s.runs) {
+                Code expanded[kWidenRows];
+                for (size_t last = begin + count; begin < last;) {
+                    size_t piece = std::min(kWidenRows - (begin & (kWidenRows - 1)), last - begin);
+                    expandRuns(s, begin & (kSegmentRows - 1), piece, expanded);
+                    fn(static_cast<const Code*>(expanded), piece, begin);
+                    begin += piece;
+                }
+                continue;
+            }
+            fn(reinterpret_cast<const Code*>(s.codes) + offset, count, begin);
+            begin += count;
+        }
+    }
+
+    // Narrow codes are copied to ints kWidenRows at a time; pieces stay aligned to kWidenRows
+    template <typename Code, typename Fn>
+    void forEachWidened(size_t begin, size_t end, Fn& fn) const {
+        int widened[kWidenRows];
+        while (begin < end) {
+            const Segment& s = segment(begin);
+            size_t offset = begin & (kSegmentRows - 1);
+            size_t count = std::min(kWidenRows - (begin & (kWidenRows - 1)), end - begin);
+            if (s.runs) {
+                expandRuns(s, offset, count, widened);
+            } else {
+                const Code* codes = reinterpret_cast<const Code*>(s.codes) + offset;
+                std::copy(codes, codes + count, widened);
+            }
+            fn(static_cast<const int*>(widened), count, begin);
+            begin += count;
+        }
+    }
+
+    // Rows [begin, end) by segment: runs of run-length encoded segments go to onRun(code,
+    // runBegin, runEnd), clipped to [begin, end), and the rest to plain(first, last)
+    template <typename OnRun, typename Plain>
+    void forEachRunOr(size_t begin, size_t end, OnRun& onRun, Plain&& plain) const {
+        while (begin < end) {
+            const Segment& s = segment(begin);
+            size_t base = begin & ~(kSegmentRows - 1);
+            size_t last = std::min(base + kSegmentRows, end);
+            if (!s.runs) {
+                plain(begin, last);
+                begin = last;
+                continue;
+            }
+            for (const Run* run = findRun(s, begin - base); begin < last; ++run) {
+                size_t runEnd = std::min<size_t>(base + run->end, last);
+                onRun(run->code, begin, runEnd);
+                begin = runEnd;
+            }
+        }
+    }
+
+public:
+    explicit SegmentedColumn(unsigned codeBytes = 4); // 1, 2 or 4 bytes per code
+    ~SegmentedColumn();
+    SegmentedColumn(const SegmentedColumn&) = delete;
+    SegmentedColumn& operator=(const SegmentedColumn&) = delete;
+
+    static unsigned codeBytesFor(int maxCode) { return maxCode <= UINT8_MAX ? 1 : maxCode <= UINT16_MAX ? 2 : 4; }
+
+    size_t size() const { return rows.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    unsigned codeBytes() const { return bytesPerCode; }
+    bool fits(int code) const { return bytesPerCode == 4 || (code >= 0 && code < (1 << (8 * bytesPerCode))); }
+    int operator[](size_t row) const {
+        const Segment& s = segment(row);
+        size_t offset = row & (kSegmentRows - 1);
+        if (s.runs) {
+            return findRun(s, offset)->code;
+        }
+        const unsigned char* codes = s.codes;
+        switch (bytesPerCode) {
+            case 1:
+                return codes[offset];
+            case 2:
+                return reinterpret_cast<const uint16_t*>(codes)[offset];
+            default:
+                return reinterpret_cast<const int*>(codes)[offset];
+        }
+    }
+    size_t memoryBytes() const { // Codes, runs, zone summaries and the directory, which is allocated whole (256 KB)
+        return kMaxSegments * sizeof(std::atomic<Segment*>) + allocatedSegments * (sizeof(Segment) + kSegmentRows / kZoneRows * sizeof(ZoneCell)) +
+               (allocatedSegments - runSegments) * kSegmentRows * bytesPerCode + runBytes;
+    }
+    size_t runEncodedSegments() const { return runSegments; }
+    Zone zone(size_t row) const { // Summary of the zone holding row
+        const ZoneCell& cell = zoneCell(row);
+        return {cell.min.load(std::memory_order_relaxed), cell.max.load(std::memory_order_relaxed), cell.codes.load(std::memory_order_relaxed)};
+    }
+
+    // Writer API (one writer at a time)
+    void append(const int* codes, size_t n); // Copy codes after the last row, then publish; every code must fit
+    void resize(size_t n);                   // Allocate and publish n rows with unspecified codes (for in-place fills); their zones are unknown
+    void summarize();                        // Rebuild every zone summary from the codes, after in-place fills
+    size_t compactRuns();                    // Run-length encode the full segments whose runs are long enough; returns how many
+    void attach(const int* codes, size_t n, std::shared_ptr<const void> owner); // Use external rows in place (empty 4-byte column only)
+    void clear();
+    // Copy of rows [0, numRows) stored codeBytes wide, which must fit every code
+    std::shared_ptr<SegmentedColumn> withCodeBytes(unsigned codeBytes, size_t numRows) const;
+
+    // Visit rows [begin, end) as contiguous pieces of ints: fn(codes, count, firstRow).
+    // Narrow columns are widened on the fly in pieces of at most kWidenRows rows.
+    template <typename Fn>
+    void forEachSegment(size_t begin, size_t end, Fn&& fn) const {
+        switch (bytesPerCode) {
+            case 1:
+                return forEachWidened<uint8_t>(begin, end, fn);
+            case 2:
+                return forEachWidened<uint16_t>(begin, end, fn);
+            default:
+                return forEachSegmentAs<int>(begin, end, fn);
+        }
+    }
+
+    // Visit rows [begin, end) at their stored width: fn(codes, count, firstRow) is called with
+    // codes of type const uint8_t*, const uint16_t* or const int*, one piece per segment
+    template <typename Fn>
+    void forEachStoredSegment(size_t begin, size_t end, Fn&& fn) const {
+        switch (bytesPerCode) {
+            case 1:
+                return forEachSegmentAs<uint8_t>(begin, end, fn);
+            case 2:
+                return forEachSegmentAs<uint16_t>(begin, end, fn);
+            default:
+                return forEachSegmentAs<int>(begin, end, fn);
+        }
+    }
+
+    // The same visits, except that run-length encoded segments are not expanded: each of their
+    // runs goes to onRun(code, runBegin, runEnd) instead, clipped to [begin, end), so a
+    // predicate is evaluated once per run and its matches set as row ranges
+    template <typename Fn, typename OnRun>
+    void forEachSegment(size_t begin, size_t end, Fn&& fn, OnRun&& onRun) const {
+        forEachRunOr(begin, end, onRun, [&](size_t first, size_t last) { forEachSegment(first, last, fn); });
+    }
+    template <typename Fn, typename OnRun>
+    void forEachStoredSegment(size_t begin, size_t end, Fn&& fn, OnRun&& onRun) const {
+        forEachRunOr(begin, end, onRun, [&](size_t first, size_t last) { forEachStoredSegment(first, last, fn); });
+    }
+
+    // Visit rows [begin, end) one zone at a time: fn(zone, zoneBegin, zoneEnd). The caller
+    // decides from the summary whether to skip the rows, take them all, or scan them.
+    template <typename Fn>
+    void forEachZone(size_t begin, size_t end, Fn&& fn) const {
+        while (begin < end) {
+            size_t zoneEnd = std::min((begin | (kZoneRows - 1)) + 1, end);
+            fn(zone(begin), begin, zoneEnd);
+            begin = zoneEnd;
+        }
+    }
+
+    // Writable int pieces; 4-byte columns without run-length encoded segments only
+    template <typename Fn>
+    void forEachSegmentMutable(size_t begin, size_t end, Fn&& fn) {
+        while (begin < end) {
+            size_t offset = begin & (kSegmentRows - 1);
+            size_t count = std::min(kSegmentRows - offset, end - begin);
+            int* codes = reinterpret_cast<int*>(directory[begin >> kSegmentShift].load(std::memory_order_relaxed)->codes);
+            fn(codes + offset, count, begin);
+            begin += count;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "Table.h"
+#include <iostream>
+#include <stdexcept>
+
+const DictionaryEncoder* Table::find(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == name) {
+            return columns[i].get();
+        }
+    }
+    return nullptr;
+}
+
+const DictionaryEncoder& Table::column(const std::string& name) const {
+    if (const DictionaryEncoder* encoder = find(name)) {
+        return *encoder;
+    }
+    throw std::out_of_range("Table: unknown column " + name);
+}
+
+bool Table::addColumn(const std::string& name, const std::vector<std::string>& values, int numThreads) {
+    if (find(name) != nullptr) {
+        std::cerr << "Duplicate column: " << name << "\n";
+        return false;
+    }
+    if (!columns.empty() && values.size() != rows) {
+        std::cerr << "Column " << name << " has " << values.size() << " rows, expected " << rows << "\n";
+        return false;
+    }
+    auto encoder = std::make_unique<DictionaryEncoder>(pool);
+    encoder->encode(values, numThreads);
+    names.push_back(name);
+    columns.push_back(std::move(encoder));
+    rows = values.size();
+    return true;
+}
+
+Bitmap Table::evaluate(const Predicate& predicate) const {
+    const DictionaryEncoder* encoder = find(predicate.column);
+    if (encoder == nullptr) {
+        std::cerr << "Unknown column: " << predicate.column << "\n";
+        return Bitmap(rows);
+    }
+    return encoder->query({predicate.op, predicate.value, predicate.upper});
+}
+
+// AND the per-column selections word by word; once no row is left, the rest are skipped
+Bitmap Table::filter(const std::vector<Predicate>& predicates) const {
+    Bitmap selection = ~Bitmap(rows);
+    for (const Predicate& predicate : predicates) {
+        selection &= evaluate(predicate);
+        if (!selection.any()) {
+            break;
+        }
+    }
+    return selection;
+}
+
+std::vector<std::string> Table::gather(const std::string& column, const Bitmap& selection) const {
+    const DictionaryEncoder* encoder = find(column);
+    if (encoder == nullptr) {
+        std::cerr << "Unknown column: " << column << "\n";
+        return {};
+    }
+    return encoder->decodeRows(selection);
+}
+
+std::vector<std::vector<std::string>> Table::select(const std::vector<std::string>& columnNames, const Bitmap& selection) const {
+    std::vector<std::vector<std::string>> result;
+    result.reserve(columnNames.size());
+    for (const std::string& name : columnNames) {
+        result.push_back(gather(name, selection));
+    }
+    return result;
+}
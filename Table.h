@@ -0,0 +1,49 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include "DictionaryEncoder.h"
+#include "Bitmap.h"
+
+// Named dictionary-encoded columns that share row numbers. A predicate runs on one
+// column's codes, as its DictionaryEncoder plans it, and yields a selection bitmap;
+// conjunctions AND the bitmaps, and the other columns are decoded only for the rows that
+// survive (late materialization). Predicates run one at a time, so all columns scan on one
+// pool of the table's.
+class Table {
+public:
+    using Op = PredicateOp;
+
+    struct Predicate {
+        std::string column;
+        Op op;
+        std::string value; // Equal: the value, Prefix: the prefix, Range: inclusive lower bound
+        std::string upper; // Range: exclusive upper bound
+    };
+
+private:
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<DictionaryEncoder>> columns;
+    size_t rows = 0;
+    std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(std::max(1u, std::thread::hardware_concurrency()));
+
+    const DictionaryEncoder* find(const std::string& name) const; // Column by name, or null
+
+public:
+    // Encode values as a new column; its length must match the columns already present
+    bool addColumn(const std::string& name, const std::vector<std::string>& values, int numThreads = 4);
+    const DictionaryEncoder& column(const std::string& name) const; // Throws std::out_of_range for an unknown name
+    size_t size() const { return rows; }
+    size_t numColumns() const { return columns.size(); }
+
+    Bitmap evaluate(const Predicate& predicate) const;             // Rows of one column matching predicate
+    Bitmap filter(const std::vector<Predicate>& predicates) const; // Rows matching all predicates
+    std::vector<std::string> gather(const std::string& column, const Bitmap& selection) const;
+    std::vector<std::vector<std::string>> select(const std::vector<std::string>& columnNames, const Bitmap& selection) const;
+};
+
+#endif
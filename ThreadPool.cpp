@@ -0,0 +1,74 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t numThreads) {
+    for (size_t i = 1; i < numThreads; ++i) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::runTasks() {
+    size_t index;
+    while ((index = nextTask.fetch_add(1, std::memory_order_relaxed)) < numTasks) {
+        (*task)(index);
+        completedTasks.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    std::unique_lock lock(mutex);
+    while (true) {
+        wake.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        ++activeWorkers;
+        lock.unlock();
+
+        runTasks();
+
+        lock.lock();
+        if (--activeWorkers == 0) {
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard submit(submitMutex);
+    {
+        // A worker that woke too late for the previous job may still be registered; let it leave first
+        std::unique_lock lock(mutex);
+        done.wait(lock, [&]() { return activeWorkers == 0; });
+        task = &fn;
+        numTasks = count;
+        nextTask = 0;
+        completedTasks = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    runTasks();
+
+    // Wait until every task has run and no worker still references fn
+    std::unique_lock lock(mutex);
+    done.wait(lock, [&]() {
+        return activeWorkers == 0 && completedTasks.load(std::memory_order_acquire) == numTasks;
+    });
+    task = nullptr;
+}
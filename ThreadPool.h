@@ -0,0 +1,42 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool for data-parallel loops.
+// parallelFor() hands out task indices from a shared counter; the calling
+// thread works alongside the pool, so a pool of size N uses N - 1 workers.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;                     // Guards the job fields below
+    std::mutex submitMutex;               // Serializes concurrent parallelFor() callers
+    std::condition_variable wake;         // Signals a new job or shutdown
+    std::condition_variable done;         // Signals job completion
+    const std::function<void(size_t)>* task = nullptr;
+    size_t numTasks = 0;
+    std::atomic<size_t> nextTask{0};
+    std::atomic<size_t> completedTasks{0};
+    size_t activeWorkers = 0;             // Workers currently inside the job
+    uint64_t generation = 0;              // Incremented per job
+    bool stopping = false;
+
+    void workerLoop();
+    void runTasks(); // Claim and run tasks until none are left
+
+public:
+    explicit ThreadPool(size_t numThreads);
+    ~ThreadPool();
+
+    size_t size() const { return workers.size() + 1; }
+
+    // Run fn(0) .. fn(count - 1) across the pool and return when all have finished
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+};
+
+#endif
@@ -0,0 +1,503 @@
+#include "VersionedDictionary.h"
+#include "EpochManager.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+VersionedDictionary::Table::Table(size_t capacity)
+    : mask(capacity - 1), slots(std::make_unique<std::atomic<uint64_t>[]>(capacity)) {}
+
+VersionedDictionary::CodeBits::CodeBits(size_t count) : words(count), bits(std::make_unique<std::atomic<uint64_t>[]>(count)) {}
+
+VersionedDictionary::Store::Store()
+    : table(new Table(16)) {}
+
+VersionedDictionary::Store::~Store() {
+    delete table.load(std::memory_order_relaxed);
+    delete revised.load(std::memory_order_relaxed);
+    delete reowned.load(std::memory_order_relaxed);
+    delete shadowed.load(std::memory_order_relaxed);
+    delete[] codeChunks.load(std::memory_order_relaxed);
+}
+
+VersionedDictionary::VersionedDictionary() : store(std::make_shared<Store>()) {}
+
+VersionedDictionary::VersionedDictionary(std::shared_ptr<Store> shared, uint64_t sequence, size_t keys)
+    : store(std::move(shared)), asOf(sequence), numVisible(keys) {}
+
+VersionedDictionary::VersionedDictionary(Image mapped) : VersionedDictionary() {
+    store->image = std::move(mapped);
+    store->nextCode = store->image.codeCount;
+    numVisible = store->image.numEntries;
+}
+
+VersionedDictionary::VersionedDictionary(std::shared_ptr<const FrontCodedDictionary> base) : VersionedDictionary() {
+    store->sorted = std::move(base);
+    store->nextCode = static_cast<int>(store->sorted->size());
+    numVisible = store->sorted->size();
+}
+
+const VersionedDictionary::Node* VersionedDictionary::findNode(std::string_view key, uint64_t hash) const {
+    const Table* current = store->table.load(std::memory_order_acquire);
+    uint64_t tag = hash >> kTagShift << kTagShift;
+    for (size_t pos = hash & current->mask;; pos = (pos + 1) & current->mask) {
+        uint64_t slot = current->slots[pos].load(std::memory_order_acquire);
+        if (slot == 0) {
+            return nullptr;
+        }
+        if ((slot & ~kAddressMask) == tag && sameKey(slotNode(slot)->key(), key)) {
+            return slotNode(slot);
+        }
+    }
+}
+
+int VersionedDictionary::findInImage(std::string_view key, uint64_t hash) const {
+    const Image& image = store->image;
+    if (image.slots == nullptr) {
+        return -1;
+    }
+    // open() checked every slot, entry and owner, and that some slot is empty; the probe is bounded regardless
+    for (size_t pos = hash & image.slotMask, probes = 0; probes <= image.slotMask; pos = (pos + 1) & image.slotMask, ++probes) {
+        uint32_t slot = image.slots[pos];
+        if (slot == 0) {
+            return -1;
+        }
+        const ColumnFileEntry& entry = image.entries[slot - 1];
+        if (entry.hash == hash && sameKey(std::string_view(image.heap + entry.offset, entry.length), key)) {
+            return entry.code;
+        }
+    }
+    return -1;
+}
+
+const VersionedDictionary::Revision* VersionedDictionary::visible(const Revision* revision, uint64_t sequence) {
+    while (revision != nullptr && revision->born > sequence) {
+        revision = revision->older;
+    }
+    return revision;
+}
+
+const VersionedDictionary::Revision* VersionedDictionary::revision(std::string_view key, uint64_t hash, uint64_t sequence) const {
+    const Table* current = store->revised.load(std::memory_order_acquire);
+    if (current == nullptr) {
+        return nullptr;
+    }
+    uint64_t tag = hash >> kTagShift << kTagShift;
+    for (size_t pos = hash & current->mask;; pos = (pos + 1) & current->mask) {
+        uint64_t slot = current->slots[pos].load(std::memory_order_acquire);
+        if (slot == 0) {
+            return nullptr;
+        }
+        if ((slot & ~kAddressMask) == tag && sameKey(slotRevision(slot)->node->key(), key)) {
+            return visible(slotRevision(slot), sequence);
+        }
+    }
+}
+
+const VersionedDictionary::Revision* VersionedDictionary::ownerRevision(int code, uint64_t sequence) const {
+    const Table* current = store->reowned.load(std::memory_order_acquire);
+    if (current == nullptr) {
+        return nullptr;
+    }
+    uint64_t hash = hashCode(code);
+    for (size_t pos = hash & current->mask;; pos = (pos + 1) & current->mask) {
+        uint64_t slot = current->slots[pos].load(std::memory_order_acquire);
+        if (slot == 0) {
+            return nullptr;
+        }
+        if (slotRevision(slot)->code == code) {
+            return visible(slotRevision(slot), sequence);
+        }
+    }
+}
+
+int VersionedDictionary::find(std::string_view key) const {
+    return findAsOf(key, hashKey(key), asOf);
+}
+
+// Read-only base layers only: the mapped image, then the front-coded keys
+int VersionedDictionary::findInBase(std::string_view key, uint64_t hash) const {
+    int code = findInImage(key, hash);
+    return code < 0 && store->sorted ? store->sorted->find(key) : code;
+}
+
+// Revisions first: a visible one overrides the base, erased keys included
+int VersionedDictionary::findAsOf(std::string_view key, uint64_t hash, uint64_t sequence) const {
+    if (sequence > 0) {
+        if (const Revision* latest = revision(key, hash, sequence)) {
+            return latest->node->code;
+        }
+    }
+    int code = findInBase(key, hash);
+    if (code >= 0) {
+        return code;
+    }
+    const Node* node = findNode(key, hash);
+    return node ? node->code : -1;
+}
+
+// Hash a group of keys and prefetch each one's home slot before probing any of them,
+// so the group's cache misses overlap instead of being paid one after another
+void VersionedDictionary::findMany(std::span<const std::string> keys, int* codes) const {
+    constexpr size_t kGroup = 16;
+    uint64_t hashes[kGroup];
+    const Image& image = store->image;
+    for (size_t first = 0; first < keys.size(); first += kGroup) {
+        size_t count = std::min(kGroup, keys.size() - first);
+        const Table* current = store->table.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hashKey(keys[first + i]);
+            if (image.slots != nullptr) {
+                __builtin_prefetch(image.slots + (hashes[i] & image.slotMask));
+            }
+            __builtin_prefetch(&current->slots[hashes[i] & current->mask]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            codes[first + i] = findAsOf(keys[first + i], hashes[i], asOf);
+        }
+    }
+}
+
+const VersionedDictionary::Node* VersionedDictionary::owner(int code) const {
+    const CodeChunk* chunks = store->codeChunks.load(std::memory_order_acquire);
+    if (chunks == nullptr) {
+        return nullptr;
+    }
+    const CodeChunk& chunk = chunks[static_cast<size_t>(code) >> kChunkShift];
+    return chunk ? chunk[code & (kChunkCodes - 1)] : nullptr;
+}
+
+std::optional<std::string_view> VersionedDictionary::ownerKey(int code, std::string& scratch) const {
+    return ownerKeyAsOf(code, scratch, asOf);
+}
+
+std::optional<std::string_view> VersionedDictionary::ownerKeyAsOf(int code, std::string& scratch, uint64_t sequence) const {
+    if (code < 0 || (static_cast<size_t>(code) >> kChunkShift) >= kMaxChunks) {
+        return std::nullopt; // A mapped column may hold codes no key owns
+    }
+    if (sequence > 0) {
+        if (const Revision* latest = ownerRevision(code, sequence)) {
+            return latest->node ? std::optional<std::string_view>(latest->node->key()) : std::nullopt;
+        }
+    }
+    const Store& s = *store;
+    if (s.sorted && code < static_cast<int>(s.sorted->size())) {
+        return s.sorted->key(code, scratch);
+    }
+    if (code < s.image.codeCount) {
+        int32_t entry = s.image.owners[code];
+        if (entry < 0) {
+            return std::nullopt;
+        }
+        return std::string_view(s.image.heap + s.image.entries[entry].offset, s.image.entries[entry].length);
+    }
+    const Node* node = owner(code);
+    if (node == nullptr) {
+        return std::nullopt;
+    }
+    return node->key();
+}
+
+std::string_view VersionedDictionary::key(int code, std::string& scratch) const {
+    return ownerKey(code, scratch).value_or(std::string_view());
+}
+
+// Bump-allocate the node and its key bytes; nodes are 4-byte aligned
+const VersionedDictionary::Node* VersionedDictionary::allocateNode(std::string_view key, int code) {
+    Store& s = *store;
+    size_t bytes = (sizeof(Node) + key.size() + alignof(Node) - 1) & ~(alignof(Node) - 1);
+    if (s.arena.empty() || s.arenaUsed + bytes > s.arenaCapacity) {
+        s.arenaCapacity = std::max(std::clamp(s.arenaTotal, size_t(4096), kArenaChunkBytes), bytes);
+        s.arena.push_back(std::make_unique_for_overwrite<char[]>(s.arenaCapacity));
+        s.arenaTotal += s.arenaCapacity;
+        s.arenaUsed = 0;
+    }
+    Node* node = reinterpret_cast<Node*>(s.arena.back().get() + s.arenaUsed);
+    s.arenaUsed += bytes;
+    node->code = code;
+    node->length = static_cast<uint32_t>(key.size());
+    std::memcpy(const_cast<char*>(node->data()), key.data(), key.size());
+    return node;
+}
+
+// Keep the load factor at or below 50%; a grown table is published whole and the old one retired
+void VersionedDictionary::indexNode(const Node* node, uint64_t hash) {
+    Store& s = *store;
+    Table* current = s.table.load(std::memory_order_relaxed);
+    if (2 * (s.numKeys + 1) > current->mask + 1) {
+        reserve(s.numKeys + 1);
+        current = s.table.load(std::memory_order_relaxed);
+    }
+    size_t pos = hash & current->mask;
+    while (current->slots[pos].load(std::memory_order_relaxed) != 0) {
+        pos = (pos + 1) & current->mask;
+    }
+    current->slots[pos].store(makeSlot(node, hash), std::memory_order_release); // Node bytes are visible before the slot
+    ++s.numKeys;
+}
+
+void VersionedDictionary::reserve(size_t keys) {
+    size_t capacity = store->table.load(std::memory_order_relaxed)->mask + 1;
+    while (capacity < 2 * keys) {
+        capacity <<= 1;
+    }
+    rehash(store->table, capacity, SlotKind::Node);
+}
+
+// Move index's slots into a table of capacity slots, unless it already has that many
+void VersionedDictionary::rehash(std::atomic<Table*>& index, size_t capacity, SlotKind kind) {
+    Table* current = index.load(std::memory_order_relaxed);
+    if (capacity == current->mask + 1) {
+        return;
+    }
+    auto* grown = new Table(capacity);
+    for (size_t i = 0; i <= current->mask; ++i) {
+        if (uint64_t slot = current->slots[i].load(std::memory_order_relaxed)) {
+            // Slots keep no hash; rehash the key bytes or the code
+            uint64_t hash = kind == SlotKind::Node          ? hashKey(slotNode(slot)->key())
+                            : kind == SlotKind::KeyRevision ? hashKey(slotRevision(slot)->node->key())
+                                                            : hashCode(slotRevision(slot)->code);
+            size_t pos = hash & grown->mask;
+            while (grown->slots[pos].load(std::memory_order_relaxed) != 0) {
+                pos = (pos + 1) & grown->mask;
+            }
+            grown->slots[pos].store(slot, std::memory_order_relaxed);
+        }
+    }
+    index.store(grown, std::memory_order_seq_cst);
+    EpochManager::instance().retire(current);
+}
+
+void VersionedDictionary::setOwner(int code, const Node* node) {
+    Store& s = *store;
+    size_t chunk = static_cast<size_t>(code) >> kChunkShift;
+    if (chunk >= kMaxChunks) {
+        throw std::length_error("VersionedDictionary: code out of range");
+    }
+    // Stores holding only a base layer never need the directory, which is 256 KB
+    CodeChunk* chunks = s.codeChunks.load(std::memory_order_relaxed);
+    if (chunks == nullptr) {
+        chunks = new CodeChunk[kMaxChunks]();
+        s.codeChunks.store(chunks, std::memory_order_release);
+    }
+    if (!chunks[chunk]) {
+        chunks[chunk] = std::make_unique<const Node*[]>(kChunkCodes);
+    }
+    chunks[chunk][code & (kChunkCodes - 1)] = node;
+    s.nextCode = std::max(s.nextCode, code + 1);
+}
+
+void VersionedDictionary::revise(const Node* node, uint64_t hash, uint64_t born) {
+    chain(store->revised, store->numRevised, hash, Revision{node, born, nullptr, node->code}, SlotKind::KeyRevision);
+}
+
+void VersionedDictionary::reviseOwner(int code, const Node* node, uint64_t born) {
+    chain(store->reowned, store->numReowned, hashCode(code), Revision{node, born, nullptr, code}, SlotKind::OwnerRevision);
+    store->nextCode = std::max(store->nextCode, code + 1);
+}
+
+void VersionedDictionary::shadow(int baseCode) {
+    Store& s = *store;
+    CodeBits* current = s.shadowed.load(std::memory_order_relaxed);
+    size_t word = static_cast<size_t>(baseCode) >> 6;
+    if (current == nullptr || word >= current->words) {
+        size_t words = std::max({word + 1, current ? 2 * current->words : 0, (static_cast<size_t>(s.nextCode) + 63) >> 6});
+        auto* grown = new CodeBits(words);
+        for (size_t i = 0; current != nullptr && i < current->words; ++i) {
+            grown->bits[i].store(current->bits[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        s.shadowed.store(grown, std::memory_order_seq_cst);
+        if (current != nullptr) {
+            EpochManager::instance().retire(current);
+        }
+        current = grown;
+    }
+    current->bits[word].store(current->bits[word].load(std::memory_order_relaxed) | uint64_t(1) << (baseCode & 63),
+                              std::memory_order_release);
+}
+
+// Put revision in front of the chain of its key or code in index, starting the chain if there is none
+void VersionedDictionary::chain(std::atomic<Table*>& index, size_t& count, uint64_t hash, const Revision& revision, SlotKind kind) {
+    Store& s = *store;
+    Table* current = index.load(std::memory_order_relaxed);
+    if (current == nullptr) {
+        current = new Table(16);
+        index.store(current, std::memory_order_release);
+    }
+    auto sameChain = [&](const Revision* head) {
+        return kind == SlotKind::KeyRevision ? sameKey(head->node->key(), revision.node->key()) : head->code == revision.code;
+    };
+    uint64_t tag = hash >> kTagShift << kTagShift;
+    size_t pos = hash & current->mask;
+    for (uint64_t slot; (slot = current->slots[pos].load(std::memory_order_relaxed)) != 0; pos = (pos + 1) & current->mask) {
+        if ((slot & ~kAddressMask) == tag && sameChain(slotRevision(slot))) {
+            Revision& head = s.revisions.emplace_back(revision);
+            head.older = slotRevision(slot);
+            current->slots[pos].store(makeSlot(&head, hash), std::memory_order_release); // Revision is visible before the slot
+            return;
+        }
+    }
+    if (2 * (count + 1) > current->mask + 1) {
+        rehash(index, 2 * (current->mask + 1), kind);
+        current = index.load(std::memory_order_relaxed);
+        pos = hash & current->mask;
+        while (current->slots[pos].load(std::memory_order_relaxed) != 0) {
+            pos = (pos + 1) & current->mask;
+        }
+    }
+    current->slots[pos].store(makeSlot(&s.revisions.emplace_back(revision), hash), std::memory_order_release);
+    ++count;
+}
+
+int VersionedDictionary::insert(std::string_view key) {
+    Store& s = *store;
+    uint64_t hash = hashKey(key);
+    int existing = findAsOf(key, hash, s.latest);
+    if (existing >= 0) {
+        return existing;
+    }
+    int code = s.nextCode;
+    const Node* node = allocateNode(key, code);
+    setOwner(code, node);   // Reverse entry is written before the key becomes findable
+    if (s.latest > 0 && revision(key, hash, s.latest) != nullptr) {
+        revise(node, hash, s.latest); // Erased: the revision would hide an arena entry, so the key comes back as one
+    } else {
+        indexNode(node, hash);
+    }
+    ++numVisible;
+    return code;
+}
+
+std::shared_ptr<VersionedDictionary> VersionedDictionary::put(std::string_view key, int code) {
+    Store& s = *store;
+    uint64_t hash = hashKey(key);
+    uint64_t born = s.latest + 1;
+    int old = findAsOf(key, hash, s.latest);
+    std::string scratch;
+    if (old >= 0 && old != code && ownerKeyAsOf(old, scratch, s.latest) == key) {
+        reviseOwner(old, nullptr, born); // The old code no longer decodes to key
+    }
+    if (int baseCode = findAsOf(key, hash, 0); baseCode >= 0) {
+        shadow(baseCode);
+    }
+    const Node* node = allocateNode(key, code);
+    revise(node, hash, born);
+    reviseOwner(code, node, born);
+    s.latest = born;
+    return std::shared_ptr<VersionedDictionary>(new VersionedDictionary(store, born, numVisible + (old < 0 ? 1 : 0)));
+}
+
+std::shared_ptr<VersionedDictionary> VersionedDictionary::erase(std::string_view key) {
+    Store& s = *store;
+    uint64_t hash = hashKey(key);
+    uint64_t born = s.latest + 1;
+    int old = findAsOf(key, hash, s.latest);
+    if (old < 0) {
+        return nullptr;
+    }
+    std::string scratch;
+    if (ownerKeyAsOf(old, scratch, s.latest) == key) {
+        reviseOwner(old, nullptr, born);
+    }
+    if (int baseCode = findAsOf(key, hash, 0); baseCode >= 0) {
+        shadow(baseCode);
+    }
+    revise(allocateNode(key, -1), hash, born);
+    s.latest = born;
+    return std::shared_ptr<VersionedDictionary>(new VersionedDictionary(store, born, numVisible - 1));
+}
+
+// Every write adds revisions that only a fresh store sheds; fold once the superseded ones
+// outnumber the keys, so a store holds at most about one per key and the rebuild is amortized
+bool VersionedDictionary::needsCompaction() const {
+    const Store& s = *store;
+    size_t superseded = s.revisions.size() - s.numRevised - s.numReowned;
+    return superseded > std::max(kMinSuperseded, numVisible);
+}
+
+// The same mapping over a fresh store sharing the base layers: arena keys are copied, and each
+// revised key and code keeps only its newest revision, which moves to the arena unless it
+// overrides the base. The old store lives on for the readers of older dictionaries.
+std::shared_ptr<VersionedDictionary> VersionedDictionary::compact() const {
+    const Store& s = *store;
+    std::shared_ptr<VersionedDictionary> next(new VersionedDictionary(std::make_shared<Store>(), 0, numVisible));
+    Store& fresh = *next->store;
+    fresh.image = s.image;
+    fresh.sorted = s.sorted;
+    fresh.nextCode = s.nextCode;
+    int baseCodes = s.sorted ? static_cast<int>(s.sorted->size()) : s.image.codeCount;
+    next->reserve(s.numKeys + s.numRevised);
+    const Table* revisedIndex = asOf > 0 ? s.revised.load(std::memory_order_relaxed) : nullptr;
+    const Table* reownedIndex = asOf > 0 ? s.reowned.load(std::memory_order_relaxed) : nullptr;
+
+    // Keys: unrevised arena keys, then the newest revision of every revised key
+    const Table* table = s.table.load(std::memory_order_relaxed);
+    for (size_t i = 0; i <= table->mask; ++i) {
+        if (uint64_t slot = table->slots[i].load(std::memory_order_relaxed)) {
+            const Node* node = slotNode(slot);
+            uint64_t hash = hashKey(node->key());
+            if (revisedIndex == nullptr || revision(node->key(), hash, asOf) == nullptr) {
+                next->indexNode(next->allocateNode(node->key(), node->code), hash);
+            }
+        }
+    }
+    for (size_t i = 0; revisedIndex != nullptr && i <= revisedIndex->mask; ++i) {
+        uint64_t slot = revisedIndex->slots[i].load(std::memory_order_relaxed);
+        const Revision* latest = slot ? visible(slotRevision(slot), asOf) : nullptr;
+        if (latest == nullptr) {
+            continue;
+        }
+        std::string_view key = latest->node->key();
+        uint64_t hash = hashKey(key);
+        int code = latest->node->code;
+        if (int baseCode = next->findInBase(key, hash); baseCode >= 0) {
+            if (baseCode != code) {
+                next->shadow(baseCode);
+                next->revise(next->allocateNode(key, code), hash, 1);
+            }
+        } else if (code >= 0) {
+            next->indexNode(next->allocateNode(key, code), hash);
+        }
+    }
+
+    // Owners: base codes whose owner changed stay revisions, arena codes go to the code chunks
+    std::string scratch, baseScratch;
+    for (size_t i = 0; reownedIndex != nullptr && i <= reownedIndex->mask; ++i) {
+        uint64_t slot = reownedIndex->slots[i].load(std::memory_order_relaxed);
+        const Revision* latest = slot ? visible(slotRevision(slot), asOf) : nullptr;
+        if (latest == nullptr || latest->code >= baseCodes) {
+            continue;
+        }
+        std::optional<std::string_view> baseOwner = next->ownerKeyAsOf(latest->code, baseScratch, 0);
+        if (latest->node == nullptr ? baseOwner.has_value() : baseOwner != latest->node->key()) {
+            next->reviseOwner(latest->code, latest->node ? next->allocateNode(latest->node->key(), latest->code) : nullptr, 1);
+        }
+    }
+    for (int code = baseCodes; code < s.nextCode; ++code) {
+        if (std::optional<std::string_view> key = ownerKeyAsOf(code, scratch, asOf)) {
+            const Node* node = next->findNode(*key, hashKey(*key));
+            next->setOwner(code, node && node->code == code ? node : next->allocateNode(*key, code));
+        }
+    }
+    fresh.latest = fresh.revisions.empty() ? 0 : 1;
+    next->asOf = fresh.latest;
+    return next;
+}
+
+size_t VersionedDictionary::memoryBytes() const {
+    const Store& s = *store;
+    size_t bytes = s.arenaTotal + (s.sorted ? s.sorted->memoryBytes() : 0) + (s.table.load(std::memory_order_relaxed)->mask + 1) * sizeof(uint64_t);
+    if (const CodeChunk* chunks = s.codeChunks.load(std::memory_order_relaxed)) {
+        bytes += kMaxChunks * sizeof(CodeChunk); // The directory, however few chunks it holds
+        for (size_t i = 0; i <= (static_cast<size_t>(std::max(s.nextCode - 1, 0)) >> kChunkShift); ++i) {
+            bytes += chunks[i] ? kChunkCodes * sizeof(const Node*) : 0;
+        }
+    }
+    for (const Table* index : {s.revised.load(std::memory_order_relaxed), s.reowned.load(std::memory_order_relaxed)}) {
+        bytes += index ? (index->mask + 1) * sizeof(uint64_t) : 0;
+    }
+    if (const CodeBits* shadowed = s.shadowed.load(std::memory_order_relaxed)) {
+        bytes += shadowed->words * sizeof(uint64_t);
+    }
+    return bytes + s.revisions.size() * sizeof(Revision);
+}
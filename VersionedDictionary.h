@@ -0,0 +1,214 @@
+#ifndef VERSIONED_DICTIONARY_H
+#define VERSIONED_DICTIONARY_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include "ColumnFile.h"
+#include "FrontCodedDictionary.h"
+#include "KeyHash.h"
+
+// Key <-> code dictionary that one writer extends while readers look keys up without locks.
+// Keys are interned once in an arena of chunks that never move; the open-addressing index
+// is rebuilt into a larger table on growth and the old table is retired through the
+// EpochManager, so readers must hold an EpochGuard. insert() extends the dictionary in place.
+// Remapping or removing a key (put(), erase()) returns a new dictionary sharing the same
+// store: the write is recorded as a revision that only dictionaries at or past its sequence
+// see, so each write costs the same whatever the size. Revisions stay in the store until
+// compact() folds them into a fresh one, which the writer does once the superseded revisions
+// outnumber the keys. Keys known up front can instead sit
+// in a read-only base layer (a mapped Image or a front-coded sorted list), which the arena
+// and the revisions then only extend.
+class VersionedDictionary {
+public:
+    // Read-only base layer laid out in a mapped column file (see ColumnFile.h). Codes below
+    // codeCount resolve here; keys inserted later go to the arena as usual.
+    struct Image {
+        std::shared_ptr<const void> backing; // Keeps the mapping alive
+        const ColumnFileEntry* entries = nullptr;
+        size_t numEntries = 0;
+        const int32_t* owners = nullptr;
+        int codeCount = 0;
+        const uint32_t* slots = nullptr;
+        size_t slotMask = 0;
+        const char* heap = nullptr;
+    };
+
+private:
+    // Interned key: an 8-byte header followed by the key bytes, bump-allocated in the arena
+    struct Node {
+        int code;
+        uint32_t length;
+        const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+        std::string_view key() const { return {data(), length}; }
+    };
+
+    // A put() or erase(), seen by dictionaries whose asOf is at or past born. Revisions are
+    // chained newest first per key (node holds the key and its code, -1 once erased) and
+    // per code (node is the key owning the code, or null if none does).
+    struct Revision {
+        const Node* node;
+        uint64_t born;
+        const Revision* older;
+        int code;               // Code of an owner revision
+    };
+
+    // Flat index slot: the top 16 bits of the key's hash above a 48-bit node (or revision)
+    // address, so a probe only dereferences nodes whose tag matches (0 = empty)
+    static constexpr int kTagShift = 48;
+    static constexpr uint64_t kAddressMask = (uint64_t(1) << kTagShift) - 1;
+    static uint64_t makeSlot(const void* target, uint64_t hash) {
+        return (hash >> kTagShift << kTagShift) | reinterpret_cast<uintptr_t>(target);
+    }
+    static const Node* slotNode(uint64_t slot) { return reinterpret_cast<const Node*>(slot & kAddressMask); }
+    static const Revision* slotRevision(uint64_t slot) { return reinterpret_cast<const Revision*>(slot & kAddressMask); }
+
+    struct Table {
+        size_t mask; // Capacity - 1 (capacity is a power of two)
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        explicit Table(size_t capacity);
+    };
+
+    static constexpr size_t kChunkShift = 16;                           // Codes per reverse-lookup chunk = 2^16
+    static constexpr size_t kChunkCodes = size_t(1) << kChunkShift;
+    static constexpr size_t kMaxChunks = size_t(1) << 15;               // Codes are non-negative ints
+    static constexpr size_t kArenaChunkBytes = size_t(1) << 20;         // Arena chunks double up to this size
+    static constexpr size_t kMinSuperseded = 4096;                      // Revisions kept before small stores compact
+
+    // Growable bit per code, replaced whole like a Table
+    struct CodeBits {
+        size_t words;
+        std::unique_ptr<std::atomic<uint64_t>[]> bits;
+        explicit CodeBits(size_t words);
+        bool test(int code) const {
+            size_t word = static_cast<size_t>(code) >> 6;
+            return word < words && (bits[word].load(std::memory_order_relaxed) >> (code & 63) & 1);
+        }
+    };
+
+    using CodeChunk = std::unique_ptr<const Node*[]>; // Owners of kChunkCodes consecutive codes
+
+    enum class SlotKind { Node, KeyRevision, OwnerRevision }; // What an index's slots point to
+
+    // Everything the dictionaries of one store share; only the writer changes it
+    struct Store {
+        std::atomic<Table*> table;
+        std::atomic<CodeChunk*> codeChunks{nullptr};                  // code -> owning node: kMaxChunks chunks, allocated with the first arena code; never move
+        std::vector<std::unique_ptr<char[]>> arena;                   // Node storage, written by the writer only
+        size_t arenaUsed = 0;                                         // Bytes used in arena.back()
+        size_t arenaCapacity = 0;                                     // Size of arena.back()
+        size_t arenaTotal = 0;                                        // Bytes allocated across all arena chunks
+        size_t numKeys = 0;                                           // Keys in the arena index
+        int nextCode = 0;                                             // One past the largest code
+        Image image;                                                  // Empty unless opened from a file
+        std::shared_ptr<const FrontCodedDictionary> sorted;           // Compressed base holding codes [0, sorted->size()), or null
+
+        // Written by the first put() or erase(), before any dictionary that can see a revision
+        std::atomic<Table*> revised{nullptr};                         // Key -> its newest revision
+        std::atomic<Table*> reowned{nullptr};                         // Code -> its newest owner revision
+        std::atomic<CodeBits*> shadowed{nullptr};                     // Base codes of revised keys: walks check only their keys
+        size_t numRevised = 0;                                        // Keys in revised
+        size_t numReowned = 0;                                        // Codes in reowned
+        std::deque<Revision> revisions;                               // Never move once pushed
+        uint64_t latest = 0;                                          // Sequence of the newest write
+
+        Store();
+        ~Store(); // Only called once no reader can reach the store
+    };
+
+    std::shared_ptr<Store> store;
+    uint64_t asOf = 0;    // Revisions born up to this sequence are visible
+    size_t numVisible = 0; // Keys this dictionary maps to a code
+
+    VersionedDictionary(std::shared_ptr<Store> store, uint64_t asOf, size_t numVisible);
+    const Node* findNode(std::string_view key, uint64_t hash) const;
+    const Node* owner(int code) const; // Arena node whose key owns code, or null
+    int findInImage(std::string_view key, uint64_t hash) const;
+    int findInBase(std::string_view key, uint64_t hash) const; // Code in the image or the front-coded keys, or -1
+    int findAsOf(std::string_view key, uint64_t hash, uint64_t sequence) const;
+    std::optional<std::string_view> ownerKeyAsOf(int code, std::string& scratch, uint64_t sequence) const;
+    const Revision* revision(std::string_view key, uint64_t hash, uint64_t sequence) const; // Newest visible, or null
+    const Revision* ownerRevision(int code, uint64_t sequence) const;
+    static const Revision* visible(const Revision* revision, uint64_t sequence);
+    const Node* allocateNode(std::string_view key, int code);
+    void indexNode(const Node* node, uint64_t hash); // Writer: add node to the index, growing it first if needed
+    void rehash(std::atomic<Table*>& index, size_t capacity, SlotKind kind);
+    void setOwner(int code, const Node* node);
+    void revise(const Node* node, uint64_t hash, uint64_t born);         // New newest revision of node's key
+    void reviseOwner(int code, const Node* node, uint64_t born);         // New newest owner of code
+    void shadow(int baseCode);                                           // Mark the base code of a key about to be revised
+    void chain(std::atomic<Table*>& index, size_t& count, uint64_t hash, const Revision& revision, SlotKind kind);
+    static uint64_t hashCode(int code) { return static_cast<uint64_t>(code) * 0x9e3779b97f4a7c15ull; }
+
+public:
+    VersionedDictionary();
+    explicit VersionedDictionary(Image image);                                        // Zero-copy view of a column file
+    explicit VersionedDictionary(std::shared_ptr<const FrontCodedDictionary> sorted); // Compressed base; codes are key ranks
+    VersionedDictionary(const VersionedDictionary&) = delete;
+    VersionedDictionary& operator=(const VersionedDictionary&) = delete;
+
+    // Reader API: safe concurrently with insert()
+    int find(std::string_view key) const;   // Code of key, or -1
+    void findMany(std::span<const std::string> keys, int* codes) const; // find() for each key, with overlapped cache misses
+    // Key owning code, empty if none; code must be below a published codeBound(). Keys in the
+    // compressed base are decoded into scratch, so the view lasts until scratch is reused.
+    std::string_view key(int code, std::string& scratch) const;
+    std::optional<std::string_view> ownerKey(int code, std::string& scratch) const; // Same, but tells an absent owner from an empty key
+    const FrontCodedDictionary* frontCoded() const { return store->sorted.get(); } // The base, which revisions may have overridden
+    template <typename Fn>
+    void forEach(Fn&& fn) const {           // fn(key, code) for every indexed key; the view lasts for the call
+        const Store& s = *store;
+        const Table* revised = asOf > 0 ? s.revised.load(std::memory_order_acquire) : nullptr;
+        const CodeBits* shadowed = asOf > 0 ? s.shadowed.load(std::memory_order_acquire) : nullptr;
+        // A key with a visible revision is reported from it, not from the base
+        auto base = [&](std::string_view key, int code) {
+            if (shadowed == nullptr || !shadowed->test(code) || revision(key, hashKey(key), asOf) == nullptr) {
+                fn(key, code);
+            }
+        };
+        if (s.sorted) {
+            s.sorted->forEach(base);
+        }
+        for (size_t i = 0; i < s.image.numEntries; ++i) {
+            const ColumnFileEntry& entry = s.image.entries[i];
+            base(std::string_view(s.image.heap + entry.offset, entry.length), static_cast<int>(entry.code));
+        }
+        const Table* current = s.table.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= current->mask; ++i) {
+            if (uint64_t slot = current->slots[i].load(std::memory_order_acquire)) {
+                base(slotNode(slot)->key(), slotNode(slot)->code);
+            }
+        }
+        for (size_t i = 0; revised != nullptr && i <= revised->mask; ++i) {
+            if (uint64_t slot = revised->slots[i].load(std::memory_order_acquire)) {
+                const Revision* latest = visible(slotRevision(slot), asOf);
+                if (latest != nullptr && latest->node->code >= 0) {
+                    fn(latest->node->key(), latest->node->code);
+                }
+            }
+        }
+    }
+
+    // Writer API, called on the newest dictionary of the store only
+    void reserve(size_t keys);
+    int insert(std::string_view key);            // Existing code, or the next free code for a new key
+    // Next dictionary, in which key maps to code and code decodes to key; code must be in [0, codeBound()]
+    std::shared_ptr<VersionedDictionary> put(std::string_view key, int code);
+    std::shared_ptr<VersionedDictionary> erase(std::string_view key); // Next dictionary without key, or null if absent
+    bool needsCompaction() const;                            // Superseded revisions outnumber the keys
+    std::shared_ptr<VersionedDictionary> compact() const;    // Same mapping over a fresh store without superseded revisions
+    int codeBound() const { return store->nextCode; }
+    size_t size() const { return numVisible; }
+    size_t memoryBytes() const; // Heap memory, revisions included; a mapped image is not counted
+
+    static uint64_t hashKey(std::string_view key) { return hashKeyBytes(key); } // Stable across runs, so it can be persisted
+};
+
+#endif
@@ -1,4 +1,9 @@
 #include "DictionaryEncoder.h"
+#include "ScanKernels.h"
+#include "Table.h"
+#include "Benchmark.h"
+#include "KeyGenerator.h"
+#include "ColumnFile.h"
 #include <iostream>
 #include <random>
 #include <string>
@@ -7,234 +12,1562 @@
 #include <fstream>
 #include <thread>
 #include <cassert>
+#include <filesystem>
+#include <cstdio>
+#include <numeric>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <iterator>
 
-// Generate random strings for testing
-std::vector<std::string> generateTestData(size_t count, size_t length) {
-    const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    std::mt19937 generator(std::random_device{}());
-    std::uniform_int_distribution<int> distribution(0, sizeof(charset) - 2);
+// Test encoding performance across different thread counts
+void testEncodingPerformance(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    for (int threads : context.options().threads) {
+        double time = context.measure("EncodingPerformance", threads, [&] {
+            encoder.clear();
+            encoder.encode(dataset, threads);
+        }, dataset.size()).p50;
 
-    std::vector<std::string> result(count);
-    for (auto& str : result) {
-        str.resize(length);
-        for (auto& ch : str) {
-            ch = charset[distribution(generator)];
-        }
+        std::cout << "Encoding with " << threads << " threads took " << time << " seconds.\n";
     }
-    return result;
-}
 
-// Log results to a CSV file
-void logToCSV(const std::string& filename, const std::string& testType, int threads, double time, const std::string& extra = "") {
-    std::ofstream file(filename, std::ios::app);
-    if (file.is_open()) {
-        file << testType << "," << threads << "," << time << "," << extra << "\n";
-    } else {
-        std::cerr << "Error opening file: " << filename << "\n";
+    // Every sampled row holds one key and the rest are distinct: the table sized from the
+    // sample overflows, and the pass reruns on larger ones until every key fits
+    std::vector<std::string> misleading(size_t(1) << 16);
+    for (size_t row = 0; row < misleading.size(); ++row) {
+        misleading[row] = row % 4 == 0 ? std::string("sampled") : "hidden-" + std::to_string(row);
     }
+    encoder.clear();
+    encoder.encode(misleading, 4);
+    assert(encoder.distinctKeys() == misleading.size() * 3 / 4 + 1 && encoder.decode() == misleading);
 }
 
-// Test encoding performance across different thread counts
-void testEncodingPerformance(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, const std::string& csvFile) {
-    // for (int threads : {1, 2, 4, 8}) {
-    for (int threads : {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16}) {
-        encoder.clear();
-        auto start = std::chrono::high_resolution_clock::now();
-        encoder.encode(dataset, threads);
-        auto end = std::chrono::high_resolution_clock::now();
-        double time = std::chrono::duration<double>(end - start).count();
+// Test parallel morsel scans across different thread counts
+void testParallelScanPerformance(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::string targetValue = dataset[dataset.size() / 2]; // Target for single-item search
+    const std::string prefix = "a"; // Prefix for prefix scans
+    size_t expected_len = encoder.vanillaQueryPrefix(dataset, prefix).count();
 
-        std::cout << "Encoding with " << threads << " threads took " << time << " seconds.\n";
-        logToCSV(csvFile, "EncodingPerformance", threads, time);
+    for (int threads : context.options().threads) {
+        encoder.setScanThreads(threads);
+
+        int tmp_int = 0;
+        double valueTime = context.measure("ParallelScan Value", threads, [&] { tmp_int = encoder.parallelQueryValue(targetValue); }).p50;
+        assert(tmp_int == static_cast<int>(dataset.size() / 2));
+
+        Bitmap tmp_vec;
+        double prefixTime = context.measure("ParallelScan Prefix", threads, [&] { tmp_vec = encoder.parallelQueryPrefix(prefix); }).p50;
+        assert(expected_len == tmp_vec.count());
+
+        std::vector<int> indices;
+        double indicesTime = context.measure("ParallelScan Prefix indices", threads, [&] { indices = encoder.parallelQueryPrefixIndices(prefix); }).p50;
+        assert(indices == tmp_vec.toIndices());
+
+        std::cout << "Parallel scans with " << threads << " threads took " << valueTime << " (value), "
+                  << prefixTime << " (prefix), " << indicesTime << " (prefix indices) seconds.\n";
     }
+    encoder.setScanThreads(std::thread::hardware_concurrency());
 }
 
 // Test encoding with different operational concurrency
-void testConcurrency(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, const std::string& csvFile) {
+void testConcurrency(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
     const size_t operationsPerUser = 5000; // Number of operations each user performs
+    const size_t writerBatch = 64; // Rows per append() by the background writer
     const std::string targetValue = dataset[dataset.size() / 2]; // Target for single-item search
     const std::string prefix = "a"; // Prefix for prefix scans
 
-    for (int users : {1, 2, 4, 8}) {
-        auto start = std::chrono::high_resolution_clock::now();
-
-        std::vector<std::thread> userThreads;
+    for (int users : context.options().threads) {
+        encoder.encode(dataset, 4);
 
-        for (int i = 0; i < users; ++i) {
-            userThreads.emplace_back([&, i]() {
-                for (size_t j = 0; j < operationsPerUser; ++j) {
-                    if (j % 4 == 0) {
-                        encoder.queryValueNonSIMD(targetValue); // Non-SIMD single-item search
-                    } else if (j % 4 == 1) {
-                        encoder.queryValueSIMD(targetValue); // SIMD single-item search
-                    } else if (j % 4 == 2) {
-                        encoder.queryPrefixNonSIMD(prefix); // Non-SIMD prefix scan
-                    } else {
-                        encoder.queryPrefixSIMD(prefix); // SIMD prefix scan
-                    }
+        // Each run starts a background writer that appends rows while the users query; readers never wait for it
+        double time = context.measure("OperationalConcurrencyTest", users, [&] {
+            std::atomic<bool> readersDone = false;
+            std::thread writer([&]() {
+                std::vector<std::string> batch;
+                for (size_t begin = 0; begin < dataset.size() && !readersDone; begin += writerBatch) {
+                    batch.assign(dataset.begin() + begin, dataset.begin() + std::min(dataset.size(), begin + writerBatch));
+                    encoder.append(batch);
                 }
             });
-        }
 
-        for (auto& thread : userThreads) {
-            thread.join();
-        }
+            std::vector<std::thread> userThreads;
 
-        auto end = std::chrono::high_resolution_clock::now();
-        double time = std::chrono::duration<double>(end - start).count();
+            for (int i = 0; i < users; ++i) {
+                userThreads.emplace_back([&, i]() {
+                    for (size_t j = 0; j < operationsPerUser; ++j) {
+                        if (j % 4 == 0) {
+                            assert(encoder.queryValueNonSIMD(targetValue) == static_cast<int>(dataset.size() / 2)); // Non-SIMD single-item search
+                        } else if (j % 4 == 1) {
+                            assert(encoder.queryValueSIMD(targetValue) == static_cast<int>(dataset.size() / 2)); // SIMD single-item search
+                        } else if (j % 4 == 2) {
+                            encoder.queryPrefixNonSIMD(prefix); // Non-SIMD prefix scan
+                        } else {
+                            encoder.queryPrefixSIMD(prefix); // SIMD prefix scan
+                        }
+                    }
+                });
+            }
+
+            for (auto& thread : userThreads) {
+                thread.join();
+            }
+            readersDone = true;
+            writer.join();
+        }, users * operationsPerUser).p50;
 
-        std::cout << "Operational concurrency with " << users << " users took " << time << " seconds.\n";
-        logToCSV(csvFile, "OperationalConcurrencyTest", users, time);
+        std::cout << "Operational concurrency with " << users << " users took " << time << " seconds ("
+                  << users * operationsPerUser / time << " queries/s with a concurrent writer).\n";
     }
+
+    encoder.encode(dataset, 4); // Drop the appended rows
 }
 
 // Simulate different read vs. write ratios
-void testReadWriteRatio(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, const std::string& csvFile) {
+void testReadWriteRatio(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
     const int totalOperations = 10000; // Total number of operations
     const std::string targetValue = dataset[dataset.size() / 2]; // Target for single-item search
     const std::string prefix = "a"; // Prefix for prefix scans
 
+    const int firstFreeCode = static_cast<int>(encoder.distinctKeys()); // Writes put new keys on codes no row holds
+
     for (int readPercentage : {100, 90, 80, 50, 20, 0}) {
         int readCount = (totalOperations * readPercentage) / 100;
         int writeCount = totalOperations - readCount;
 
-        auto start = std::chrono::high_resolution_clock::now();
-
-        std::thread reader([&]() {
-            for (int i = 0; i < readCount; ++i) {
-                if (i % 4 == 0) {
-                    encoder.queryValueNonSIMD(targetValue); // Non-SIMD single-item search
-                } else if (i % 4 == 1) {
-                    encoder.queryValueSIMD(targetValue); // SIMD single-item search
-                } else if (i % 4 == 2) {
-                    encoder.queryPrefixNonSIMD(prefix); // Non-SIMD prefix scan
-                } else {
-                    encoder.queryPrefixSIMD(prefix); // SIMD prefix scan
+        double time = context.measure("ReadWriteTest " + std::to_string(readPercentage) + "% reads", 1, [&] {
+            std::thread reader([&]() {
+                for (int i = 0; i < readCount; ++i) {
+                    if (i % 4 == 0) {
+                        assert(encoder.queryValueNonSIMD(targetValue) == static_cast<int>(dataset.size() / 2)); // Non-SIMD single-item search
+                    } else if (i % 4 == 1) {
+                        assert(encoder.queryValueSIMD(targetValue) == static_cast<int>(dataset.size() / 2)); // SIMD single-item search
+                    } else if (i % 4 == 2) {
+                        encoder.queryPrefixNonSIMD(prefix); // Non-SIMD prefix scan
+                    } else {
+                        encoder.queryPrefixSIMD(prefix); // SIMD prefix scan
+                    }
                 }
-            }
-        });
-
-        std::thread writer([&]() {
-            for (int i = 0; i < writeCount; ++i) {
-                encoder.encode(dataset, 1); // Simulate single-threaded writes
-            }
-        });
+            });
 
-        reader.join();
-        writer.join();
+            std::thread writer([&]() {
+                for (int i = 0; i < writeCount; ++i) {
+                    encoder.Put("write-" + std::to_string(i), firstFreeCode + i); // Simulate single-key writes
+                }
+            });
 
-        auto end = std::chrono::high_resolution_clock::now();
-        double time = std::chrono::duration<double>(end - start).count();
+            reader.join();
+            writer.join();
+        }, totalOperations).p50;
 
         std::cout << "Read:Write Ratio (" << readPercentage << "% reads) took " << time << " seconds.\n";
-        logToCSV(csvFile, "ReadWriteTest", 1, time, std::to_string(readPercentage) + "% reads");
     }
+    assert(encoder.Get("write-0") == firstFreeCode && encoder.distinctKeys() == static_cast<size_t>(firstFreeCode + totalOperations));
+    assert(!encoder.Put("negative-key", -1) && !encoder.Get("negative-key"));
+    assert(!encoder.Put("distant-key", 2000000000) && !encoder.Get("distant-key")); // Would size per-code arrays to 2e9
+    assert(!encoder.Put("max-key", INT_MAX) && !encoder.Get("max-key"));
+    assert(encoder.histogram().size() == static_cast<size_t>(firstFreeCode + totalOperations));
 }
 
 // Test different value sizes
-void testValueSizes(DictionaryEncoder& encoder, size_t numEntries, const std::string& csvFile) {
+void testValueSizes(DictionaryEncoder& encoder, size_t numEntries, BenchmarkContext& context) {
     for (size_t valueSize : {4, 8, 16, 32, 64, 128, 256}) {
-        auto dataset = generateTestData(numEntries, valueSize);
+        auto dataset = generateDistinctKeys(numEntries, valueSize, valueSize, context.options().seed);
 
-        encoder.clear();
-        auto start = std::chrono::high_resolution_clock::now();
-        encoder.encode(dataset, 4); // Use 4 threads for all value size tests
-        auto end = std::chrono::high_resolution_clock::now();
-        double time = std::chrono::duration<double>(end - start).count();
+        double time = context.measureWithSetup("ValueSizeTest " + std::to_string(valueSize) + " bytes", 4, [&] { encoder.clear(); }, [&] {
+            encoder.encode(dataset, 4); // Use 4 threads for all value size tests
+        }, dataset.size()).p50;
 
-        std::cout << "Encoding value size " << valueSize << " bytes took " << time << " seconds.\n";
-        logToCSV(csvFile, "ValueSizeTest", 4, time, std::to_string(valueSize) + " bytes");
+        double bytesPerKey = static_cast<double>(encoder.dictionaryBytes()) / encoder.distinctKeys();
+        std::cout << "Encoding value size " << valueSize << " bytes took " << time << " seconds ("
+                  << bytesPerKey << " dictionary bytes per distinct key).\n";
     }
 }
 
-void testQueryComparison(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, const std::string& csvFile) {
+void testQueryComparison(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
     const std::string targetValue = dataset[dataset.size() / 2]; // Target value for the search
     const std::string prefix = "a"; // Prefix for prefix scan tests
+    const size_t rows = dataset.size();
+    int tmp_int = 0;
+    Bitmap tmp_vec;
 
     // Test vanilla column scan
-    auto start = std::chrono::high_resolution_clock::now();
-    int tmp_int = encoder.vanillaQueryValue(dataset, targetValue);
-    auto end = std::chrono::high_resolution_clock::now();
-    double vanillaTime = std::chrono::duration<double>(end - start).count();
+    double vanillaTime = context.measure("VanillaColumnScan", 1, [&] { tmp_int = encoder.vanillaQueryValue(dataset, targetValue); }, rows).p50;
     std::cout << "Vanilla Querying \"" << targetValue << "\" took " << vanillaTime << " seconds.\n";
     assert(tmp_int == dataset.size() / 2);
-    logToCSV(csvFile, "VanillaColumnScan", 1, vanillaTime);
 
     // Test dictionary-based non-SIMD single-item search
-    start = std::chrono::high_resolution_clock::now();
-    tmp_int = encoder.queryValueNonSIMD(targetValue);
-    end = std::chrono::high_resolution_clock::now();
-    double nonSIMDTime = std::chrono::duration<double>(end - start).count();
+    double nonSIMDTime = context.measure("QuerySingleItem Non-SIMD", 1, [&] { tmp_int = encoder.queryValueNonSIMD(targetValue); }).p50;
     std::cout << "Non-SIMD Querying \"" << targetValue << "\" took " << nonSIMDTime << " seconds.\n";
     assert(tmp_int == dataset.size() / 2);
-    logToCSV(csvFile, "QuerySingleItem", 1, nonSIMDTime, "Non-SIMD");
 
     // Test dictionary-based SIMD single-item search
-    start = std::chrono::high_resolution_clock::now();
-    tmp_int = encoder.queryValueSIMD(targetValue);
-    end = std::chrono::high_resolution_clock::now();
-    double simdSingleItemTime = std::chrono::duration<double>(end - start).count();
+    double simdSingleItemTime = context.measure("QuerySingleItem SIMD", 1, [&] { tmp_int = encoder.queryValueSIMD(targetValue); }).p50;
     std::cout << "SIMD Querying \"" << targetValue << "\" took " << simdSingleItemTime << " seconds.\n";
     assert(tmp_int == dataset.size() / 2);
-    logToCSV(csvFile, "QuerySingleItem", 1, simdSingleItemTime, "SIMD");
 
     // Test vanilla prefix scan
-    start = std::chrono::high_resolution_clock::now();
-    std::vector<int> tmp_vec = encoder.vanillaQueryPrefix(dataset, prefix);
-    end = std::chrono::high_resolution_clock::now();
-    double vanillaPrefixTime = std::chrono::duration<double>(end - start).count();
+    double vanillaPrefixTime = context.measure("VanillaPrefixScan", 1, [&] { tmp_vec = encoder.vanillaQueryPrefix(dataset, prefix); }, rows).p50;
     std::cout << "Vanilla Querying prefix \"" << prefix << "\" took " << vanillaPrefixTime << " seconds.\n";
-    int expected_len = tmp_vec.size();
-    logToCSV(csvFile, "VanillaPrefixScan", 1, vanillaPrefixTime);
+    size_t expected_len = tmp_vec.count();
 
     // Test dictionary-based non-SIMD prefix scan
-    start = std::chrono::high_resolution_clock::now();
-    tmp_vec = encoder.queryPrefixNonSIMD(prefix);
-    end = std::chrono::high_resolution_clock::now();
-    double nonSIMDPrefixTime = std::chrono::duration<double>(end - start).count();
+    double nonSIMDPrefixTime = context.measure("QueryPrefixScan Non-SIMD", 1, [&] { tmp_vec = encoder.queryPrefixNonSIMD(prefix); }, rows).p50;
     std::cout << "Non-SIMD Querying prefix \"" << prefix << "\" took " << nonSIMDPrefixTime << " seconds.\n";
-    // std::cout << "\tVerify Example: " << tmp_vec[0] << std::endl;
-    assert(expected_len == tmp_vec.size());
-    logToCSV(csvFile, "QueryPrefixScan", 1, nonSIMDPrefixTime, "Non-SIMD");
+    assert(expected_len == tmp_vec.count());
 
     // Test dictionary-based SIMD prefix scan
-    start = std::chrono::high_resolution_clock::now();
-    tmp_vec = encoder.queryPrefixSIMD(prefix);
-    end = std::chrono::high_resolution_clock::now();
-    double simdPrefixTime = std::chrono::duration<double>(end - start).count();
+    double simdPrefixTime = context.measure("QueryPrefixScan SIMD", 1, [&] { tmp_vec = encoder.queryPrefixSIMD(prefix); }, rows).p50;
     std::cout << "SIMD Querying prefix \"" << prefix << "\" took " << simdPrefixTime << " seconds.\n";
-    assert(expected_len == tmp_vec.size());
-    logToCSV(csvFile, "QueryPrefixScan", 1, simdPrefixTime, "SIMD");
+    assert(expected_len == tmp_vec.count());
 }
 
-int main() {
-    DictionaryEncoder encoder;
-    const std::string csvFile = "performance_results.csv";
+// Test full and batched decoding through the reverse lookup table
+void testDecodePerformance(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const size_t batchSize = 4096; // Rows materialized per decodeInto() call
+
+    // Test full decode
+    std::vector<std::string> decoded;
+    double fullTime = context.measure("DecodePerformance Full", 1, [&] { decoded = encoder.decode(); }, dataset.size()).p50;
+    std::cout << "Decoding " << dataset.size() << " rows took " << fullTime << " seconds.\n";
+    assert(decoded == dataset);
+
+    // Test batched decode into a reused buffer
+    std::vector<std::string> batch(batchSize);
+    double batchTime = context.measure("DecodePerformance Batch " + std::to_string(batchSize), 1, [&] {
+        for (size_t begin = 0; begin < dataset.size(); begin += batchSize) {
+            size_t count = std::min(batchSize, dataset.size() - begin);
+            encoder.decodeInto(begin, std::span<std::string>(batch.data(), count));
+            assert(batch[0] == dataset[begin]);
+        }
+    }, dataset.size()).p50;
+    std::cout << "Batch decoding " << dataset.size() << " rows took " << batchTime << " seconds.\n";
+}
+
+// Test prefix and range scans on an order-preserving dictionary
+void testOrderPreservingQueries(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::string prefix = "a"; // Prefix for prefix scan tests
+    const std::string lo = "b", hi = "d"; // Range for range scan tests
+
+    encoder.clear();
+    encoder.setOrderPreserving(true);
+    encoder.encode(dataset, 4);
+
+    size_t expected_len = encoder.vanillaQueryPrefix(dataset, prefix).count();
+
+    // Test ordered non-SIMD prefix scan
+    Bitmap tmp_vec;
+    double nonSIMDPrefixTime = context.measure("QueryPrefixScan Ordered Non-SIMD", 1, [&] { tmp_vec = encoder.queryPrefixNonSIMD(prefix); }, dataset.size()).p50;
+    std::cout << "Ordered Non-SIMD Querying prefix \"" << prefix << "\" took " << nonSIMDPrefixTime << " seconds.\n";
+    assert(expected_len == tmp_vec.count());
+
+    // Test ordered SIMD prefix scan
+    double simdPrefixTime = context.measure("QueryPrefixScan Ordered SIMD", 1, [&] { tmp_vec = encoder.queryPrefixSIMD(prefix); }, dataset.size()).p50;
+    std::cout << "Ordered SIMD Querying prefix \"" << prefix << "\" took " << simdPrefixTime << " seconds.\n";
+    assert(expected_len == tmp_vec.count());
+
+    // Test ordered range scan
+    size_t expected_range = 0;
+    for (const auto& value : dataset) {
+        if (value >= lo && value < hi) {
+            ++expected_range;
+        }
+    }
+    double rangeTime = context.measure("QueryRangeScan Ordered SIMD", 1, [&] { tmp_vec = encoder.queryRange(lo, hi); }, dataset.size()).p50;
+    std::cout << "Ordered SIMD Querying range [\"" << lo << "\", \"" << hi << "\") took " << rangeTime << " seconds.\n";
+    assert(expected_range == tmp_vec.count());
+
+    // Test chaining predicates on result bitmaps ("a..." and ["b", "d") are disjoint)
+    Bitmap prefixRows = encoder.queryPrefixSIMD(prefix);
+    Bitmap either, both;
+    CompressedBitmap compressed;
+    double combineTime = context.measure("BitmapCombine", 1, [&] {
+        either = prefixRows | tmp_vec;
+        both = prefixRows & tmp_vec;
+        compressed = either.compress();
+    }, dataset.size()).p50;
+    std::cout << "Combining prefix and range bitmaps took " << combineTime << " seconds ("
+              << compressed.memoryBytes() << " bytes compressed).\n";
+    assert(either.count() == expected_len + expected_range);
+    assert(both.count() == 0);
+    assert(compressed.count() == either.count() && compressed.toBitmap() == either);
+
+    encoder.setOrderPreserving(false);
+}
+
+// Test single-item and prefix scans on the bit-packed column
+void testPackedQueries(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::string targetValue = dataset[dataset.size() / 2]; // Target value for the search
+    const std::string prefix = "a"; // Prefix for prefix scan tests
+
+    size_t expected_len = encoder.vanillaQueryPrefix(dataset, prefix).count();
+
+    for (bool ordered : {false, true}) {
+        encoder.clear();
+        encoder.setOrderPreserving(ordered);
+        encoder.setPackedStorage(true);
+        encoder.encode(dataset, 4);
+        std::string mode = ordered ? "Ordered Packed" : "Packed";
+        std::cout << mode << " column uses " << encoder.packedBytes() << " bytes ("
+                  << dataset.size() * sizeof(int) << " unpacked).\n";
+
+        // Test packed single-item search
+        int tmp_int = 0;
+        double valueTime = context.measure("QuerySingleItem " + mode, 1, [&] { tmp_int = encoder.queryValuePacked(targetValue); }).p50;
+        std::cout << mode << " Querying \"" << targetValue << "\" took " << valueTime << " seconds.\n";
+        assert(tmp_int == static_cast<int>(dataset.size() / 2));
+
+        // Test packed prefix scan
+        Bitmap tmp_vec;
+        double prefixTime = context.measure("QueryPrefixScan " + mode, 1, [&] { tmp_vec = encoder.queryPrefixPacked(prefix); }, dataset.size()).p50;
+        std::cout << mode << " Querying prefix \"" << prefix << "\" took " << prefixTime << " seconds.\n";
+        assert(expected_len == tmp_vec.count());
+    }
+
+    encoder.setPackedStorage(false);
+    encoder.setOrderPreserving(false);
+}
+
+// Test scan kernel throughput for every instruction set this CPU supports
+void testKernelThroughput(size_t numCodes, BenchmarkContext& context) {
+    const int cardinality = 100000; // Codes drawn from [0, cardinality)
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, cardinality - 1);
+    std::vector<int> codes(numCodes);
+    for (auto& code : codes) {
+        code = distribution(generator);
+    }
+    std::vector<uint64_t> bitmap((numCodes + 63) / 64);
+    std::vector<int> indices(numCodes);
+    double gigabytes = numCodes * sizeof(int) / 1e9;
+
+    // Membership set: every eighth code below cardinality / 2
+    std::vector<uint32_t> set((cardinality + 31) / 32, 0);
+    for (int code = 0; code < cardinality / 2; code += 8) {
+        set[code >> 5] |= 1u << (code & 31);
+    }
+
+    size_t expectedEqual = 0, expectedRange = 0, expectedMember = 0;
+    for (size_t isaIndex = 0; isaIndex < supportedIsas().size(); ++isaIndex) {
+        const ScanKernels& kernels = *scanKernelsFor(supportedIsas()[isaIndex]);
+        std::string name = "KernelThroughput " + std::string(kernels.name);
+        size_t bytes = numCodes * sizeof(int);
+
+        // Absent code: findEqual scans the whole column
+        long found = 0;
+        double findTime = context.measure(name + " find", 1, [&] { found = kernels.findEqual(codes.data(), codes.size(), cardinality); }, numCodes, bytes).p50;
+        assert(found == -1);
+
+        // Scans OR their matches into the bitmap, so repeating one sets the same bits
+        double equalTime = context.measure(name + " equal", 1, [&] { kernels.scanEqual(codes.data(), codes.size(), codes[0], bitmap.data()); }, numCodes, bytes).p50;
+
+        std::fill(bitmap.begin(), bitmap.end(), 0);
+        double rangeTime = context.measure(name + " range", 1, [&] {
+            kernels.scanRange(codes.data(), codes.size(), cardinality / 4, cardinality / 2, bitmap.data());
+        }, numCodes, bytes).p50;
+        size_t rangeCount = 0;
+        for (uint64_t word : bitmap) {
+            rangeCount += __builtin_popcountll(word);
+        }
+
+        size_t countedRange = 0;
+        double countTime = context.measure(name + " count", 1, [&] {
+            countedRange = kernels.countRange(codes.data(), codes.size(), cardinality / 4, cardinality / 2);
+        }, numCodes, bytes).p50;
+        assert(countedRange == rangeCount);
+
+        std::fill(bitmap.begin(), bitmap.end(), 0);
+        double memberTime = context.measure(name + " member", 1, [&] {
+            kernels.scanMember(codes.data(), codes.size(), set.data(), cardinality / 2, bitmap.data());
+        }, numCodes, bytes).p50;
+        size_t memberCount = 0;
+        for (uint64_t word : bitmap) {
+            memberCount += __builtin_popcountll(word);
+        }
+
+        size_t equalCount = 0;
+        double selectTime = context.measure(name + " select", 1, [&] {
+            equalCount = kernels.selectEqual(codes.data(), codes.size(), codes[0], indices.data());
+        }, numCodes, bytes).p50;
+
+        // Every ISA must agree with the scalar kernels
+        if (isaIndex == 0) {
+            expectedEqual = equalCount;
+            expectedRange = rangeCount;
+            expectedMember = memberCount;
+        }
+        assert(equalCount == expectedEqual && rangeCount == expectedRange && memberCount == expectedMember);
+
+        std::cout << kernels.name << " kernels: find " << gigabytes / findTime << " GB/s, equal "
+                  << gigabytes / equalTime << " GB/s, range " << gigabytes / rangeTime << " GB/s, count " << gigabytes / countTime << " GB/s, member "
+                  << gigabytes / memberTime << " GB/s, select "
+                  << gigabytes / selectTime << " GB/s.\n";
+    }
+}
+
+// Function to test incremental ingestion with append() in batches of different sizes
+void testAppendPerformance(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::string prefix = "a"; // Prefix for the post-append scan check
+
+    for (size_t batchSize : {64, 1024, 16384}) {
+        std::vector<std::string> batch;
+        double time = context.measureWithSetup("AppendPerformance Batch " + std::to_string(batchSize), 1, [&] {
+            encoder.clear();
+            encoder.setPackedStorage(true); // Packed copy is extended, and repacked when the code width grows
+        }, [&] {
+            for (size_t begin = 0; begin < dataset.size(); begin += batchSize) {
+                size_t count = std::min(batchSize, dataset.size() - begin);
+                batch.assign(dataset.begin() + begin, dataset.begin() + begin + count);
+                encoder.append(batch);
+            }
+        }, dataset.size()).p50;
+        std::cout << "Appending " << dataset.size() << " rows in batches of " << batchSize << " took " << time << " seconds.\n";
+
+        assert(encoder.decode() == dataset);
+        assert(encoder.queryValueSIMD(dataset.back()) == encoder.vanillaQueryValue(dataset, dataset.back()));
+        assert(encoder.queryValuePacked(dataset.back()) == encoder.queryValueSIMD(dataset.back()));
+        assert(encoder.parallelQueryPrefix(prefix) == encoder.vanillaQueryPrefix(dataset, prefix));
+        assert(encoder.queryPrefixPacked(prefix) == encoder.vanillaQueryPrefix(dataset, prefix));
+    }
+    encoder.setPackedStorage(false);
+}
+
+// Test text vs. binary persistence and cold start from a memory-mapped binary file
+void testPersistence(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::string targetValue = dataset[dataset.size() / 2]; // Target value for the search
+    const std::string prefix = "a"; // Prefix for prefix scan tests
+
+    encoder.clear();
+    encoder.encode(dataset, 4);
+
+    // Test text output
+    double textTime = context.measure("Persistence Write text", 1, [&] {
+        encoder.writeEncodedColumn("encoded_column.txt");
+        encoder.writeDictionary("dictionary.txt");
+    }, dataset.size()).p50;
+    size_t textBytes = std::filesystem::file_size("encoded_column.txt") + std::filesystem::file_size("dictionary.txt");
+    std::cout << "Writing text files took " << textTime << " seconds (" << textBytes << " bytes).\n";
+
+    // Test binary output
+    double binaryTime = context.measure("Persistence Write binary", 1, [&] { encoder.writeBinary("encoded_column.bin"); }, dataset.size()).p50;
+    size_t binaryBytes = std::filesystem::file_size("encoded_column.bin");
+    std::cout << "Writing binary file took " << binaryTime << " seconds (" << binaryBytes << " bytes).\n";
+
+    // Test cold start: open maps the file without parsing it
+    DictionaryEncoder loaded;
+    bool opened = false;
+    double openTime = context.measure("Persistence Open binary", 1, [&] { opened = loaded.open("encoded_column.bin"); }).p50;
+    std::cout << "Opening binary file took " << openTime << " seconds.\n";
+    assert(opened);
+
+    assert(loaded.queryValueSIMD(targetValue) == static_cast<int>(dataset.size() / 2));
+    assert(loaded.queryPrefixSIMD(prefix) == encoder.queryPrefixSIMD(prefix));
+    assert(loaded.decode() == dataset);
+
+    // The mapped version accepts new rows and updates like any other
+    loaded.append({"persisted-new-key", targetValue});
+    assert(loaded.queryValueSIMD("persisted-new-key") == static_cast<int>(dataset.size()));
+    assert(loaded.Delete(targetValue) && !loaded.Get(targetValue));
+
+    // Truncated or corrupted files are refused, and the version already open stays
+    std::string bytes;
+    {
+        std::ifstream in("encoded_column.bin", std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    ColumnFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    auto opensCorrupted = [&](const std::function<void(std::string&)>& corrupt) {
+        std::string damaged = bytes;
+        corrupt(damaged);
+        std::ofstream("corrupted_column.bin", std::ios::binary).write(damaged.data(), damaged.size());
+        return loaded.open("corrupted_column.bin");
+    };
+    assert(!opensCorrupted([](std::string& file) { file.resize(file.size() / 2); }));
+    assert(!opensCorrupted([&](std::string& file) { // Section offsets that would wrap around
+        ColumnFileHeader bad = header;
+        bad.entriesOffset = UINT64_MAX - kColumnFileAlignment + 1;
+        std::memcpy(file.data(), &bad, sizeof(bad));
+    }));
+    assert(!opensCorrupted([&](std::string& file) { // A full slot table would never end a probe
+        std::vector<uint32_t> full(header.slotCount, 1);
+        std::memcpy(file.data() + header.slotsOffset, full.data(), full.size() * sizeof(uint32_t));
+    }));
+    assert(!opensCorrupted([&](std::string& file) { // Key bytes past the heap
+        ColumnFileEntry entry;
+        std::memcpy(&entry, file.data() + header.entriesOffset, sizeof(entry));
+        entry.offset = header.heapBytes;
+        std::memcpy(file.data() + header.entriesOffset, &entry, sizeof(entry));
+    }));
+    assert(!opensCorrupted([&](std::string& file) { // Owner past the entries
+        int32_t owner = static_cast<int32_t>(header.numEntries);
+        std::memcpy(file.data() + header.ownersOffset, &owner, sizeof(owner));
+    }));
+    assert(loaded.queryValueSIMD("persisted-new-key") == static_cast<int>(dataset.size()));
+
+    std::remove("encoded_column.txt");
+    std::remove("dictionary.txt");
+    std::remove("encoded_column.bin");
+    std::remove("corrupted_column.bin");
+}
+
+// Test the front-coded dictionary against the interned one on random and prefix-heavy keys
+void testCompressedDictionary(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    // URL-like keys share long prefixes with their neighbours in sorted order
+    std::vector<std::string> urls(dataset.size());
+    for (size_t i = 0; i < urls.size(); ++i) {
+        urls[i] = "https://example.com/catalog/item/" + std::to_string(i % 50000) + "/" + dataset[i].substr(0, 2);
+    }
+
+    auto compare = [&](const std::string& name, const std::vector<std::string>& data, const std::string& prefix) {
+        const std::string& targetValue = data[data.size() / 2];
+        size_t expected_len = encoder.vanillaQueryPrefix(data, prefix).count();
+        double internedBytesPerKey = 0;
+
+        for (bool compressed : {false, true}) {
+            std::string mode = name + (compressed ? " front-coded" : " interned");
+            encoder.clear();
+            encoder.setOrderPreserving(true);
+            encoder.setCompressedDictionary(compressed);
+            encoder.encode(data, 4);
+            double bytesPerKey = static_cast<double>(encoder.dictionaryBytes()) / encoder.distinctKeys();
+
+            int row = -1;
+            double valueTime = context.measure("CompressedDictionary " + mode + " value query", 1, [&] { row = encoder.queryValueSIMD(targetValue); }).p50;
+            assert(row >= 0 && data[row] == targetValue);
+
+            Bitmap matches;
+            double prefixTime = context.measure("CompressedDictionary " + mode + " prefix query", 1, [&] { matches = encoder.queryPrefixSIMD(prefix); }, data.size()).p50;
+            assert(matches.count() == expected_len);
+
+            std::vector<std::string> decoded;
+            double decodeTime = context.measure("CompressedDictionary " + mode + " decode", 1, [&] { decoded = encoder.decode(); }, data.size()).p50;
+            assert(decoded == data);
+
+            std::cout << mode << " dictionary: " << bytesPerKey << " B/key; value query " << valueTime
+                      << " s, prefix query " << prefixTime << " s, decode " << decodeTime << " s.\n";
+            if (!compressed) {
+                internedBytesPerKey = bytesPerKey;
+            } else {
+                // Both sides count every heap byte, fixed directories included (the front-coded
+                // store has none until a key is appended)
+                std::cout << name << " front-coded dictionary: " << bytesPerKey / internedBytesPerKey << " of the interned bytes per key.\n";
+                assert(bytesPerKey < internedBytesPerKey);
+            }
+        }
+
+        // New keys land beside the compressed base, and deletes and puts are revisions over it
+        encoder.append({"compressed-new-key"});
+        assert(encoder.queryValueSIMD("compressed-new-key") == static_cast<int>(data.size()));
+        assert(encoder.queryPrefixSIMD(prefix).count() == expected_len);
+        size_t compressedBytes = encoder.dictionaryBytes();
+        size_t distinct = encoder.distinctKeys();
+        int targetCode = *encoder.Get(targetValue);
+        assert(encoder.Delete(targetValue) && !encoder.Get(targetValue));
+        encoder.Put("compressed-put-key", targetCode);
+        assert(encoder.Get("compressed-put-key") == targetCode && encoder.decode()[data.size() / 2] == "compressed-put-key");
+        assert(encoder.distinctKeys() == distinct);
+        encoder.append({targetValue}); // A deleted key comes back under a new code
+        assert(encoder.Get(targetValue) != targetCode && encoder.decode().back() == targetValue);
+        std::cout << name << " front-coded dictionary after a delete and a put: " << encoder.dictionaryBytes() << " bytes, "
+                  << compressedBytes << " before.\n";
+        assert(encoder.dictionaryBytes() < compressedBytes + (size_t(1) << 16)); // The base is neither copied nor decoded
+
+        // Rewriting one key again and again folds its superseded revisions away instead of piling them up
+        size_t rewrittenBytes = encoder.dictionaryBytes();
+        int appendedCode = *encoder.Get(targetValue);
+        size_t prefixRows = encoder.queryPrefixSIMD(prefix).count();
+        for (size_t i = 0; i < 2 * data.size(); ++i) {
+            assert(encoder.Put("compressed-put-key", targetCode));
+        }
+        assert(encoder.Get("compressed-put-key") == targetCode && encoder.decode()[data.size() / 2] == "compressed-put-key");
+        assert(encoder.Get(targetValue) == appendedCode && encoder.queryPrefixSIMD(prefix).count() == prefixRows);
+        std::cout << name << " front-coded dictionary after " << 2 * data.size() << " more puts: " << encoder.dictionaryBytes() << " bytes.\n";
+        assert(encoder.dictionaryBytes() < rewrittenBytes + 64 * data.size()); // Unfolded, each put keeps about 90 bytes
+    };
+    compare("Random", dataset, "ab");
+    compare("URL", urls, "https://example.com/catalog/item/123");
+
+    encoder.setCompressedDictionary(false);
+    encoder.setOrderPreserving(false);
+}
+
+// Test prefix, range and successor lookups through the trie prefix index on unordered codes
+void testPrefixIndex(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::string prefix = "ab"; // Prefix for prefix scan tests
+    const std::string lo = "b", hi = "d"; // Range for range scan tests
+
+    encoder.clear();
+    encoder.encode(dataset, 4);
+    Bitmap expectedPrefix = encoder.queryPrefixSIMD(prefix);
+    Bitmap expectedRange = encoder.queryRange(lo, hi);
+
+    for (bool indexed : {false, true}) {
+        std::string mode = indexed ? "Indexed" : "Unindexed";
+        double buildTime = context.measureWithSetup("PrefixIndex " + mode + " build", 1, [&] { encoder.setPrefixIndex(false); }, [&] {
+            encoder.setPrefixIndex(indexed);
+        }).p50;
+
+        Bitmap nonSIMD;
+        double nonSIMDTime = context.measure("PrefixIndex " + mode + " Non-SIMD prefix", 1, [&] { nonSIMD = encoder.queryPrefixNonSIMD(prefix); }, dataset.size()).p50;
+        assert(nonSIMD == expectedPrefix);
+
+        Bitmap simd;
+        double simdTime = context.measure("PrefixIndex " + mode + " SIMD prefix", 1, [&] { simd = encoder.queryPrefixSIMD(prefix); }, dataset.size()).p50;
+        assert(simd == expectedPrefix);
+
+        Bitmap range;
+        double rangeTime = context.measure("PrefixIndex " + mode + " range", 1, [&] { range = encoder.queryRange(lo, hi); }, dataset.size()).p50;
+        assert(range == expectedRange);
+
+        std::cout << mode << " prefix queries: build " << buildTime << " s, non-SIMD " << nonSIMDTime << " s, SIMD "
+                  << simdTime << " s, range " << rangeTime << " s.\n";
+    }
+
+    // Successors, and keys added after the index was built
+    std::string smallest = *std::min_element(dataset.begin(), dataset.end());
+    assert(encoder.nextKey("") == smallest);
+    assert(encoder.nextKey(smallest) == smallest);
+    encoder.append({prefix + "~appended"});
+    assert(encoder.queryPrefixSIMD(prefix).count() == expectedPrefix.count() + 1);
+    assert(encoder.nextKey(prefix + "~") == prefix + "~appended");
+    encoder.Put(prefix + "~put", 0); // Rows holding code 0 now match too
+    assert(encoder.nextKey(prefix + "~p") == prefix + "~put");
+    assert(encoder.queryPrefixNonSIMD(prefix) == encoder.queryPrefixSIMD(prefix));
+    assert(encoder.Delete(prefix + "~appended") && encoder.nextKey(prefix + "~a") == prefix + "~put");
+
+    // Writes to indexed keys leave the index in place; its answers are corrected, and match a walk
+    std::string deleted = *encoder.nextKey(prefix), moved = *encoder.nextKey(lo);
+    double putTime = context.measure("PrefixIndex Put", 1, [&] { encoder.Put(moved, 1); }).p50;
+    assert(encoder.Delete(deleted) && encoder.nextKey(prefix) != deleted);
+    Bitmap indexedPrefix = encoder.queryPrefixSIMD(prefix), indexedRange = encoder.queryRange(lo, hi);
+    std::optional<std::string> indexedNext = encoder.nextKey(deleted);
+    encoder.setPrefixIndex(false);
+    assert(encoder.queryPrefixSIMD(prefix) == indexedPrefix && encoder.queryRange(lo, hi) == indexedRange);
+    assert(encoder.nextKey(deleted) == indexedNext);
+    std::cout << "Put with a prefix index took " << putTime << " seconds.\n";
+}
+
+// Test batched IN-list lookups against one call per value
+void testBatchLookups(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    encoder.clear();
+    encoder.encode(dataset, 4);
+
+    // Present values with some repeats, plus values that are not in the dictionary
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<size_t> distribution(0, dataset.size() - 1);
+    for (size_t batchSize : {16, 1024, 4096}) {
+        std::vector<std::string> values(batchSize);
+        for (size_t i = 0; i < batchSize; ++i) {
+            values[i] = i % 16 == 15 ? "absent-" + std::to_string(i) : dataset[distribution(generator)];
+        }
+
+        std::string extra = std::to_string(batchSize) + " values";
+        std::vector<int> expected(batchSize);
+        double singleTime = context.measure("BatchLookup " + extra + "; one by one", 1, [&] {
+            for (size_t i = 0; i < batchSize; ++i) {
+                expected[i] = encoder.queryValueSIMD(values[i]);
+            }
+        }, batchSize).p50;
+
+        std::vector<int> first;
+        double firstTime = context.measure("BatchLookup " + extra + "; first", 1, [&] { first = encoder.queryValuesFirst(values); }, batchSize).p50;
+        assert(first == expected);
+
+        std::vector<size_t> counts;
+        double countTime = context.measure("BatchLookup " + extra + "; count", 1, [&] { counts = encoder.queryValuesCount(values); }, batchSize).p50;
+
+        std::vector<std::vector<int>> all;
+        double allTime = context.measure("BatchLookup " + extra + "; all", 1, [&] { all = encoder.queryValuesAll(values); }, batchSize).p50;
+        for (size_t i = 0; i < batchSize; i += 61) {
+            assert(all[i] == encoder.queryValueAll(values[i]) && counts[i] == all[i].size());
+        }
+
+        std::cout << "Batch of " << batchSize << " lookups: one by one " << singleTime << " s, first " << firstTime
+                  << " s, count " << countTime << " s, all " << allTime << " s.\n";
+    }
+}
+
+// Test aggregates on codes against aggregating the decoded strings
+void testAggregations(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::string prefix = "a"; // Prefix for predicate counts
+    const std::string lo = "b", hi = "d"; // Range for predicate counts
+    const size_t k = 10;
+
+    // Skewed column: a few values dominate, like most real group-by keys
+    std::mt19937 generator(11);
+    std::geometric_distribution<size_t> distribution(0.01);
+    std::vector<std::string> skewed(dataset.size());
+    for (auto& value : skewed) {
+        value = dataset[std::min(distribution(generator), dataset.size() - 1)];
+    }
+
+    for (bool ordered : {false, true}) {
+        encoder.clear();
+        encoder.setOrderPreserving(ordered);
+        encoder.encode(skewed, 4);
+        std::string mode = ordered ? "Ordered" : "Unordered";
+
+        // Baseline: decode and aggregate on strings
+        std::unordered_map<std::string, size_t> expected;
+        double stringTime = context.measure("Aggregation " + mode + " decode + string count", 1, [&] {
+            expected.clear();
+            for (const auto& value : encoder.decode()) {
+                ++expected[value];
+            }
+        }, skewed.size()).p50;
+
+        std::vector<std::pair<std::string, size_t>> top;
+        double topTime = context.measure("Aggregation " + mode + " top-" + std::to_string(k), 1, [&] { top = encoder.topK(k); }, skewed.size()).p50;
+        assert(top.size() == k);
+        for (size_t i = 0; i < k; ++i) {
+            assert(expected[top[i].first] == top[i].second && (i == 0 || top[i - 1].second >= top[i].second));
+        }
+
+        size_t distinct = 0;
+        double distinctTime = context.measure("Aggregation " + mode + " distinct", 1, [&] { distinct = encoder.distinctValues(); }, skewed.size()).p50;
+        assert(distinct == expected.size());
+
+        size_t prefixCount = 0, rangeCount = 0, valueCount = 0;
+        double countTime = context.measure("Aggregation " + mode + " predicate counts", 1, [&] {
+            prefixCount = encoder.countPrefix(prefix);
+            rangeCount = encoder.countRange(lo, hi);
+            valueCount = encoder.countValue(top[0].first);
+        }, skewed.size()).p50;
+        assert(prefixCount == encoder.vanillaQueryPrefix(skewed, prefix).count());
+        assert(rangeCount == encoder.queryRange(lo, hi).count());
+        assert(valueCount == top[0].second);
+
+        std::vector<size_t> histogram = encoder.histogram();
+        assert(std::accumulate(histogram.begin(), histogram.end(), size_t(0)) == skewed.size());
 
-    // Write CSV header
-    std::ofstream file(csvFile, std::ios::trunc);
-    if (file.is_open()) {
-        file << "TestType,Users/Threads,Time(s),Extra\n";
-        file.close();
+        std::cout << mode << " aggregates: decode + string count " << stringTime << " s, top-" << k << " " << topTime
+                  << " s, distinct " << distinctTime << " s, predicate counts " << countTime << " s.\n";
+
+        // Rows of a deleted key keep its code but no longer hold a value
+        assert(encoder.Delete(top[0].first));
+        assert(encoder.distinctValues() == expected.size() - 1);
+        assert(encoder.topK(1)[0] == top[1]);
+    }
+    encoder.setOrderPreserving(false);
+}
+
+// Test conjunctive filters across table columns with late materialization of the others
+void testTable(const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const std::vector<std::string> regions = {"us-east", "us-west", "eu-west", "eu-central", "ap-south", "ap-east", "sa-east", "af-south"};
+    std::vector<std::string> region(dataset.size()), tier(dataset.size()), note(dataset.size());
+    for (size_t i = 0; i < dataset.size(); ++i) {
+        region[i] = regions[i % regions.size()];
+        tier[i] = std::string(1, static_cast<char>('0' + i % 10));
+        note[i] = "note-" + std::to_string(i % 1000);
+    }
+
+    Table table;
+    bool added = false;
+    double loadTime = context.measureWithSetup("Table Load", 4, [&] { table = Table(); }, [&] {
+        added = table.addColumn("key", dataset) && table.addColumn("region", region) && table.addColumn("tier", tier) &&
+                table.addColumn("note", note);
+    }, dataset.size()).p50;
+    assert(added && table.numColumns() == 4 && table.size() == dataset.size());
+    assert(!table.addColumn("short", std::vector<std::string>(3, "x")));
+
+    // region = 'eu-west' AND key LIKE 'a%' AND tier in ['3', '7')
+    std::vector<Table::Predicate> predicates = {{"region", Table::Op::Equal, "eu-west", ""},
+                                                {"key", Table::Op::Prefix, "a", ""},
+                                                {"tier", Table::Op::Range, "3", "7"}};
+    Bitmap selection;
+    std::vector<std::vector<std::string>> result;
+    double lateTime = context.measure("Table Filter + late materialization", 1, [&] {
+        selection = table.filter(predicates);
+        result = table.select({"key", "note"}, selection);
+    }, dataset.size()).p50;
+
+    // Baseline: decode every column, then filter the strings row by row
+    std::vector<std::string> expectedKeys, expectedNotes;
+    double earlyTime = context.measure("Table Decode + filter", 1, [&] {
+        std::vector<std::string> keys = table.column("key").decode(), regionValues = table.column("region").decode(),
+                                 tiers = table.column("tier").decode(), notes = table.column("note").decode();
+        expectedKeys.clear();
+        expectedNotes.clear();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (regionValues[i] == "eu-west" && keys[i].compare(0, 1, "a") == 0 && tiers[i] >= "3" && tiers[i] < "7") {
+                expectedKeys.push_back(keys[i]);
+                expectedNotes.push_back(notes[i]);
+            }
+        }
+    }, dataset.size()).p50;
+    assert(result[0] == expectedKeys && result[1] == expectedNotes && selection.count() == expectedKeys.size());
+    bool unknownColumnThrows = false;
+    try {
+        table.column("missing");
+    } catch (const std::out_of_range&) {
+        unknownColumnThrows = true;
+    }
+    assert(unknownColumnThrows);
+
+    std::cout << "Table of " << table.numColumns() << " columns loaded in " << loadTime << " seconds; filter + late "
+              << "materialization " << lateTime << " s vs decode + filter " << earlyTime << " s (" << selection.count()
+              << " rows).\n";
+}
+
+// Narrow kernels of every ISA must agree with the scalar int kernels on the same codes
+template <typename Code>
+void testNarrowKernels(size_t numCodes, int cardinality, BenchmarkContext& context) {
+    std::mt19937 generator(23);
+    std::uniform_int_distribution<int> distribution(0, cardinality - 1);
+    std::vector<int> codes(numCodes);
+    std::vector<Code> narrow(numCodes);
+    for (size_t i = 0; i < numCodes; ++i) {
+        codes[i] = distribution(generator);
+        narrow[i] = static_cast<Code>(codes[i]);
+    }
+    const ScanKernels& scalar = *scanKernelsFor(Isa::Scalar);
+    std::vector<uint64_t> expected((numCodes + 63) / 64, 0), bitmap(expected.size());
+    int lo = cardinality / 4, hi = cardinality / 2;
+    scalar.scanRange(codes.data(), numCodes, lo, hi, expected.data());
+    std::string width = std::to_string(8 * sizeof(Code)) + "-bit";
+
+    for (Isa isa : supportedIsas()) {
+        const ScanKernels& kernels = *scanKernelsFor(isa);
+        CodeKernels<Code> narrowKernels = kernels.forCodes(narrow.data());
+
+        std::fill(bitmap.begin(), bitmap.end(), 0);
+        double rangeTime = context.measure("KernelThroughput " + std::string(kernels.name) + " " + width + " range", 1, [&] {
+            narrowKernels.scanRange(narrow.data(), numCodes, lo, hi, bitmap.data());
+        }, numCodes, numCodes * sizeof(Code)).p50;
+        assert(bitmap == expected);
+
+        // Targets outside the code type match nothing; ranges past it are clipped
+        assert(narrowKernels.countRange(narrow.data(), numCodes, lo, hi) == scalar.countRange(codes.data(), numCodes, lo, hi));
+        assert(narrowKernels.countRange(narrow.data(), numCodes, -5, INT32_MAX) == numCodes);
+        assert(narrowKernels.findEqual(narrow.data(), numCodes, codes[numCodes - 1]) == scalar.findEqual(codes.data(), numCodes, codes[numCodes - 1]));
+        assert(narrowKernels.findEqual(narrow.data(), numCodes, cardinality + (1 << 16)) == -1);
+        std::fill(bitmap.begin(), bitmap.end(), 0);
+        narrowKernels.scanEqual(narrow.data(), numCodes - 1, codes[0], bitmap.data());
+        size_t equalCount = 0;
+        for (uint64_t word : bitmap) {
+            equalCount += __builtin_popcountll(word);
+        }
+        assert(equalCount == static_cast<size_t>(std::count(codes.begin(), codes.end() - 1, codes[0])));
+
+        std::cout << kernels.name << " " << width << " range kernel: " << numCodes / rangeTime / 1e9 << " G codes/s.\n";
+    }
+}
+
+// Code width follows the dictionary size: the same number of rows is scanned with 1-, 2- and
+// 4-byte codes, and appending past 256 keys widens a 1-byte column without a re-encode
+void testAdaptiveCodeWidth(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    testNarrowKernels<uint8_t>(size_t(1) << 22, 200, context);
+    testNarrowKernels<uint16_t>(size_t(1) << 22, 20000, context);
+
+    const size_t numRows = size_t(1) << 21;
+    std::mt19937 generator(17);
+    encoder.setOrderPreserving(true);
+    for (size_t cardinality : {size_t(200), size_t(20000), dataset.size()}) {
+        std::uniform_int_distribution<size_t> distribution(0, cardinality - 1);
+        std::vector<std::string> column(numRows);
+        for (auto& value : column) {
+            value = dataset[distribution(generator)];
+        }
+        encoder.clear();
+        encoder.encode(column, 4);
+        unsigned codeBytes = encoder.codeBytes();
+        assert(codeBytes == SegmentedColumn::codeBytesFor(static_cast<int>(encoder.distinctKeys()) - 1));
+        std::string mode = std::to_string(codeBytes) + "-byte codes";
+
+        size_t equalCount = 0, rangeCount = 0;
+        Bitmap prefixMatches;
+        size_t bytes = encoder.columnBytes();
+        double equalTime = context.measure("AdaptiveCodeWidth " + mode + " equal", 1, [&] { equalCount = encoder.queryEqual(column[0]).count(); }, numRows, bytes).p50;
+        assert(equalCount == static_cast<size_t>(std::count(column.begin(), column.end(), column[0])));
+
+        double prefixTime = context.measure("AdaptiveCodeWidth " + mode + " prefix", 1, [&] { prefixMatches = encoder.queryPrefixSIMD("a"); }, numRows, bytes).p50;
+        assert(prefixMatches.count() == encoder.vanillaQueryPrefix(column, "a").count());
+
+        double countTime = context.measure("AdaptiveCodeWidth " + mode + " range count", 4, [&] { rangeCount = encoder.countRange("b", "n"); }, numRows, bytes).p50;
+        assert(rangeCount == encoder.queryRange("b", "n").count());
+
+        double bytesPerRow = static_cast<double>(encoder.columnBytes()) / numRows;
+        std::cout << mode << " (" << encoder.distinctKeys() << " keys, " << bytesPerRow << " B/row): equal "
+                  << equalTime << " s, prefix " << prefixTime << " s, range count " << countTime << " s.\n";
+
+        // New keys past the 1-byte limit: the next version switches to a 2-byte copy
+        if (codeBytes == 1) {
+            std::vector<std::string> batch(dataset.begin() + cardinality, dataset.begin() + cardinality + 300);
+            double widenTime = context.measureWithSetup("AdaptiveCodeWidth Widen on append", 1, [&] {
+                encoder.clear();
+                encoder.encode(column, 4);
+            }, [&] { encoder.append(batch); }, batch.size()).p50;
+            assert(encoder.codeBytes() == 2);
+            assert(encoder.decode(numRows, SIZE_MAX) == batch);
+            assert(encoder.queryValueSIMD(batch.back()) == static_cast<int>(numRows + batch.size() - 1));
+            assert(encoder.queryEqual(column[0]).count() == equalCount);
+            std::cout << "Widening to 2-byte codes on append took " << widenTime << " seconds.\n";
+        }
+    }
+    encoder.setOrderPreserving(false);
+}
+
+// File -> encoded column throughput: a newline-delimited and a CSV file are loaded through the
+// parallel pipeline and compared against reading lines into strings and calling encode()
+void testFileIngestion(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const size_t numRows = size_t(1) << 22;
+    std::mt19937 generator(29);
+    std::uniform_int_distribution<size_t> distribution(0, dataset.size() - 1);
+    std::vector<std::string> column(numRows);
+    {
+        std::ofstream text("ingest_column.txt", std::ios::binary);
+        std::ofstream csv("ingest_column.csv", std::ios::binary);
+        csv << "row,value,comment\n";
+        for (size_t i = 0; i < numRows; ++i) {
+            column[i] = dataset[distribution(generator)];
+            text << column[i] << '\n';
+            csv << i << ',' << column[i] << ",\"said \"\"hi\"\", twice\"\r\n";
+        }
+    }
+    double textGigabytes = std::filesystem::file_size("ingest_column.txt") / 1e9;
+    double csvGigabytes = std::filesystem::file_size("ingest_column.csv") / 1e9;
+
+    // Baseline: getline into strings, then encode
+    std::vector<std::string> lines;
+    double baselineTime = context.measureWithSetup("FileIngestion getline + encode", 4, [&] { encoder.clear(); }, [&] {
+        lines.clear();
+        std::ifstream in("ingest_column.txt");
+        for (std::string line; std::getline(in, line);) {
+            lines.push_back(std::move(line));
+        }
+        encoder.encode(lines, 4);
+    }, numRows).p50;
+    assert(lines == column);
+    std::cout << "Reading lines + encode: " << textGigabytes / baselineTime << " GB/s.\n";
+
+    for (int threads : context.options().threads) {
+        bool loaded = false;
+        double textTime = context.measureWithSetup("FileIngestion Load text", threads, [&] { encoder.clear(); }, [&] {
+            loaded = encoder.load("ingest_column.txt", threads);
+        }, numRows).p50;
+        assert(loaded && encoder.decode() == column);
+
+        double csvTime = context.measureWithSetup("FileIngestion Load CSV", threads, [&] { encoder.clear(); }, [&] {
+            loaded = encoder.load("ingest_column.csv", threads, 1, true);
+        }, numRows).p50;
+        assert(loaded && encoder.decode() == column);
+
+        std::cout << "Loading with " << threads << " threads: text " << textGigabytes / textTime << " GB/s, CSV "
+                  << csvGigabytes / csvTime << " GB/s.\n";
+    }
+
+    // Quoted fields keep their commas, and doubled quotes collapse
+    encoder.load("ingest_column.csv", 4, 2, true);
+    assert(encoder.distinctKeys() == 1 && encoder.Get("said \"hi\", twice") == 0);
+
+    // An empty file loads as an empty column, and so does a CSV file holding only its header
+    std::ofstream("ingest_empty.txt").close();
+    std::ofstream("ingest_header.csv") << "id,key\n";
+    assert(encoder.load("ingest_empty.txt", 4) && encoder.decode().empty() && encoder.distinctKeys() == 0);
+    encoder.encode(column, 4);
+    assert(encoder.load("ingest_header.csv", 4, 1, true) && encoder.decode().empty() && encoder.distinctKeys() == 0);
+    std::remove("ingest_empty.txt");
+    std::remove("ingest_header.csv");
+
+    // Codes written back out in parallel must read back as the same codes
+    encoder.load("ingest_column.txt", 4);
+    double writeTime = context.measure("FileIngestion Write codes", 1, [&] { encoder.writeEncodedColumn("ingest_codes.txt"); }, numRows).p50;
+    double codeGigabytes = std::filesystem::file_size("ingest_codes.txt") / 1e9;
+    std::ifstream codes("ingest_codes.txt");
+    size_t row = 0;
+    for (std::string line; std::getline(codes, line); ++row) {
+        assert(std::stoi(line) == *encoder.Get(column[row]));
+    }
+    assert(row == numRows);
+    std::cout << "Writing encoded column: " << codeGigabytes / writeTime << " GB/s.\n";
+
+    std::remove("ingest_column.txt");
+    std::remove("ingest_column.csv");
+    std::remove("ingest_codes.txt");
+}
+
+// Operation latencies over generated columns of different shapes: uniform and Zipf-skewed keys,
+// low and high cardinality, fixed and variable key lengths. Every column comes from the seed.
+void testWorkloads(DictionaryEncoder& encoder, BenchmarkContext& context) {
+    const size_t rows = context.options().rows;
+    const uint64_t seed = context.options().seed;
+    struct Workload {
+        std::string name;
+        KeySpec spec;
+    };
+    const std::vector<Workload> workloads = {
+        {"uniform", {rows, rows, 8, 8, 0, seed}},
+        {"zipf-1.0", {rows, rows, 8, 8, 1.0, seed}},
+        {"low-cardinality", {rows, 200, 8, 8, 0, seed}},
+        {"high-cardinality", {rows, rows * 4, 8, 8, 0, seed}},
+        {"variable-length", {rows, rows, 4, 64, 0, seed}},
+    };
+    const int threads = context.options().threads.back();
+
+    for (const Workload& workload : workloads) {
+        std::vector<std::string> column = generateKeys(workload.spec);
+        size_t bytes = 0;
+        for (const auto& value : column) {
+            bytes += value.size();
+        }
+        const std::string& target = column[column.size() / 2];
+        std::string name = "Workload " + workload.name;
+
+        double encodeTime = context.measure(name + " encode", threads, [&] {
+            encoder.clear();
+            encoder.encode(column, threads);
+        }, rows, bytes).p50;
+
+        size_t equalCount = 0, prefixCount = 0, rangeCount = 0;
+        double equalTime = context.measure(name + " equal", 1, [&] { equalCount = encoder.queryEqual(target).count(); }, rows).p50;
+        assert(equalCount == static_cast<size_t>(std::count(column.begin(), column.end(), target)));
+        double prefixTime = context.measure(name + " prefix", 1, [&] { prefixCount = encoder.queryPrefixSIMD("a").count(); }, rows).p50;
+        assert(prefixCount == encoder.vanillaQueryPrefix(column, "a").count());
+        double rangeTime = context.measure(name + " range count", 1, [&] { rangeCount = encoder.countRange("b", "n"); }, rows).p50;
+        assert(rangeCount == encoder.queryRange("b", "n").count());
+
+        std::vector<std::string> decoded;
+        double decodeTime = context.measure(name + " decode", 1, [&] { decoded = encoder.decode(); }, rows, bytes).p50;
+        assert(decoded == column);
+
+        std::cout << workload.name << " (" << encoder.distinctKeys() << " keys): encode " << encodeTime << " s, equal "
+                  << equalTime << " s, prefix " << prefixTime << " s, range count " << rangeTime << " s, decode "
+                  << decodeTime << " s.\n";
+    }
+}
+
+// Counters and latency histograms kept by the encoder, and what keeping them costs per call
+void testStatistics(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const size_t numLookups = 100000;
+    encoder.clear();
+    encoder.resetStats();
+    encoder.encode(dataset, 4);
+    for (size_t i = 0; i < numLookups; ++i) {
+        encoder.Get(dataset[i % dataset.size()]);
+    }
+    int row = encoder.queryValueSIMD(dataset[dataset.size() / 2]);
+    size_t prefixMatches = encoder.queryPrefixSIMD("a").count();
+    encoder.Put("stats-key", 0);
+    encoder.Delete("stats-key");
+
+    EncoderStats::Snapshot stats = encoder.stats();
+    if (EncoderStats::kEnabled) {
+        using Op = EncoderStats::Operation;
+        using Counter = EncoderStats::Counter;
+        assert(stats.enabled);
+        assert(stats.operation(Op::EncodeHash).count == 1 && stats.operation(Op::EncodeBuild).count == 1);
+        assert(stats.operation(Op::Get).count == numLookups);
+        assert(stats.operation(Op::QueryValue).count == 1 && stats.operation(Op::QueryPrefix).count == 1);
+        assert(stats.operation(Op::Put).count == 1 && stats.operation(Op::Delete).count == 1);
+        assert(stats.counter(Counter::DictionaryProbes) >= dataset.size());
+        assert(stats.counter(Counter::DictionaryLookups) >= dataset.size() + numLookups);
+        // Rows the zone summaries rule out are skipped instead of scanned
+        assert(stats.counter(Counter::RowsScanned) + stats.counter(Counter::RowsSkipped) == static_cast<size_t>(row) + 1 + dataset.size());
+        assert(stats.counter(Counter::RowsMatched) == 1 + prefixMatches);
+        const EncoderStats::Latency& get = stats.operation(Op::Get);
+        assert(get.timed >= numLookups >> EncoderStats::kPointSampleShift && get.timed < numLookups); // Sampled
+        assert(get.percentileNanos(0.5) <= get.percentileNanos(0.99) && get.percentileNanos(0.99) <= get.percentileNanos(1.0));
+        std::cout << "Probes per encoded row: "
+                  << static_cast<double>(stats.counter(Counter::DictionaryProbes)) / dataset.size() << ", Get p50 <= "
+                  << get.percentileNanos(0.5) << " ns, p99 <= " << get.percentileNanos(0.99) << " ns.\n";
+    } else {
+        assert(!stats.enabled && stats.operation(EncoderStats::Operation::Get).count == 0);
+    }
+    std::cout << "Stats: " << stats.toJson() << "\n";
+
+    // Lookup latency with the counters and timers as built, and the cost of one timed record
+    double getTime = context.measure("Statistics Get", 1, [&] {
+        for (size_t i = 0; i < numLookups; ++i) {
+            encoder.Get(dataset[i % dataset.size()]);
+        }
+    }, numLookups).p50;
+    EncoderStats scratch;
+    double timerTime = context.measure("Statistics Timer", 1, [&] {
+        for (size_t i = 0; i < numLookups; ++i) {
+            EncoderStats::Timer timer(scratch, EncoderStats::Operation::Get);
+        }
+    }, numLookups).p50;
+    std::cout << "Get with statistics " << (EncoderStats::kEnabled ? "on" : "off") << ": " << getTime / numLookups * 1e9
+              << " ns/call; one timed record costs " << timerTime / numLookups * 1e9 << " ns.\n";
+}
+
+// Zone summaries on a clustered column and on a shuffled one: every zone-skipping scan must
+// agree with a plain pass over the strings, and only the clustered column should skip
+void testZoneMaps(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    std::vector<std::string> sorted = dataset;
+    std::sort(sorted.begin(), sorted.end());
+    KeySpec spec;
+    spec.rows = dataset.size();
+    spec.cardinality = 1000;
+    spec.seed = context.options().seed;
+    struct Layout {
+        std::string name;
+        std::vector<std::string> column;
+    };
+    const std::vector<Layout> layouts = {{"clustered", std::move(sorted)}, {"shuffled", generateKeys(spec)}};
+
+    encoder.setOrderPreserving(true);
+    for (const Layout& layout : layouts) {
+        const std::vector<std::string>& column = layout.column;
+        const size_t rows = column.size();
+        const std::string& target = column[rows - rows / 64 - 1]; // Near the end: a full scan reads almost every row
+        const auto [lo, hi] = std::minmax(column[rows / 4], column[rows / 2]);
+        const std::vector<std::string> inList = {column[rows / 8], column[rows / 3], target};
+        encoder.clear();
+        encoder.encode(column, 4);
+        std::string name = "ZoneMaps " + layout.name;
+
+        int row = -1;
+        size_t equalCount = 0, rangeCount = 0, countedRange = 0;
+        std::vector<size_t> inCounts;
+        encoder.resetStats();
+        double valueTime = context.measure(name + " first match", 1, [&] { row = encoder.queryValueSIMD(target); }).p50;
+        assert(row == encoder.vanillaQueryValue(column, target));
+        assert(encoder.queryValueNonSIMD(target) == row && encoder.parallelQueryValue(target) == row);
+        double equalTime = context.measure(name + " equal", 1, [&] { equalCount = encoder.queryEqual(target).count(); }, rows).p50;
+        assert(equalCount == static_cast<size_t>(std::count(column.begin(), column.end(), target)));
+        assert(encoder.queryValueAll(target).size() == equalCount);
+        double inTime = context.measure(name + " IN-list", 1, [&] { inCounts = encoder.queryValuesCount(inList); }, rows).p50;
+        for (size_t i = 0; i < inList.size(); ++i) {
+            assert(inCounts[i] == static_cast<size_t>(std::count(column.begin(), column.end(), inList[i])));
+        }
+        double rangeTime = context.measure(name + " range", 1, [&] { rangeCount = encoder.queryRange(lo, hi).count(); }, rows).p50;
+        size_t expectedRange = std::count_if(column.begin(), column.end(), [&](const std::string& value) { return value >= lo && value < hi; });
+        assert(rangeCount == expectedRange);
+        double countTime = context.measure(name + " range count", 1, [&] { countedRange = encoder.countRange(lo, hi); }, rows).p50;
+        assert(countedRange == expectedRange);
+
+        EncoderStats::Snapshot stats = encoder.stats();
+        size_t skipped = stats.counter(EncoderStats::Counter::RowsSkipped);
+        size_t scanned = stats.counter(EncoderStats::Counter::RowsScanned);
+        if (EncoderStats::kEnabled && layout.name == "clustered" && rows >= 4 * SegmentedColumn::kZoneRows) {
+            assert(skipped > scanned);
+        }
+        std::cout << layout.name << ": first match " << valueTime << " s, equal " << equalTime << " s, IN-list " << inTime
+                  << " s, range " << rangeTime << " s, range count " << countTime << " s; rows skipped " << skipped
+                  << ", scanned " << scanned << ".\n";
+    }
+    encoder.setOrderPreserving(false);
+}
+
+// Clustered columns store whole segments as runs of one code; scans read the runs, not the
+// rows. The same column shuffled has no runs to exploit and stays plain.
+void testRunLength(DictionaryEncoder& encoder, BenchmarkContext& context) {
+    KeySpec spec;
+    spec.rows = std::max<size_t>(context.options().rows, 4 * SegmentedColumn::kSegmentRows);
+    spec.cardinality = 1000;
+    spec.seed = context.options().seed;
+    std::vector<std::string> shuffled = generateKeys(spec);
+    std::vector<std::string> clustered = shuffled;
+    std::sort(clustered.begin(), clustered.end());
+    struct Layout {
+        std::string name;
+        const std::vector<std::string>& column;
+    };
+    const std::vector<Layout> layouts = {{"clustered", clustered}, {"shuffled", shuffled}};
+
+    for (bool ordered : {false, true}) {
+        encoder.setOrderPreserving(ordered);
+        for (const Layout& layout : layouts) {
+            const std::vector<std::string>& column = layout.column;
+            const size_t rows = column.size();
+            const std::string& target = column[rows - rows / 64 - 1];
+            const std::string prefix = target.substr(0, 1);
+            const auto [lo, hi] = std::minmax(column[rows / 4], column[rows / 2]);
+            const std::vector<std::string> inList = {column[rows / 8], column[rows / 3], target};
+            encoder.clear();
+            encoder.encode(column, 4);
+            const size_t runSegments = encoder.runEncodedSegments();
+            assert(layout.name == "clustered" ? runSegments == rows / SegmentedColumn::kSegmentRows : runSegments == 0);
+            assert(encoder.decode() == column);
+            std::string name = std::string("RunLength ") + (ordered ? "ordered " : "") + layout.name;
+
+            int row = -1;
+            size_t equalCount = 0, prefixCount = 0, rangeCount = 0;
+            double valueTime = context.measure(name + " first match", 1, [&] { row = encoder.queryValueSIMD(target); }).p50;
+            assert(row == encoder.vanillaQueryValue(column, target));
+            assert(encoder.queryValueNonSIMD(target) == row && encoder.parallelQueryValue(target) == row);
+            double equalTime = context.measure(name + " equal", 1, [&] { equalCount = encoder.queryEqual(target).count(); }, rows).p50;
+            assert(equalCount == static_cast<size_t>(std::count(column.begin(), column.end(), target)));
+            assert(encoder.queryValueAll(target).size() == equalCount && encoder.countValue(target) == equalCount);
+            std::vector<size_t> inCounts = encoder.queryValuesCount(inList);
+            for (size_t i = 0; i < inList.size(); ++i) {
+                assert(inCounts[i] == static_cast<size_t>(std::count(column.begin(), column.end(), inList[i])));
+            }
+            double prefixTime = context.measure(name + " prefix", 1, [&] { prefixCount = encoder.queryPrefixSIMD(prefix).count(); }, rows).p50;
+            Bitmap expectedPrefix = encoder.vanillaQueryPrefix(column, prefix);
+            assert(prefixCount == expectedPrefix.count());
+            assert(encoder.parallelQueryPrefix(prefix).count() == prefixCount && encoder.countPrefix(prefix) == prefixCount);
+            size_t expectedRange = std::count_if(column.begin(), column.end(), [&](const std::string& value) { return value >= lo && value < hi; });
+            double rangeTime = context.measure(name + " range", 1, [&] { rangeCount = encoder.queryRange(lo, hi).count(); }, rows).p50;
+            assert(rangeCount == expectedRange && encoder.countRange(lo, hi) == expectedRange);
+            std::vector<size_t> counts = encoder.histogram();
+            assert(std::accumulate(counts.begin(), counts.end(), size_t(0)) == rows);
+
+            // Appended rows land in a plain tail segment next to the runs
+            encoder.append({target, target});
+            assert(encoder.countValue(target) == equalCount + 2 && encoder.decode(rows, rows + 2)[1] == target);
+
+            std::cout << (ordered ? "ordered " : "") << layout.name << ": " << runSegments << " run-length segments, column "
+                      << encoder.columnBytes() << " bytes; first match " << valueTime << " s, equal " << equalTime
+                      << " s, prefix " << prefixTime << " s, range " << rangeTime << " s.\n";
+        }
+    }
+    encoder.setOrderPreserving(false);
+}
+
+// query() against every fixed way of answering the same predicates: the forced strategies,
+// the dedicated query methods and a scan of the raw strings. The planned time should track
+// the best of them whatever the column's cardinality, code order or index.
+void testQueryPlanner(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    KeySpec spec;
+    spec.rows = 4 * dataset.size();
+    spec.cardinality = 1000;
+    spec.seed = context.options().seed;
+    const std::vector<std::string> repeated = generateKeys(spec);
+    struct Setup {
+        std::string name;
+        const std::vector<std::string>& column;
+        bool ordered;
+        bool indexed;
+    };
+    const std::vector<Setup> setups = {{"distinct", dataset, false, false},
+                                       {"distinct indexed", dataset, false, true},
+                                       {"distinct ordered", dataset, true, false},
+                                       {"repeated", repeated, false, false},
+                                       {"repeated ordered", repeated, true, false}};
+    const bool parallel = std::thread::hardware_concurrency() > 1;
+    // Planned time against the best fixed one: typically 1.2 to 1.6 times it, or within a few
+    // microseconds of it for the shortest queries, whose times are mostly timer and wakeup noise.
+    // Only reported: a timing must not fail the run on a loaded machine.
+    auto withinBound = [](double plannedTime, double bestTime) { return plannedTime <= 1.6 * bestTime + 5e-6; };
+
+    double worstRatio = 0;
+    size_t outsideBound = 0;
+    for (const Setup& setup : setups) {
+        const std::vector<std::string>& column = setup.column;
+        const size_t rows = column.size();
+        const auto [lo, hi] = std::minmax(column[rows / 4], column[rows / 2]);
+        const std::vector<Predicate> predicates = {{PredicateOp::Equal, column[rows / 2], ""},
+                                                   {PredicateOp::Equal, "absent-key", ""},
+                                                   {PredicateOp::Prefix, column[rows / 3].substr(0, 1), ""},
+                                                   {PredicateOp::Prefix, column[rows / 3].substr(0, 3), ""},
+                                                   {PredicateOp::Range, lo, hi}};
+        encoder.clear();
+        encoder.setOrderPreserving(setup.ordered);
+        encoder.encode(column, 4);
+        encoder.setPrefixIndex(setup.indexed);
+
+        for (const Predicate& predicate : predicates) {
+            auto matches = [&](const std::string& key) {
+                switch (predicate.op) {
+                    case PredicateOp::Equal: return key == predicate.value;
+                    case PredicateOp::Prefix: return key.compare(0, predicate.value.size(), predicate.value) == 0;
+                    case PredicateOp::Range: return key >= predicate.value && key < predicate.upper;
+                }
+                return false;
+            };
+            const size_t expected = std::count_if(column.begin(), column.end(), matches);
+            const char* op = predicate.op == PredicateOp::Equal ? "equal " : predicate.op == PredicateOp::Prefix ? "prefix " : "range ";
+            const std::string name = "Planner " + setup.name + " " + op + predicate.value;
+            // The planner is given the strings too, as a caller still holding them would
+            const QueryPlan plan = encoder.planQuery(predicate, column);
+
+            size_t count = 0;
+            double planned = context.measure(name + " planned", 1, [&] { count = encoder.query(predicate, column).count(); }, rows).p50;
+            assert(count == expected);
+
+            // Every fixed path, with its time; code compares are left out once the codes are too many to be a contender
+            struct FixedPath {
+                std::string label;
+                int threads;
+                double time;
+                std::function<size_t()> run;
+            };
+            std::vector<FixedPath> fixed;
+            auto fixedPath = [&](const std::string& label, int threads, auto&& run) {
+                size_t found = 0;
+                fixed.push_back({label, threads, context.measure(name + " " + label, threads, [&] { found = run(); }, rows).p50, run});
+                assert(found == expected);
+            };
+            for (ScanStrategy strategy : {ScanStrategy::RowScan, ScanStrategy::CodeCompare, ScanStrategy::CodeSet, ScanStrategy::CodeRange}) {
+                if (strategy == ScanStrategy::CodeCompare && plan.matchingCodes > 64) {
+                    continue;
+                }
+                for (bool inParallel : {false, true}) {
+                    if (inParallel && (!parallel || strategy == ScanStrategy::RowScan)) {
+                        continue;
+                    }
+                    std::string label = std::string(QueryPlanner::name(strategy)) + (inParallel ? " parallel" : "");
+                    // The loop variables are copied: the best path may run again after the loops end
+                    fixedPath(label, inParallel ? 0 : 1, [&encoder, &predicate, strategy, inParallel] {
+                        return encoder.query(predicate, strategy, inParallel).count();
+                    });
+                }
+            }
+            switch (predicate.op) {
+                case PredicateOp::Equal:
+                    fixedPath("queryEqual", 1, [&] { return encoder.queryEqual(predicate.value).count(); });
+                    break;
+                case PredicateOp::Prefix:
+                    fixedPath("queryPrefixSIMD", 1, [&] { return encoder.queryPrefixSIMD(predicate.value).count(); });
+                    fixedPath("queryPrefixNonSIMD", 1, [&] { return encoder.queryPrefixNonSIMD(predicate.value).count(); });
+                    fixedPath("parallelQueryPrefix", 0, [&] { return encoder.parallelQueryPrefix(predicate.value).count(); });
+                    break;
+                case PredicateOp::Range:
+                    fixedPath("queryRange", 1, [&] { return encoder.queryRange(predicate.value, predicate.upper).count(); });
+                    break;
+            }
+            fixedPath("raw strings", 1, [&] { return static_cast<size_t>(std::count_if(column.begin(), column.end(), matches)); });
+
+            auto best = std::min_element(fixed.begin(), fixed.end(), [](const auto& a, const auto& b) { return a.time < b.time; });
+            // A planned path trailing the best fixed one by more than noise is measured against it
+            // again, a few times, before it counts; each side keeps its fastest time
+            for (int retry = 0; retry < 3 && !withinBound(planned, best->time); ++retry) {
+                planned = std::min(planned, context.measure(name + " planned again", 1, [&] { count = encoder.query(predicate, column).count(); }, rows).p50);
+                best->time = std::min(best->time, context.measure(name + " " + best->label + " again", best->threads, [&] { best->run(); }, rows).p50);
+            }
+            worstRatio = std::max(worstRatio, planned / best->time);
+            outsideBound += withinBound(planned, best->time) ? 0 : 1;
+            std::cout << setup.name << ", " << op << predicate.value << " (" << expected << " rows): " << plan.describe()
+                      << "; planned " << planned << " s, best fixed " << best->label << " " << best->time << " s.\n";
+        }
+    }
+    encoder.setPrefixIndex(false);
+    encoder.setOrderPreserving(false);
+
+    // Once a Delete() or a Put() changes what rows decode to, the given strings are stale and
+    // the planned query must still agree with the fixed paths
+    encoder.clear();
+    encoder.encode(dataset, 4);
+    const std::string deleted = dataset[dataset.size() / 3];
+    const std::string moved = dataset[dataset.size() / 5];
+    const std::vector<Predicate> stale = {{PredicateOp::Equal, deleted, ""},
+                                          {PredicateOp::Prefix, deleted.substr(0, 2), ""},
+                                          {PredicateOp::Range, deleted, deleted + "~"},
+                                          {PredicateOp::Equal, "planner-put-key", ""},
+                                          {PredicateOp::Prefix, "planner-put", ""}};
+    // Strings of the right length that are not the encoded vector are never scanned raw
+    const std::vector<std::string> lookalike(dataset.size(), deleted);
+    for (const Predicate& predicate : stale) {
+        assert(encoder.planQuery(predicate, lookalike).strategy != ScanStrategy::RawScan);
+        assert(encoder.query(predicate, lookalike).count() == encoder.query(predicate).count());
+    }
+    for (bool put : {false, true}) {
+        assert(put ? encoder.Put("planner-put-key", *encoder.Get(moved)) : encoder.Delete(deleted));
+        for (const Predicate& predicate : stale) {
+            assert(encoder.planQuery(predicate, dataset).strategy != ScanStrategy::RawScan);
+            size_t count = encoder.query(predicate, dataset).count();
+            assert(count == encoder.query(predicate).count() && count == encoder.query(predicate, ScanStrategy::RowScan).count());
+        }
     }
+    assert(encoder.query({PredicateOp::Equal, deleted, ""}, dataset).count() == 0);
+    assert(encoder.query({PredicateOp::Equal, "planner-put-key", ""}, dataset).count() == 1);
 
-    size_t numEntries = 100000;
-    auto testData = generateTestData(numEntries, 8); // Key size fixed at 8B
+    // The plan is logged on request, one line per query
+    std::cout.flush();
+    encoder.setQueryLogging(true);
+    encoder.query({PredicateOp::Prefix, "a", ""});
+    encoder.setQueryLogging(false);
+    std::cout << "Planned / best fixed time: at worst " << worstRatio << "; " << outsideBound
+              << " queries beyond 1.6 times the best fixed time plus 5 us.\n";
+}
+
+// Concurrent users each running their own scans, against the same users submitting to the
+// shared scanner, which answers everything pending with one pass over the column
+void testSharedScans(DictionaryEncoder& encoder, const std::vector<std::string>& dataset, BenchmarkContext& context) {
+    const size_t operationsPerUser = 40;
+    const std::string targetValue = dataset[dataset.size() / 2];
+    const std::string prefix = "a";
+    const int expectedRow = encoder.queryValueSIMD(targetValue);
+    const size_t expectedPrefix = encoder.queryPrefixSIMD(prefix).count();
+    assert(expectedRow == static_cast<int>(dataset.size() / 2));
+    assert(encoder.submitQueryValue("absent-key").get() == -1);
+    assert(encoder.submitQueryPrefix(prefix).get().count() == expectedPrefix);
+
+    auto runUsers = [&](int users, bool shared) {
+        std::vector<std::thread> userThreads;
+        for (int i = 0; i < users; ++i) {
+            userThreads.emplace_back([&]() {
+                for (size_t j = 0; j < operationsPerUser; ++j) {
+                    if (j % 2 == 0) {
+                        int row = shared ? encoder.submitQueryValue(targetValue).get() : encoder.queryValueSIMD(targetValue);
+                        assert(row == expectedRow);
+                    } else {
+                        size_t count = shared ? encoder.submitQueryPrefix(prefix).get().count() : encoder.queryPrefixSIMD(prefix).count();
+                        assert(count == expectedPrefix);
+                    }
+                }
+            });
+        }
+        for (auto& thread : userThreads) {
+            thread.join();
+        }
+    };
+
+    for (int users : context.options().threads) {
+        size_t queries = users * operationsPerUser;
+        double ownTime = context.measure("SharedScan Independent", users, [&] { runUsers(users, false); }, queries).p50;
+        encoder.resetStats();
+        double sharedTime = context.measure("SharedScan Shared", users, [&] { runUsers(users, true); }, queries).p50;
+        EncoderStats::Snapshot stats = encoder.stats();
+        std::cout << users << " users: " << queries / ownTime << " queries/s scanning independently, " << queries / sharedTime
+                  << " queries/s with shared scans";
+        if (EncoderStats::kEnabled) {
+            std::cout << " (" << static_cast<double>(stats.counter(EncoderStats::Counter::SharedQueries)) /
+                                     stats.operation(EncoderStats::Operation::SharedScan).count
+                      << " queries per pass)";
+        }
+        std::cout << ".\n";
+    }
+}
+
+// Key hashing per instruction set and key width, and what it buys encode()
+void testKeyHashing(DictionaryEncoder& encoder, BenchmarkContext& context) {
+    // The persistent hash is written into column files: it must never change
+    assert(VersionedDictionary::hashKey("abcd") == 0x3b80a7a6ad8fb470ull);
+    assert(VersionedDictionary::hashKey("abcdefgh") == 0x4562ffaa76fa1c2eull);
+    assert(VersionedDictionary::hashKey("abcdefghijklmnop") == 0xe25bef00265ef9cfull);
+    assert(VersionedDictionary::hashKey("abcdefghijklmnopqrstuvwxyz012345") == 0xe5db1522ffbe22fbull);
+    assert(VersionedDictionary::hashKey("variable-key1") == 0x6fb77bedc982fdfull);
+
+    const size_t rows = context.options().rows;
+    struct Width {
+        std::string name;
+        size_t minLength, maxLength;
+    };
+    for (const Width& width : {Width{"4B", 4, 4}, Width{"8B", 8, 8}, Width{"16B", 16, 16}, Width{"32B", 32, 32}, Width{"4-64B", 4, 64}}) {
+        std::vector<std::string> keys = generateDistinctKeys(rows, width.minLength, width.maxLength, context.options().seed);
+        std::vector<std::string_view> views(keys.begin(), keys.end());
+        size_t bytes = 0;
+        for (const auto& key : keys) {
+            bytes += key.size();
+        }
+        std::vector<uint64_t> hashes(views.size());
+
+        std::string perIsa;
+        for (Isa isa : supportedIsas()) {
+            const ScanKernels& kernels = *scanKernelsFor(isa);
+            double hashTime = context.measure("KeyHash " + width.name + " " + kernels.name, 1, [&] {
+                kernels.hashKeys(views.data(), views.size(), hashes.data());
+            }, views.size(), bytes).p50;
+            uint64_t single;
+            kernels.hashKeys(&views.back(), 1, &single);
+            assert(single == hashes.back()); // A key hashes the same alone or in a block
+            std::sort(hashes.begin(), hashes.end());
+            size_t distinct = std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+            assert(distinct >= views.size() - views.size() / 1000);
+            perIsa += std::string(" ") + kernels.name + " " + std::to_string(hashTime / views.size() * 1e9) + " ns/key;";
+        }
+
+        double encodeTime = context.measure("KeyHash " + width.name + " encode", 4, [&] {
+            encoder.clear();
+            encoder.encode(keys, 4);
+        }, rows, bytes).p50;
+        assert(encoder.distinctKeys() == keys.size() && encoder.decode(0, 1).front() == keys.front());
+        std::cout << width.name << " keys: hashing" << perIsa << " encode " << bytes / encodeTime / 1e9 << " GB/s of keys.\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    std::optional<BenchmarkOptions> options = BenchmarkOptions::parse(argc, argv);
+    if (!options) {
+        return 2;
+    }
+
+    DictionaryEncoder encoder;
+    size_t numEntries = options->rows;
+    auto testData = generateDistinctKeys(numEntries, 8, 8, options->seed); // Key size fixed at 8B
+
+    // Cases that query the default data set start from a fresh encoding of it, so any of them can run alone
+    auto encoded = [&]() -> DictionaryEncoder& {
+        encoder.clear();
+        encoder.encode(testData, 4);
+        return encoder;
+    };
+
+    BenchmarkRegistry registry;
 
     // 1. Test encoding performance with different thread counts
-    testEncodingPerformance(encoder, testData, csvFile);
+    registry.add("encoding", [&](BenchmarkContext& context) { testEncodingPerformance(encoder, testData, context); });
 
-    // // 2. Test operational concurrency (multiple users)
-    // testConcurrency(encoder, testData, csvFile);
+    // 2. Test operational concurrency (multiple users)
+    registry.add("concurrency", [&](BenchmarkContext& context) { testConcurrency(encoder, testData, context); });
 
-    // // 3. Test read vs. write ratios
-    // testReadWriteRatio(encoder, testData, csvFile);
+    // 3. Test read vs. write ratios
+    registry.add("read-write", [&](BenchmarkContext& context) { testReadWriteRatio(encoded(), testData, context); });
 
     // 4. Test querying
-    testQueryComparison(encoder, testData, csvFile);
+    registry.add("queries", [&](BenchmarkContext& context) { testQueryComparison(encoded(), testData, context); });
+
+    // 5. Test parallel scans with different thread counts
+    registry.add("parallel-scan", [&](BenchmarkContext& context) { testParallelScanPerformance(encoded(), testData, context); });
+
+    // 6. Test decoding
+    registry.add("decode", [&](BenchmarkContext& context) { testDecodePerformance(encoded(), testData, context); });
+
+    // 7. Test order-preserving prefix and range queries
+    registry.add("ordered", [&](BenchmarkContext& context) { testOrderPreservingQueries(encoder, testData, context); });
+
+    // 8. Test bit-packed column queries
+    registry.add("packed", [&](BenchmarkContext& context) { testPackedQueries(encoder, testData, context); });
+
+    // 9. Test scan kernel throughput per instruction set
+    registry.add("kernels", [&](BenchmarkContext& context) { testKernelThroughput(1 << 22, context); });
+
+    // 10. Test value sizes
+    registry.add("value-sizes", [&](BenchmarkContext& context) { testValueSizes(encoder, numEntries, context); });
+
+    // 11. Test incremental ingestion with append()
+    registry.add("append", [&](BenchmarkContext& context) { testAppendPerformance(encoder, testData, context); });
+
+    // 12. Test binary persistence and memory-mapped open
+    registry.add("persistence", [&](BenchmarkContext& context) { testPersistence(encoder, testData, context); });
+
+    // 13. Test the front-coded compressed dictionary
+    registry.add("compressed-dictionary", [&](BenchmarkContext& context) { testCompressedDictionary(encoder, testData, context); });
+
+    // 14. Test the trie prefix index
+    registry.add("prefix-index", [&](BenchmarkContext& context) { testPrefixIndex(encoder, testData, context); });
+
+    // 15. Test batched multi-value lookups
+    registry.add("batch-lookups", [&](BenchmarkContext& context) { testBatchLookups(encoder, testData, context); });
+
+    // 16. Test aggregates computed on codes
+    registry.add("aggregations", [&](BenchmarkContext& context) { testAggregations(encoder, testData, context); });
+
+    // 17. Test multi-column tables
+    registry.add("table", [&](BenchmarkContext& context) { testTable(testData, context); });
+
+    // 18. Test adaptive code width
+    registry.add("code-width", [&](BenchmarkContext& context) { testAdaptiveCodeWidth(encoder, testData, context); });
+
+    // 19. Test parallel file ingestion and output
+    registry.add("ingestion", [&](BenchmarkContext& context) { testFileIngestion(encoder, testData, context); });
+
+    // 20. Test generated workloads of different shapes
+    registry.add("workloads", [&](BenchmarkContext& context) { testWorkloads(encoder, context); });
+
+    // 21. Test the encoder's runtime statistics
+    registry.add("statistics", [&](BenchmarkContext& context) { testStatistics(encoder, testData, context); });
+
+    // 22. Test zone summaries on clustered and shuffled columns
+    registry.add("zone-maps", [&](BenchmarkContext& context) { testZoneMaps(encoder, testData, context); });
+
+    // 23. Test shared scans for concurrent users
+    registry.add("shared-scans", [&](BenchmarkContext& context) { testSharedScans(encoded(), testData, context); });
+
+    // 24. Test key hashing
+    registry.add("hashing", [&](BenchmarkContext& context) { testKeyHashing(encoder, context); });
+
+    // 25. Test run-length encoded segments
+    registry.add("run-length", [&](BenchmarkContext& context) { testRunLength(encoder, context); });
 
-    // 5. Test value sizes
-    testValueSizes(encoder, numEntries, csvFile);
+    // 26. Test planned queries against every fixed strategy
+    registry.add("planner", [&](BenchmarkContext& context) { testQueryPlanner(encoder, testData, context); });
 
-    return 0;
+    return registry.run(*options);
 }